@@ -0,0 +1,95 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// Shared helpers for the standalone benchmark executables under bench/.
+
+namespace bench {
+
+class Timer {
+   public:
+    Timer() : start_(std::chrono::steady_clock::now()) {}
+    void reset() { start_ = std::chrono::steady_clock::now(); }
+    double elapsed_sec() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    }
+    uint64_t elapsed_ns() const {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now() - start_)
+                                         .count());
+    }
+
+   private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Fixed-width, zero-padded so lexicographic order == numeric order.
+inline std::string make_key(uint64_t i, size_t width = 16) {
+    std::string s = std::to_string(i);
+    if (s.size() < width) s.insert(0, width - s.size(), '0');
+    return s;
+}
+
+inline std::string make_value(std::mt19937_64& rng, size_t n) {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+    std::string v(n, '\0');
+    for (auto& c : v) c = alphabet[rng() % (sizeof(alphabet) - 1)];
+    return v;
+}
+
+inline void report(const char* name, uint64_t ops, double secs) {
+    double ns_op = secs * 1e9 / static_cast<double>(ops ? ops : 1);
+    double ops_s = static_cast<double>(ops) / (secs > 0 ? secs : 1e-9);
+    std::printf("%-32s %10llu ops %10.1f ns/op %12.0f ops/s\n", name,
+                static_cast<unsigned long long>(ops), ns_op, ops_s);
+}
+
+// Zipfian ranks in [0, n), rank 0 the most popular (Gray et al., "Quickly
+// Generating Billion-Record Synthetic Databases", as used by YCSB).
+// Construction is O(n); next() is O(1).
+class Zipfian {
+   public:
+    explicit Zipfian(uint64_t n, double theta = 0.99) : n_(n), theta_(theta) {
+        if (n_ < 2) return;
+        zetan_ = zeta(n_);
+        alpha_ = 1.0 / (1.0 - theta_);
+        eta_ = (1.0 - std::pow(2.0 / static_cast<double>(n_), 1.0 - theta_)) / (1.0 - zeta(2) / zetan_);
+    }
+
+    uint64_t next(std::mt19937_64& rng) const {
+        if (n_ < 2) return 0;
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        double uz = u * zetan_;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0 + std::pow(0.5, theta_)) return 1;
+        auto r = static_cast<uint64_t>(static_cast<double>(n_) * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+        return std::min(r, n_ - 1);
+    }
+
+   private:
+    double zeta(uint64_t n) const {
+        double sum = 0;
+        for (uint64_t i = 1; i <= n; ++i) sum += 1.0 / std::pow(static_cast<double>(i), theta_);
+        return sum;
+    }
+
+    uint64_t n_;
+    double theta_;
+    double zetan_ = 0, alpha_ = 0, eta_ = 0;
+};
+
+// p in [0, 1] of samples, which it sorts; 0 if empty.
+inline uint64_t percentile(std::vector<uint64_t>& samples, double p) {
+    if (samples.empty()) return 0;
+    if (!std::is_sorted(samples.begin(), samples.end())) std::sort(samples.begin(), samples.end());
+    auto i = static_cast<size_t>(p * static_cast<double>(samples.size()));
+    return samples[std::min(i, samples.size() - 1)];
+}
+
+}  // namespace bench
@@ -0,0 +1,68 @@
+// Engine throughput from 1..16 threads: read-only gets, and a 90% get /
+// 10% put mix. Each is run against the engine as is (readers pin a
+// SuperVersion, writers share the write queue) and behind one global mutex,
+// the wrapper callers needed before the engine was thread safe. Reads
+// should scale with cores; the mutex caps them at one.
+//
+// usage: kv-concurrency-bench [num_keys] [ops_per_thread] [dir]
+#include <cstdlib>
+#include <filesystem>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "engine.h"
+
+int main(int argc, char** argv) {
+    size_t num_keys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+    size_t ops = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100000;
+    std::string dir = argc > 3 ? argv[3] : "concurrency_bench_data";
+
+    std::filesystem::remove_all(dir);
+    EngineOptions o;
+    o.block_cache_bytes = 64 << 20;  // the working set stays cached
+    Engine db(dir, o);
+    if (!db.open()) return 1;
+    {
+        std::mt19937_64 rng(42);
+        for (size_t i = 0; i < num_keys; ++i)
+            if (!db.put(bench::make_key(i), bench::make_value(rng, 100))) return 1;
+        // half in tables, half in the memtable
+        if (!db.flush() || !db.wait_for_compactions()) return 1;
+        for (size_t i = 0; i < num_keys; i += 2)
+            if (!db.put(bench::make_key(i), bench::make_value(rng, 100))) return 1;
+        for (size_t i = 0; i < num_keys; ++i)  // warm the block cache
+            if (!db.get(bench::make_key(i))) return 1;
+    }
+
+    std::mutex global;
+    for (int write_pct : {0, 10}) {
+        for (bool locked : {false, true}) {
+            for (int threads : {1, 2, 4, 8, 16}) {
+                std::vector<std::thread> workers;
+                bench::Timer timer;
+                for (int t = 0; t < threads; ++t)
+                    workers.emplace_back([&, t] {
+                        std::mt19937_64 rng(t + 1);
+                        const std::string value = bench::make_value(rng, 100);
+                        for (size_t i = 0; i < ops; ++i) {
+                            std::string key = bench::make_key(rng() % num_keys);
+                            bool write = static_cast<int>(rng() % 100) < write_pct;
+                            std::unique_lock<std::mutex> g(global, std::defer_lock);
+                            if (locked) g.lock();
+                            if (write ? !db.put(key, value) : !db.get(key)) std::abort();
+                        }
+                    });
+                for (auto& w : workers) w.join();
+                std::string name = std::string(write_pct ? "90/10 " : "get ") +
+                                   (locked ? "global-mutex" : "engine") + " t=" + std::to_string(threads);
+                bench::report(name.c_str(), ops * threads, timer.elapsed_sec());
+            }
+        }
+    }
+    std::filesystem::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,59 @@
+// Engine write throughput under each WAL durability mode: no sync, a
+// periodic fdatasync from the background thread, and a sync per write.
+//
+// usage: kv-durability-bench [puts] [value_size] [dir]
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+
+#include "bench_util.h"
+#include "engine.h"
+
+int main(int argc, char** argv) {
+    size_t puts = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+    size_t value_size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100;
+    std::string dir = argc > 3 ? argv[3] : "durability_bench_data";
+
+    std::mt19937_64 rng(42);
+    const std::string value = bench::make_value(rng, value_size);
+
+    struct Mode {
+        const char* name;
+        WalSyncMode mode;
+        size_t puts;
+    };
+    // a sync per write is orders of magnitude slower; keep its run short
+    const Mode modes[] = {
+        {"none", WalSyncMode::None, puts},
+        {"periodic 100ms/1MiB", WalSyncMode::Periodic, puts},
+        {"periodic 10ms/64KiB", WalSyncMode::Periodic, puts},
+        {"every write", WalSyncMode::EveryWrite, std::max<size_t>(1, puts / 10)},
+    };
+    for (const Mode& m : modes) {
+        std::filesystem::remove_all(dir);
+        EngineOptions o;
+        o.wal_sync = m.mode;
+        if (std::string(m.name).find("10ms") != std::string::npos) {
+            o.wal_sync_interval_ms = 10;
+            o.wal_sync_bytes = 64 * 1024;
+        }
+        uint64_t syncs = 0;
+        double secs;
+        {
+            Engine db(dir, o);
+            if (!db.open()) return 1;
+            bench::Timer timer;
+            for (size_t i = 0; i < m.puts; ++i)
+                if (!db.put(bench::make_key(i), value)) return 1;
+            secs = timer.elapsed_sec();
+            syncs = db.background_syncs();
+        }
+        std::string name = std::string("put ") + m.name;
+        bench::report(name.c_str(), m.puts, secs);
+        if (m.mode == WalSyncMode::Periodic)
+            std::printf("%-32s %10llu background syncs\n", "", static_cast<unsigned long long>(syncs));
+    }
+    std::filesystem::remove_all(dir);
+    return 0;
+}
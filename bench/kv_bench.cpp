@@ -0,0 +1,396 @@
+// db_bench-style driver: runs a list of workloads against one Engine, in
+// order and on the same database, and reports ops/s, MB/s and p50 / p99 /
+// p99.9 latencies of each, optionally also as JSON to track regressions.
+//
+// usage: kv-bench [--flag=value ...]
+//   --benchmarks=fillseq,readrandom   comma-separated, any of
+//       fillseq      put keys 0..num-1 in order (each thread a slice)
+//       fillrandom   put num keys drawn from the distribution
+//       overwrite    as fillrandom; meant to follow a fill
+//       readrandom   get `reads` keys drawn from the distribution
+//       readmissing  get `reads` keys that are never written
+//       readseq      iterate over `reads` entries in key order
+//       mixed        `reads` operations, read_pct% gets and the rest puts
+//   --num=100000           key space (keys are 0..num-1, zero-padded)
+//   --reads=-1             operations of the read and mixed workloads; -1 = num
+//   --threads=1            each workload's operations are split among them
+//   --key_size=16 --value_size=100
+//   --distribution=uniform uniform, zipfian (theta 0.99, hot keys scattered
+//                          over the key space) or latest (zipfian over the
+//                          highest keys; mixed puts append new keys)
+//   --write_buffer_size=4194304   EngineOptions::mem_flush_threshold_bytes
+//   --value_log_min_size=0 ValueLogOptions::min_value_size: values at least
+//                          this long go to value logs; 0 keeps them inline
+//   --read_pct=90 --sync=0 (1: WalSyncMode::EveryWrite)
+//   --memtable=map|skiplist --db=kv_bench_data --use_existing_db=0
+//   --json=<path>          also write the results there
+//   --seed=42
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "bench_util.h"
+#include "engine.h"
+#include "utils.h"
+
+namespace {
+
+enum class Distribution { Uniform, Zipfian, Latest };
+
+struct Flags {
+    std::string benchmarks = "fillseq,fillrandom,overwrite,readrandom,readmissing,readseq,mixed";
+    uint64_t num = 100000;
+    int64_t reads = -1;
+    int threads = 1;
+    size_t key_size = 16;
+    size_t value_size = 100;
+    std::string distribution = "uniform";
+    size_t write_buffer_size = 4 * 1024 * 1024;
+    size_t value_log_min_size = 0;
+    int read_pct = 90;
+    bool sync = false;
+    std::string memtable = "map";
+    std::string db = "kv_bench_data";
+    bool use_existing_db = false;
+    std::string json;
+    uint64_t seed = 42;
+};
+
+bool parse_flags(int argc, char** argv, Flags* f) {
+    std::map<std::string, std::string> kv;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view a = argv[i];
+        auto eq = a.find('=');
+        if (a.substr(0, 2) != "--" || eq == std::string_view::npos) {
+            std::fprintf(stderr, "bad argument %s (want --flag=value)\n", argv[i]);
+            return false;
+        }
+        kv[std::string(a.substr(2, eq - 2))] = std::string(a.substr(eq + 1));
+    }
+    auto take = [&](const char* name, auto* out) {
+        auto it = kv.find(name);
+        if (it == kv.end()) return;
+        using T = std::remove_pointer_t<decltype(out)>;
+        if constexpr (std::is_same_v<T, std::string>)
+            *out = it->second;
+        else if constexpr (std::is_same_v<T, bool>)
+            *out = it->second == "1" || it->second == "true";
+        else
+            *out = static_cast<T>(std::strtoll(it->second.c_str(), nullptr, 10));
+        kv.erase(it);
+    };
+    take("benchmarks", &f->benchmarks);
+    take("num", &f->num);
+    take("reads", &f->reads);
+    take("threads", &f->threads);
+    take("key_size", &f->key_size);
+    take("value_size", &f->value_size);
+    take("distribution", &f->distribution);
+    take("write_buffer_size", &f->write_buffer_size);
+    take("value_log_min_size", &f->value_log_min_size);
+    take("read_pct", &f->read_pct);
+    take("sync", &f->sync);
+    take("memtable", &f->memtable);
+    take("db", &f->db);
+    take("use_existing_db", &f->use_existing_db);
+    take("json", &f->json);
+    take("seed", &f->seed);
+    for (const auto& [name, value] : kv) {
+        std::fprintf(stderr, "unknown flag --%s\n", name.c_str());
+        return false;
+    }
+    if (f->num == 0 || f->threads < 1) {
+        std::fprintf(stderr, "--num and --threads must be positive\n");
+        return false;
+    }
+    return true;
+}
+
+// Key indexes for one thread. `limit` is the number of keys written so far
+// for the latest distribution (which reads the highest ones).
+class KeyGen {
+   public:
+    KeyGen(Distribution d, uint64_t num, const bench::Zipfian& zipf, uint64_t seed)
+        : dist_(d), num_(num), zipf_(zipf), rng_(seed) {}
+
+    uint64_t next(uint64_t limit) {
+        switch (dist_) {
+            case Distribution::Uniform:
+                return rng_() % num_;
+            case Distribution::Zipfian: {
+                const uint64_t rank = zipf_.next(rng_);
+                return hash64(std::string_view(reinterpret_cast<const char*>(&rank), sizeof(rank))) % num_;
+            }
+            case Distribution::Latest:
+                return limit - 1 - std::min(zipf_.next(rng_), limit - 1);
+        }
+        return 0;
+    }
+    std::mt19937_64& rng() { return rng_; }
+
+   private:
+    Distribution dist_;
+    uint64_t num_;
+    const bench::Zipfian& zipf_;
+    std::mt19937_64 rng_;
+};
+
+struct ThreadStats {
+    uint64_t ops = 0;
+    uint64_t bytes = 0;
+    uint64_t reads = 0;   // gets and scan steps; found counts out of these
+    uint64_t found = 0;
+    std::vector<uint64_t> latencies;   // ns per operation
+};
+
+struct Result {
+    std::string name;
+    uint64_t ops = 0;
+    uint64_t bytes = 0;
+    uint64_t found = 0;
+    uint64_t reads = 0;
+    uint64_t write_stalls = 0;
+    double secs = 0;
+    uint64_t p50 = 0, p99 = 0, p999 = 0, max = 0;   // ns
+};
+
+// The share of n operations thread t of `threads` runs, and where it starts.
+uint64_t share(uint64_t n, int threads, int t) { return n / threads + (static_cast<uint64_t>(t) < n % threads); }
+uint64_t share_start(uint64_t n, int threads, int t) {
+    return static_cast<uint64_t>(t) * (n / threads) + std::min<uint64_t>(t, n % threads);
+}
+
+class Bench {
+   public:
+    Bench(const Flags& f, Engine& db)
+        : f_(f), db_(db), zipf_(f.num), key_limit_(f.num), next_key_(f.num),
+          reads_(f.reads < 0 ? f.num : static_cast<uint64_t>(f.reads)) {
+        if (f.distribution == "zipfian") dist_ = Distribution::Zipfian;
+        if (f.distribution == "latest") dist_ = Distribution::Latest;
+        std::mt19937_64 rng(f.seed);
+        value_ = bench::make_value(rng, f.value_size);
+    }
+
+    bool run(const std::string& name, uint64_t round, Result* r) {
+        using Op = std::function<void(int, KeyGen&, ThreadStats&)>;
+        Op op;
+        if (name == "fillseq") {
+            op = [&](int t, KeyGen&, ThreadStats& s) {
+                const uint64_t first = share_start(f_.num, f_.threads, t);
+                for (uint64_t i = first; i < first + share(f_.num, f_.threads, t); ++i)
+                    timed(s, [&] { put(i, s); });
+            };
+        } else if (name == "fillrandom" || name == "overwrite") {
+            op = [&](int t, KeyGen& g, ThreadStats& s) {
+                for (uint64_t n = share(f_.num, f_.threads, t); n > 0; --n)
+                    timed(s, [&] { put(g.next(f_.num), s); });
+            };
+        } else if (name == "readrandom" || name == "readmissing") {
+            const bool missing = name == "readmissing";
+            op = [&, missing](int t, KeyGen& g, ThreadStats& s) {
+                for (uint64_t n = share(reads_, f_.threads, t); n > 0; --n) {
+                    std::string key = bench::make_key(g.next(key_limit_.load()), f_.key_size);
+                    if (missing) key += '.';
+                    timed(s, [&] { get(key, s); });
+                }
+            };
+        } else if (name == "readseq") {
+            op = [&](int t, KeyGen&, ThreadStats& s) {
+                auto it = db_.NewIterator();
+                it->Seek(bench::make_key(share_start(f_.num, f_.threads, t), f_.key_size));
+                for (uint64_t n = share(reads_, f_.threads, t); n > 0; --n) {
+                    timed(s, [&] {
+                        if (!it->Valid()) it->SeekToFirst();   // wrap around
+                        ++s.reads;
+                        if (!it->Valid()) return;
+                        s.bytes += it->key().size() + it->value().size();
+                        ++s.found;
+                        it->Next();
+                    });
+                }
+                if (!it->ok()) std::abort();
+            };
+        } else if (name == "mixed") {
+            op = [&](int t, KeyGen& g, ThreadStats& s) {
+                for (uint64_t n = share(reads_, f_.threads, t); n > 0; --n) {
+                    if (static_cast<int>(g.rng()() % 100) < f_.read_pct) {
+                        std::string key = bench::make_key(g.next(key_limit_.load()), f_.key_size);
+                        timed(s, [&] { get(key, s); });
+                    } else {
+                        // latest: writes append new keys, which reads then favour
+                        const bool append = dist_ == Distribution::Latest;
+                        const uint64_t i = append ? next_key_.fetch_add(1) : g.next(f_.num);
+                        timed(s, [&] { put(i, s); });
+                        if (append) publish(i);
+                    }
+                }
+            };
+        } else {
+            std::fprintf(stderr, "unknown benchmark %s\n", name.c_str());
+            return false;
+        }
+
+        const uint64_t stalls = db_.write_stalls();
+        std::vector<ThreadStats> stats(f_.threads);
+        std::vector<std::thread> threads;
+        bench::Timer timer;
+        for (int t = 0; t < f_.threads; ++t)
+            threads.emplace_back([&, t] {
+                KeyGen g(dist_, f_.num, zipf_, f_.seed + (round << 32) + t);
+                op(t, g, stats[t]);
+            });
+        for (auto& th : threads) th.join();
+        r->secs = timer.elapsed_sec();
+
+        r->name = name;
+        r->write_stalls = db_.write_stalls() - stalls;
+        std::vector<uint64_t> lat;
+        for (auto& s : stats) {
+            r->ops += s.ops;
+            r->bytes += s.bytes;
+            r->reads += s.reads;
+            r->found += s.found;
+            lat.insert(lat.end(), s.latencies.begin(), s.latencies.end());
+        }
+        r->p50 = bench::percentile(lat, 0.50);
+        r->p99 = bench::percentile(lat, 0.99);
+        r->p999 = bench::percentile(lat, 0.999);
+        r->max = lat.empty() ? 0 : lat.back();
+        return true;
+    }
+
+   private:
+    template <typename Fn>
+    static void timed(ThreadStats& s, Fn&& fn) {
+        bench::Timer t;
+        fn();
+        s.latencies.push_back(t.elapsed_ns());
+        ++s.ops;
+    }
+
+    // Makes appended key i readable once every key before it is: key_limit_
+    // only moves from i to i + 1, so a writer that finished early waits for
+    // the ones that claimed smaller keys.
+    void publish(uint64_t i) {
+        for (uint64_t expected = i; !key_limit_.compare_exchange_weak(expected, i + 1); expected = i)
+            std::this_thread::yield();
+    }
+
+    void put(uint64_t i, ThreadStats& s) {
+        const std::string key = bench::make_key(i, f_.key_size);
+        if (!db_.put(key, value_)) std::abort();
+        s.bytes += key.size() + value_.size();
+    }
+
+    void get(const std::string& key, ThreadStats& s) {
+        ++s.reads;
+        if (auto v = db_.get(key)) {
+            s.bytes += key.size() + v->size();
+            ++s.found;
+        }
+    }
+
+    const Flags& f_;
+    Engine& db_;
+    Distribution dist_ = Distribution::Uniform;
+    bench::Zipfian zipf_;
+    std::atomic<uint64_t> key_limit_;   // keys 0..key_limit_-1 have been written
+    std::atomic<uint64_t> next_key_;    // next key an appending write claims
+    const uint64_t reads_;
+    std::string value_;
+};
+
+std::string json_escape(std::string_view s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) continue;
+        out += c;
+    }
+    return out;
+}
+
+bool write_json(const std::string& path, const Flags& f, const std::vector<Result>& results) {
+    FILE* out = std::fopen(path.c_str(), "w");
+    if (!out) return false;
+    std::fprintf(out, "{\n  \"config\": {\"num\": %llu, \"reads\": %lld, \"threads\": %d, \"key_size\": %zu, "
+                      "\"value_size\": %zu, \"distribution\": \"%s\", \"write_buffer_size\": %zu, "
+                      "\"value_log_min_size\": %zu, \"read_pct\": %d, \"sync\": %s, \"memtable\": \"%s\"},\n"
+                      "  \"results\": [",
+                 static_cast<unsigned long long>(f.num), static_cast<long long>(f.reads), f.threads, f.key_size,
+                 f.value_size, json_escape(f.distribution).c_str(), f.write_buffer_size, f.value_log_min_size,
+                 f.read_pct,
+                 f.sync ? "true" : "false", json_escape(f.memtable).c_str());
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        std::fprintf(out, "%s\n    {\"name\": \"%s\", \"ops\": %llu, \"seconds\": %.6f, \"ops_per_sec\": %.1f, "
+                          "\"mb_per_sec\": %.3f, \"reads\": %llu, \"found\": %llu, \"write_stalls\": %llu, "
+                          "\"latency_us\": {\"p50\": %.3f, \"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f}}",
+                     i ? "," : "", r.name.c_str(), static_cast<unsigned long long>(r.ops), r.secs,
+                     r.ops / r.secs, r.bytes / 1048576.0 / r.secs, static_cast<unsigned long long>(r.reads),
+                     static_cast<unsigned long long>(r.found), static_cast<unsigned long long>(r.write_stalls),
+                     r.p50 / 1e3, r.p99 / 1e3, r.p999 / 1e3, r.max / 1e3);
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+    return std::fclose(out) == 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Flags f;
+    if (!parse_flags(argc, argv, &f)) return 1;
+    if (f.distribution != "uniform" && f.distribution != "zipfian" && f.distribution != "latest") {
+        std::fprintf(stderr, "unknown distribution %s\n", f.distribution.c_str());
+        return 1;
+    }
+
+    if (!f.use_existing_db) std::filesystem::remove_all(f.db);
+    EngineOptions o;
+    o.mem_flush_threshold_bytes = f.write_buffer_size;
+    o.value_log.min_value_size = f.value_log_min_size;
+    o.wal_sync = f.sync ? WalSyncMode::EveryWrite : WalSyncMode::None;
+    o.memtable_rep = f.memtable == "skiplist" ? MemTableRep::SkipList : MemTableRep::Map;
+    Engine db(f.db, o);
+    if (!db.open()) return 1;
+
+    std::printf("kv-bench: num=%llu threads=%d key=%zuB value=%zuB distribution=%s\n",
+                static_cast<unsigned long long>(f.num), f.threads, f.key_size, f.value_size,
+                f.distribution.c_str());
+    Bench bench(f, db);
+    std::vector<Result> results;
+    size_t pos = 0;
+    for (uint64_t round = 0; pos <= f.benchmarks.size(); ++round) {
+        size_t comma = f.benchmarks.find(',', pos);
+        if (comma == std::string::npos) comma = f.benchmarks.size();
+        std::string name = f.benchmarks.substr(pos, comma - pos);
+        pos = comma + 1;
+        if (name.empty()) continue;
+
+        Result r;
+        if (!bench.run(name, round, &r)) return 1;
+        std::printf("%-12s : %11.0f ops/s %8.1f MB/s   p50 %8.2f  p99 %8.2f  p99.9 %8.2f us", r.name.c_str(),
+                    r.ops / r.secs, r.bytes / 1048576.0 / r.secs, r.p50 / 1e3, r.p99 / 1e3, r.p999 / 1e3);
+        if (r.reads)
+            std::printf("   (%llu of %llu found)", static_cast<unsigned long long>(r.found),
+                        static_cast<unsigned long long>(r.reads));
+        std::printf("\n");
+        results.push_back(std::move(r));
+    }
+
+    if (!f.json.empty() && !write_json(f.json, f, results)) {
+        std::fprintf(stderr, "cannot write %s\n", f.json.c_str());
+        return 1;
+    }
+    return 0;
+}
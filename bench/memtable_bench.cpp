@@ -0,0 +1,63 @@
+// Compares the std::map MemTable (shared_mutex) with the lock-free skip list
+// at 1..16 threads: concurrent inserts of distinct keys into one table, then
+// concurrent point lookups of keys present in it.
+//
+// usage: kv-memtable-bench [keys] [lookups_per_thread] [value_size]
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "memtable.h"
+
+// Run fn(thread_index) on n threads; returns the wall time in seconds.
+template <typename Fn>
+static double run_threads(int n, Fn fn) {
+    std::vector<std::thread> threads;
+    bench::Timer timer;
+    for (int t = 0; t < n; ++t) threads.emplace_back(fn, t);
+    for (auto& th : threads) th.join();
+    return timer.elapsed_sec();
+}
+
+int main(int argc, char** argv) {
+    size_t keys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 400000;
+    size_t lookups = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 400000;
+    size_t value_size = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 100;
+
+    // random insertion order, so neither structure sees sorted input
+    std::vector<std::string> key_list;
+    key_list.reserve(keys);
+    for (size_t i = 0; i < keys; ++i) key_list.push_back(bench::make_key(i));
+    std::mt19937_64 rng(42);
+    std::shuffle(key_list.begin(), key_list.end(), rng);
+    const std::string value = bench::make_value(rng, value_size);
+
+    for (int threads : {1, 2, 4, 8, 16}) {
+        for (MemTableRep rep : {MemTableRep::Map, MemTableRep::SkipList}) {
+            const char* rep_name = rep == MemTableRep::Map ? "map" : "skiplist";
+            MemTable mem(rep);
+
+            // each thread inserts its own slice of the keys
+            double secs = run_threads(threads, [&](int t) {
+                for (size_t i = t; i < keys; i += threads) mem.put(key_list[i], value);
+            });
+            std::string name = std::string(rep_name) + " insert  t=" + std::to_string(threads);
+            bench::report(name.c_str(), keys, secs);
+
+            secs = run_threads(threads, [&](int t) {
+                std::mt19937_64 r(t + 1);
+                size_t found = 0;
+                for (size_t i = 0; i < lookups; ++i)
+                    if (mem.get(key_list[r() % keys])) ++found;
+                if (found != lookups) std::abort();
+            });
+            name = std::string(rep_name) + " lookup  t=" + std::to_string(threads);
+            bench::report(name.c_str(), lookups * threads, secs);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,249 @@
+// Microbenchmarks (Google Benchmark) of single hot paths, to judge a format
+// or allocator change in isolation from the rest of the engine:
+//   SSTableBuild   SSTableBuilder::add per entry, plus finish (fsync) amortized
+//   SSTableProbe   SSTable::Probe of a hit, a miss (filter on) and a tombstone
+//   BlockSeek      BlockIter::Seek: restart binary search + linear decode, the
+//                  search every probe does in the index block and a data block
+//   WALAppend      WAL::appendPut without sync (encode, CRC, write())
+//   WALReplay      WAL::replay into a fresh MemTable, per record
+//   MemTablePut / MemTableGet, both reps
+// Arguments are named in the benchmark names (e.g. .../key:16/value:100).
+//
+// usage: kv-microbench [--benchmark_filter=<regex>] [other Google Benchmark flags]
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+
+#include "bench_util.h"
+#include "block.h"
+#include "memtable.h"
+#include "sstable.h"
+#include "wal.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Scratch directory, removed at exit.
+const std::string& scratch_dir() {
+    static const std::string dir = [] {
+        auto p = fs::temp_directory_path() / ("kv_microbench_" + std::to_string(::getpid()));
+        fs::create_directories(p);
+        std::atexit([] { fs::remove_all(scratch_dir()); });
+        return p.string();
+    }();
+    return dir;
+}
+
+// Sorted entries keys 0, 2, 4, ... (odd keys miss); every 16th a tombstone.
+std::vector<std::pair<std::string, MemValue>> make_entries(size_t n, size_t key_size, size_t value_size) {
+    std::mt19937_64 rng(42);
+    const std::string value = bench::make_value(rng, value_size);
+    std::vector<std::pair<std::string, MemValue>> entries;
+    entries.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        MemValue mv;
+        mv.type = i % 16 == 15 ? RecType::Del : RecType::Put;
+        if (mv.type == RecType::Put) mv.value = value;
+        entries.emplace_back(bench::make_key(2 * i, key_size), std::move(mv));
+    }
+    return entries;
+}
+
+void BM_SSTableBuild(benchmark::State& state) {
+    const auto entries = make_entries(state.range(0), state.range(1), state.range(2));
+    SSTableOptions opts;
+    opts.block_size = state.range(3);
+    uint64_t id = 1;
+    for (auto _ : state) {
+        SSTableBuilder b(scratch_dir(), id, opts);
+        if (!b.open()) state.SkipWithError("open failed");
+        for (const auto& [k, mv] : entries) b.add(k, mv.type, mv.value);
+        std::string path;
+        if (!b.finish(&path)) state.SkipWithError("finish failed");
+        fs::remove(path);
+        ++id;
+    }
+    state.SetItemsProcessed(state.iterations() * entries.size());
+}
+BENCHMARK(BM_SSTableBuild)
+    ->ArgNames({"entries", "key", "value", "block"})
+    ->Args({100000, 16, 100, 4096})
+    ->Args({100000, 64, 100, 4096})
+    ->Args({100000, 16, 1000, 4096})
+    ->Args({100000, 16, 100, 16384})
+    ->Unit(benchmark::kMillisecond);
+
+enum ProbeCase { kHit, kMiss, kTombstone };
+
+void BM_SSTableProbe(benchmark::State& state) {
+    const size_t n = state.range(0);
+    const auto entries = make_entries(n, state.range(1), 100);
+    const auto which = static_cast<ProbeCase>(state.range(3));
+    SSTableOptions opts;
+    opts.block_size = state.range(2);
+    std::string path;
+    if (!SSTable::Build(scratch_dir(), 1000 + state.thread_index(), entries, &path, opts)) {
+        state.SkipWithError("build failed");
+        return;
+    }
+    SSTable t;
+    if (!t.Open(path, opts)) {
+        state.SkipWithError("open failed");
+        return;
+    }
+
+    std::vector<std::string> keys;
+    std::mt19937_64 rng(7);
+    for (size_t i = 0; i < 4096; ++i) {
+        size_t e = rng() % (n / 16) * 16;   // a multiple of 16: a Put
+        if (which == kTombstone) e += 15;
+        keys.push_back(which == kMiss ? bench::make_key(2 * e + 1, state.range(1)) : entries[e].first);
+    }
+    const auto expect = which == kHit ? SSTable::ProbeKind::Put
+                        : which == kMiss ? SSTable::ProbeKind::Absent : SSTable::ProbeKind::Tombstone;
+    std::string out;
+    size_t i = 0;
+    for (auto _ : state) {
+        if (t.Probe(keys[i++ & 4095], &out) != expect) state.SkipWithError("wrong probe result");
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetItemsProcessed(state.iterations());
+    fs::remove(path);
+}
+BENCHMARK(BM_SSTableProbe)
+    ->ArgNames({"entries", "key", "block", "case"})
+    ->ArgsProduct({{10000, 1000000}, {16}, {4096, 16384}, {kHit, kMiss, kTombstone}})
+    ->Args({1000000, 64, 4096, kHit});
+
+void BM_BlockSeek(benchmark::State& state) {
+    const size_t n = state.range(0);
+    const int restart_interval = static_cast<int>(state.range(1));
+    BlockBuilder b(restart_interval);
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < n; ++i) {
+        keys.push_back(bench::make_key(i, state.range(2)));
+        b.add(keys.back(), RecType::Put, "12345678");   // like an index entry's handle
+    }
+    const std::string contents(b.finish());
+    std::mt19937_64 rng(7);
+    std::vector<std::string> targets(4096);
+    for (auto& k : targets) k = keys[rng() % n];
+    size_t i = 0;
+    for (auto _ : state) {
+        BlockIter it(contents);
+        it.Seek(targets[i++ & 4095]);
+        benchmark::DoNotOptimize(it.value());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BlockSeek)
+    ->ArgNames({"entries", "restart", "key"})
+    ->ArgsProduct({{64, 1024}, {1, 4, 16, 64}, {16}})
+    ->Args({1024, 16, 64});
+
+void BM_WALAppend(benchmark::State& state) {
+    std::mt19937_64 rng(42);
+    const std::string key = bench::make_key(0, state.range(0));
+    const std::string value = bench::make_value(rng, state.range(1));
+    const std::string path = scratch_dir() + "/append.log";
+    fs::remove(path);
+    WAL wal(path, 1);
+    if (!wal.open()) {
+        state.SkipWithError("open failed");
+        return;
+    }
+    size_t bytes = 0;
+    for (auto _ : state) {
+        if (!wal.appendPut(key, value)) state.SkipWithError("append failed");
+        bytes += WAL::kRecordHeader + key.size() + value.size();
+        if (bytes > (64u << 20)) {   // keep the file small; reset cost amortized
+            wal.reset();
+            bytes = 0;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * (WAL::kRecordHeader + key.size() + value.size()));
+}
+BENCHMARK(BM_WALAppend)
+    ->ArgNames({"key", "value"})
+    ->Args({16, 100})
+    ->Args({16, 1000})
+    ->Args({64, 100});
+
+void BM_WALReplay(benchmark::State& state) {
+    const size_t n = state.range(0);
+    const std::string path = scratch_dir() + "/replay.log";
+    fs::remove(path);
+    {
+        std::mt19937_64 rng(42);
+        const std::string value = bench::make_value(rng, state.range(1));
+        WAL wal(path, 1);
+        if (!wal.open()) {
+            state.SkipWithError("open failed");
+            return;
+        }
+        for (size_t i = 0; i < n; ++i) wal.appendPut(bench::make_key(rng() % n), value, false, i + 1);
+    }
+    for (auto _ : state) {
+        MemTable mem;
+        WAL wal(path, 1);
+        if (!wal.open() || !wal.replay(mem)) state.SkipWithError("replay failed");
+        benchmark::DoNotOptimize(mem.bytes());
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+    fs::remove(path);
+}
+BENCHMARK(BM_WALReplay)
+    ->ArgNames({"records", "value"})
+    ->Args({100000, 100})
+    ->Args({100000, 1000})
+    ->Unit(benchmark::kMillisecond);
+
+// Random keys into one table, replaced by a fresh one every 64k puts so the
+// table size stays bounded (the arena's free is counted in).
+void BM_MemTablePut(benchmark::State& state) {
+    const auto rep = static_cast<MemTableRep>(state.range(0));
+    std::mt19937_64 rng(42);
+    const std::string value = bench::make_value(rng, state.range(2));
+    std::vector<std::string> keys(1 << 16);
+    for (auto& k : keys) k = bench::make_key(rng(), state.range(1));
+    auto mem = std::make_unique<MemTable>(rep);
+    size_t i = 0;
+    for (auto _ : state) {
+        mem->put(keys[i++ & 0xffff], value);
+        if ((i & 0xffff) == 0) mem = std::make_unique<MemTable>(rep);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MemTablePut)
+    ->ArgNames({"skiplist", "key", "value"})
+    ->ArgsProduct({{0, 1}, {16, 64}, {100}});
+
+void BM_MemTableGet(benchmark::State& state) {
+    const auto rep = static_cast<MemTableRep>(state.range(0));
+    const size_t n = state.range(1);
+    std::mt19937_64 rng(42);
+    const std::string value = bench::make_value(rng, 100);
+    MemTable mem(rep);
+    for (size_t i = 0; i < n; ++i) mem.put(bench::make_key(2 * i), value);
+    std::vector<std::string> keys(4096);
+    for (auto& k : keys) k = bench::make_key(rng() % (2 * n));   // half of them miss
+    size_t i = 0;
+    for (auto _ : state) benchmark::DoNotOptimize(mem.get(keys[i++ & 4095]));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MemTableGet)
+    ->ArgNames({"skiplist", "entries"})
+    ->ArgsProduct({{0, 1}, {1000, 100000}});
+
+}  // namespace
+
+BENCHMARK_MAIN();
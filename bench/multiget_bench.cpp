@@ -0,0 +1,75 @@
+// Point lookups in batches: a loop of Engine::get vs one Engine::multi_get,
+// for random keys across the whole key space and for clustered keys (a
+// batch drawn from a narrow range, so several share a block), with the
+// block cache on and off.
+//
+// usage: kv-multiget-bench [num_keys] [value_size] [dir]
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bench_util.h"
+#include "engine.h"
+
+int main(int argc, char** argv) {
+    size_t num_keys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+    size_t value_size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100;
+    std::string dir = argc > 3 ? argv[3] : "multiget_bench_data";
+    const size_t kLookups = 200000;
+
+    std::mt19937_64 rng(42);
+    std::filesystem::remove_all(dir);
+    {
+        EngineOptions o;
+        o.compaction.background = false;
+        Engine db(dir, o);
+        if (!db.open()) return 1;
+        for (size_t i = 0; i < num_keys; ++i)
+            if (!db.put(bench::make_key(i), bench::make_value(rng, value_size))) return 1;
+        if (!db.flush() || !db.compact()) return 1;
+    }
+
+    for (size_t cache_bytes : {size_t(8) << 20, size_t(0)}) {
+        EngineOptions o;
+        o.compaction.background = false;
+        o.block_cache_bytes = cache_bytes;
+        Engine db(dir, o);
+        if (!db.open()) return 1;
+
+        for (bool clustered : {false, true}) {
+            for (size_t batch : {8, 64, 512}) {
+                // the same key batches for both variants
+                std::vector<std::vector<std::string>> batches(kLookups / batch);
+                for (auto& b : batches) {
+                    size_t base = rng() % num_keys;
+                    for (size_t i = 0; i < batch; ++i)
+                        b.push_back(bench::make_key(clustered ? (base + rng() % (batch * 4)) % num_keys
+                                                              : rng() % num_keys));
+                }
+                std::string label = std::string(cache_bytes ? "cache " : "nocache ") +
+                                    (clustered ? "clustered " : "random ") + "b=" + std::to_string(batch);
+
+                size_t hits = 0;
+                bench::Timer timer;
+                for (const auto& b : batches)
+                    for (const auto& k : b) hits += db.get(k).has_value();
+                bench::report(("get loop " + label).c_str(), batches.size() * batch, timer.elapsed_sec());
+
+                size_t multi_hits = 0;
+                std::vector<std::string_view> views;
+                timer.reset();
+                for (const auto& b : batches) {
+                    views.assign(b.begin(), b.end());
+                    for (const auto& v : db.multi_get(views)) multi_hits += v.has_value();
+                }
+                bench::report(("multi_get " + label).c_str(), batches.size() * batch, timer.elapsed_sec());
+                if (hits != multi_hits) return 1;
+            }
+        }
+    }
+    std::filesystem::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,47 @@
+// Put throughput from 1..16 threads into a ShardedEngine of 1, 2, 4 and 8
+// shards. With one shard every write goes through a single write queue,
+// WAL and flush thread; more shards should let writes scale with threads
+// until the disk is the limit. A fourth argument "sync" runs every put in
+// WalSyncMode::EveryWrite, where each shard's log syncs on its own.
+//
+// usage: kv-sharded-bench [ops_per_thread] [value_size] [dir] [sync]
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "sharded_engine.h"
+
+int main(int argc, char** argv) {
+    size_t ops = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 50000;
+    size_t value_size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100;
+    std::string dir = argc > 3 ? argv[3] : "sharded_bench_data";
+    bool sync = argc > 4 && std::string(argv[4]) == "sync";
+
+    EngineOptions o;
+    o.wal_sync = sync ? WalSyncMode::EveryWrite : WalSyncMode::None;
+    for (size_t shards : {1, 2, 4, 8}) {
+        for (int threads : {1, 2, 4, 8, 16}) {
+            std::filesystem::remove_all(dir);
+            ShardedEngine db(dir, shards, o);
+            if (!db.open()) return 1;
+            std::vector<std::thread> workers;
+            bench::Timer timer;
+            for (int t = 0; t < threads; ++t)
+                workers.emplace_back([&, t] {
+                    std::mt19937_64 rng(t + 1);
+                    const std::string value = bench::make_value(rng, value_size);
+                    for (size_t i = 0; i < ops; ++i)
+                        if (!db.put(bench::make_key(rng()), value)) std::abort();
+                });
+            for (auto& w : workers) w.join();
+            std::string name = "put shards=" + std::to_string(shards) + " t=" + std::to_string(threads);
+            bench::report(name.c_str(), ops * threads, timer.elapsed_sec());
+        }
+    }
+    std::filesystem::remove_all(dir);
+    return 0;
+}
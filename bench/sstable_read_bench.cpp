@@ -0,0 +1,88 @@
+// Compares SSTable point lookups in Syscall mode (pread per probe), Syscall
+// mode behind a block cache, and Mmap mode (decode from the mapping held
+// since Open).
+//
+// usage: kv-sstable-bench [entries] [lookups] [value_size]
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#include "bench_util.h"
+#include "sstable.h"
+
+namespace fs = std::filesystem;
+
+static void run_lookups(const char* name, const SSTable& t, const std::vector<std::string>& keys,
+                        size_t* found) {
+    std::string out;
+    size_t hits = 0;
+    bench::Timer timer;
+    for (const auto& k : keys) {
+        if (t.Probe(k, &out) == SSTable::ProbeKind::Put) ++hits;
+    }
+    bench::report(name, keys.size(), timer.elapsed_sec());
+    *found = hits;
+}
+
+int main(int argc, char** argv) {
+    size_t entries = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+    size_t lookups = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 200000;
+    size_t value_size = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 100;
+
+    const std::string dir = "bench_data/sstable_read";
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir, ec);
+
+    std::mt19937_64 rng(42);
+    std::vector<std::pair<std::string, MemValue>> snap;
+    snap.reserve(entries);
+    for (size_t i = 0; i < entries; ++i) {
+        // even keys only, so odd keys are guaranteed misses inside the key range
+        snap.emplace_back(bench::make_key(i * 2), MemValue{RecType::Put, bench::make_value(rng, value_size)});
+    }
+
+    std::string path;
+    bench::Timer build_timer;
+    if (!SSTable::Build(dir, 1, snap, &path)) {
+        std::cerr << "build failed\n";
+        return 1;
+    }
+    bench::report("build", entries, build_timer.elapsed_sec());
+
+    std::vector<std::string> hit_keys, miss_keys;
+    hit_keys.reserve(lookups);
+    miss_keys.reserve(lookups);
+    for (size_t i = 0; i < lookups; ++i) {
+        uint64_t n = rng() % entries;
+        hit_keys.push_back(bench::make_key(n * 2));
+        miss_keys.push_back(bench::make_key(n * 2 + 1));
+    }
+
+    BlockCache cache(64 << 20);
+    SSTableOptions cached_opts;
+    cached_opts.read_mode = SSTReadMode::Syscall;
+    cached_opts.block_cache = &cache;
+
+    SSTable sys, cached, mm;
+    if (!sys.Open(path, {SSTReadMode::Syscall}) || !cached.Open(path, cached_opts) ||
+        !mm.Open(path, {SSTReadMode::Mmap})) {
+        std::cerr << "open failed\n";
+        return 1;
+    }
+
+    size_t found = 0;
+    run_lookups("syscall/hit", sys, hit_keys, &found);
+    if (found != lookups) std::cerr << "syscall/hit: expected " << lookups << " got " << found << "\n";
+    run_lookups("syscall/miss", sys, miss_keys, &found);
+    run_lookups("syscall+cache/hit", cached, hit_keys, &found);
+    run_lookups("syscall+cache/hit (warm)", cached, hit_keys, &found);
+    run_lookups("syscall+cache/miss", cached, miss_keys, &found);
+    run_lookups("mmap/hit", mm, hit_keys, &found);
+    if (found != lookups) std::cerr << "mmap/hit: expected " << lookups << " got " << found << "\n";
+    run_lookups("mmap/miss", mm, miss_keys, &found);
+
+    fs::remove_all(dir, ec);
+    return 0;
+}
@@ -0,0 +1,62 @@
+// Crash-recovery cost: WAL replay into each MemTable rep, and a full
+// Engine::open (replay + writing the replayed data to L0), for logs of
+// 4 / 16 / 64 MiB.
+//
+// usage: kv-startup-bench [value_size] [dir]
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+
+#include "bench_util.h"
+#include "engine.h"
+#include "wal.h"
+
+int main(int argc, char** argv) {
+    size_t value_size = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100;
+    std::string dir = argc > 2 ? argv[2] : "startup_bench_data";
+
+    std::mt19937_64 rng(42);
+    const std::string value = bench::make_value(rng, value_size);
+    const size_t record = WAL::kRecordHeader + 16 + value_size;
+
+    for (size_t mib : {4, 16, 64}) {
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        // a crashed engine's only segment: random key order, like live traffic
+        const std::string log = dir + "/000001.log";
+        size_t records = mib * 1024 * 1024 / record;
+        {
+            WAL wal(log);
+            if (!wal.open()) return 1;
+            for (size_t i = 0; i < records; ++i)
+                if (!wal.appendPut(bench::make_key(rng() % records), value)) return 1;
+        }
+        const double bytes = static_cast<double>(std::filesystem::file_size(log));
+
+        for (MemTableRep rep : {MemTableRep::Map, MemTableRep::SkipList}) {
+            MemTable mem(rep);
+            WAL wal(log);
+            bench::Timer timer;
+            if (!wal.open() || !wal.replay(mem)) return 1;
+            double secs = timer.elapsed_sec();
+            std::string name = "replay " + std::to_string(mib) + "MiB " +
+                               (rep == MemTableRep::Map ? "map" : "skiplist");
+            bench::report(name.c_str(), records, secs);
+            std::printf("%-32s %10.1f MiB/s\n", "", bytes / (1 << 20) / secs);
+        }
+
+        EngineOptions o;
+        o.mem_flush_threshold_bytes = 256 << 20;  // replayed data stays in one table
+        o.compaction.background = false;
+        bench::Timer timer;
+        {
+            Engine db(dir, o);
+            if (!db.open()) return 1;
+        }
+        std::string name = "engine open " + std::to_string(mib) + "MiB";
+        bench::report(name.c_str(), records, timer.elapsed_sec());
+    }
+    std::filesystem::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,49 @@
+// Durable WAL appends (each put waits for fdatasync) from 1..16 threads
+// sharing one log. With group commit the syncs per put fall as writers are
+// added, so throughput grows with the writer count.
+//
+// usage: kv-wal-bench [puts_per_thread] [value_size] [dir]
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "wal.h"
+
+int main(int argc, char** argv) {
+    size_t puts = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000;
+    size_t value_size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100;
+    std::string dir = argc > 3 ? argv[3] : "wal_bench_data";
+
+    std::mt19937_64 rng(42);
+    const std::string value = bench::make_value(rng, value_size);
+    std::filesystem::create_directories(dir);
+    const std::string path = dir + "/bench.log";
+
+    for (int threads : {1, 2, 4, 8, 16}) {
+        std::filesystem::remove(path);
+        WAL wal(path);
+        if (!wal.open()) return 1;
+
+        std::vector<std::thread> workers;
+        bench::Timer timer;
+        for (int t = 0; t < threads; ++t)
+            workers.emplace_back([&, t] {
+                for (size_t i = 0; i < puts; ++i)
+                    if (!wal.appendPut(bench::make_key(t * puts + i), value, /*sync=*/true)) std::abort();
+            });
+        for (auto& w : workers) w.join();
+        double secs = timer.elapsed_sec();
+
+        uint64_t total = puts * threads;
+        std::string name = "sync put  t=" + std::to_string(threads);
+        bench::report(name.c_str(), total, secs);
+        std::printf("%-32s %10.2f puts/sync %8.2f puts/write\n", "", static_cast<double>(total) / wal.syncs(),
+                    static_cast<double>(total) / wal.groups());
+    }
+    std::filesystem::remove_all(dir);
+    return 0;
+}
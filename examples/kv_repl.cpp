@@ -1,4 +1,6 @@
 #include "engine.h"
+#include "perf_context.h"
+#include <cstring>
 #include <iostream>
 #include <sstream>
 
@@ -8,16 +10,32 @@ static void help() {
       << "  put <key> <value...>\n"
       << "  get <key>\n"
       << "  del <key>\n"
+      << "  scan [start] [end] [limit]   # keys in [start, end), '-' = unbounded\n"
       << "  flush           # force flush MemTable -> SSTable\n"
-      << "  list            # list SSTables\n"
-      << "  sync            # fsync WAL\n"
-      << "  stats           # mem size/bytes\n"
+      << "  compact         # run pending compactions now\n"
+      << "  list            # list SSTables per level\n"
+      << "  sync            # fdatasync WAL\n"
+      << "  stats           # mem size/bytes, bloom filter and block cache counters,\n"
+      << "                  # engine tickers, latency histograms and amplification\n"
+      << "  stats prom      # the same as Prometheus text\n"
+      << "  perf off|counts|timings   # print each get's perf context\n"
       << "  help\n"
       << "  exit | quit\n";
 }
 
-int main() {
-    Engine db("data", /*flush threshold*/ 256 * 1024); // 256KB for easy testing
+// usage: kv-repl [none|periodic|sync]   (WAL durability, default none)
+int main(int argc, char** argv) {
+    EngineOptions opts;
+    opts.mem_flush_threshold_bytes = 256 * 1024; // 256KB for easy testing
+    if (argc > 1) {
+        if (!std::strcmp(argv[1], "periodic")) opts.wal_sync = WalSyncMode::Periodic;
+        else if (!std::strcmp(argv[1], "sync")) opts.wal_sync = WalSyncMode::EveryWrite;
+        else if (std::strcmp(argv[1], "none")) {
+            std::cerr << "usage: kv-repl [none|periodic|sync]\n";
+            return 1;
+        }
+    }
+    Engine db("data", opts);
     if (!db.open()) {
         std::cerr << "Failed to open engine\n";
         return 1;
@@ -45,8 +63,10 @@ int main() {
         if (cmd == "get") {
             std::string key; iss >> key;
             if (key.empty()) { std::cout << "usage: get <key>\n"; continue; }
+            perf_context().reset();
             auto v = db.get(key);
             if (v) std::cout << *v << "\n"; else std::cout << "(nil)\n";
+            if (perf_level() != PerfLevel::Off) std::cout << "perf: " << perf_context().to_string() << "\n";
             continue;
         }
         if (cmd == "del") {
@@ -55,14 +75,58 @@ int main() {
             if (!db.del(key)) std::cout << "ERR\n"; else std::cout << "OK\n";
             continue;
         }
+        if (cmd == "scan") {
+            std::string start, end;
+            size_t limit = 100;
+            iss >> start >> end >> limit;
+            ReadOptions ro;
+            if (start != "-") ro.lower_bound = start;
+            if (end != "-") ro.upper_bound = end;
+            auto it = db.NewIterator(ro);
+            size_t n = 0;
+            for (it->SeekToFirst(); it->Valid() && n < limit; it->Next(), ++n)
+                std::cout << it->key() << " = " << it->value() << "\n";
+            if (!it->ok()) std::cout << "ERR\n";
+            else std::cout << "(" << n << " keys)\n";
+            continue;
+        }
         if (cmd == "flush") {
             if (!db.flush()) std::cout << "ERR\n"; else std::cout << "OK\n";
             continue;
         }
+        if (cmd == "compact") { std::cout << (db.compact() ? "OK\n" : "ERR\n"); continue; }
         if (cmd == "list") { db.list_tables(); continue; }
         if (cmd == "sync") { std::cout << (db.sync() ? "OK\n" : "ERR\n"); continue; }
+        if (cmd == "perf") {
+            std::string arg; iss >> arg;
+            if (arg == "off") set_perf_level(PerfLevel::Off);
+            else if (arg == "counts") set_perf_level(PerfLevel::Counts);
+            else if (arg == "timings") set_perf_level(PerfLevel::Timings);
+            else { std::cout << "usage: perf off|counts|timings\n"; continue; }
+            std::cout << "OK\n";
+            continue;
+        }
         if (cmd == "stats") {
-            std::cout << "mem.size=" << db.mem_size() << " mem.bytes=" << db.mem_bytes() << "\n";
+            std::string arg; iss >> arg;
+            if (arg == "prom") {
+                std::cout << db.prometheus_text();
+                continue;
+            }
+            std::cout << "mem.size=" << db.mem_size() << " mem.bytes=" << db.mem_bytes()
+                      << " mem.immutable=" << db.num_immutable_memtables()
+                      << " write_stalls=" << db.write_stalls()
+                      << " wal.background_syncs=" << db.background_syncs() << "\n";
+            const auto& fs = db.filter_stats();
+            std::cout << "bloom.useful=" << fs.useful.load()
+                      << " bloom.positive=" << fs.positive.load()
+                      << " bloom.false_positive=" << fs.false_positive.load() << "\n";
+            if (const auto* cache = db.block_cache()) {
+                auto cs = cache->stats();
+                std::cout << "cache.hits=" << cs.hits << " cache.misses=" << cs.misses
+                          << " cache.evictions=" << cs.evictions
+                          << " cache.usage=" << cs.usage << "/" << cs.capacity << "\n";
+            }
+            std::cout << db.stats().to_string();
             continue;
         }
 
@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+// Bump allocator for MemTable contents. Memory comes from 4 KiB blocks (a
+// large request gets a block of its own) and is only returned when the arena
+// is destroyed or reset(), in one go.
+//
+// allocate() may be called from several threads: the common case is one
+// fetch_add on the current block; only starting a new block takes a mutex.
+class Arena {
+   public:
+    static constexpr size_t kBlockSize = 4096;
+
+    Arena() = default;
+    ~Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // n bytes aligned to `align` (a power of two, at most alignof(max_align_t)).
+    char* allocate(size_t n, size_t align = alignof(std::max_align_t));
+
+    // Copy [p, p + n) into the arena (byte aligned).
+    char* copy(const char* p, size_t n);
+
+    // Every byte held, including block tails too small for the next request.
+    size_t memory_usage() const { return usage_.load(std::memory_order_relaxed); }
+
+    // Free every block. Needs exclusive access.
+    void reset();
+
+   private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size = 0;
+        std::atomic<size_t> used{0};
+    };
+
+    char* allocate_fallback(size_t n, size_t align, Block* seen);
+    Block* new_block(size_t size);  // mu_ held
+
+    std::atomic<Block*> current_{nullptr};
+    std::mutex mu_;                              // guards blocks_
+    std::vector<std::unique_ptr<Block>> blocks_;
+    std::atomic<size_t> usage_{0};
+};
+
+// std::pmr adapter so standard containers can allocate their nodes from an
+// arena; deallocate() is a no-op.
+class ArenaResource final : public std::pmr::memory_resource {
+   public:
+    explicit ArenaResource(Arena* arena) : arena_(arena) {}
+
+   private:
+    void* do_allocate(size_t bytes, size_t align) override { return arena_->allocate(bytes, align); }
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    Arena* arena_;
+};
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "memtable.h"  // RecType
+
+// Block encoding used by SSTable V2/V3 for both data and index blocks.
+//
+//   entry*:  varint32 shared | varint32 non_shared | varint32 value_len | u8 type
+//            | [varint64 seq] | key bytes [shared..shared+non_shared) | value bytes
+//   restarts: u32 offset[num_restarts] | u32 num_restarts
+//
+// Each entry stores only the suffix of its key that differs from the previous
+// key. Every `restart_interval`-th entry is a restart point: it stores its full
+// key (shared == 0) and its offset is listed in the restart array, so a seek
+// binary searches the restarts and then decodes at most restart_interval entries.
+//
+// seq is present only in blocks built with_seq (V3 data blocks); they may
+// hold several versions of a key, added newest (highest seq) first.
+
+class BlockBuilder {
+   public:
+    explicit BlockBuilder(int restart_interval = 16, bool with_seq = false);
+
+    // Keys must be added in increasing order. A key may repeat: the versions
+    // in a with_seq block (decreasing seqs), or the index entries of the
+    // blocks one key's versions run across.
+    void add(std::string_view key, RecType type, std::string_view value, SequenceNumber seq = 0);
+
+    // Append the restart array; the returned view is valid until reset().
+    std::string_view finish();
+    void reset();
+
+    bool empty() const { return counter_total_ == 0; }
+    size_t size_estimate() const { return buf_.size() + (restarts_.size() + 1) * sizeof(uint32_t); }
+    const std::string& last_key() const { return last_key_; }
+
+   private:
+    int restart_interval_;
+    bool with_seq_;
+    std::string buf_;
+    std::vector<uint32_t> restarts_;
+    int counter_ = 0;  // entries since the last restart
+    size_t counter_total_ = 0;
+    std::string last_key_;
+    bool finished_ = false;
+};
+
+// Forward iterator with Seek over one block. Holds a view of the contents;
+// the caller keeps the underlying bytes alive.
+class BlockIter {
+   public:
+    BlockIter() = default;
+    explicit BlockIter(std::string_view contents, bool with_seq = false);
+
+    bool ok() const { return !corrupt_; }  // false if the block failed to parse
+    bool Valid() const { return valid_; }
+
+    void SeekToFirst();
+    void Seek(std::string_view target);  // first entry with key >= target
+    void Next();
+
+    std::string_view key() const { return key_; }
+    std::string_view value() const { return value_; }
+    RecType type() const { return type_; }
+    SequenceNumber seq() const { return seq_; }  // 0 unless with_seq
+
+   private:
+    uint32_t restart_point(uint32_t i) const;
+    void seek_to_restart(uint32_t i);
+    bool parse_next();
+    void mark_corrupt();
+
+    const char* data_ = nullptr;
+    uint32_t restarts_off_ = 0;  // entries occupy [0, restarts_off_)
+    uint32_t num_restarts_ = 0;
+    uint32_t next_ = 0;          // offset of the entry after the current one
+    bool with_seq_ = false;
+
+    std::string key_;
+    std::string_view value_;
+    RecType type_ = RecType::Put;
+    SequenceNumber seq_ = 0;
+    bool valid_ = false;
+    bool corrupt_ = false;
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Capacity-bounded cache of raw SSTable blocks keyed by (file_id, offset),
+// shared by every table of an Engine. Split into 2^shard_bits independently
+// locked LRU shards so concurrent lookups rarely contend on one mutex.
+//
+// Values are handed out as shared_ptr, so a block evicted while a reader is
+// still decoding it stays alive until that reader drops its handle.
+class BlockCache {
+   public:
+    using Handle = std::shared_ptr<const std::string>;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t inserts = 0;
+        uint64_t evictions = 0;
+        size_t usage = 0;     // bytes currently charged
+        size_t capacity = 0;  // byte budget
+    };
+
+    explicit BlockCache(size_t capacity_bytes, int shard_bits = 4);
+    BlockCache(const BlockCache&) = delete;
+    BlockCache& operator=(const BlockCache&) = delete;
+
+    Handle lookup(uint64_t file_id, uint64_t offset);
+    // Insert (or replace) a block and return a handle to it.
+    Handle insert(uint64_t file_id, uint64_t offset, std::string contents);
+
+    Stats stats() const;
+    size_t capacity() const { return capacity_; }
+
+   private:
+    struct Key {
+        uint64_t file_id;
+        uint64_t offset;
+        bool operator==(const Key& o) const { return file_id == o.file_id && offset == o.offset; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const;
+    };
+    struct Entry {
+        Key key;
+        Handle value;
+        size_t charge;
+    };
+    struct Shard {
+        mutable std::mutex mu;
+        std::list<Entry> lru;  // front = most recently used
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> map;
+        size_t usage = 0;
+        size_t capacity = 0;
+    };
+
+    Shard& shard_for(const Key& k);
+
+    size_t capacity_;
+    int shard_bits_;
+    std::vector<Shard> shards_;
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> inserts_{0};
+    std::atomic<uint64_t> evictions_{0};
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Blocked Bloom filter: every key maps to a single 64-byte block (one cache
+// line) and sets all of its probe bits inside that block, so a lookup costs
+// one cache miss regardless of the number of probes.
+//
+// Serialized layout (little-endian):
+//   u32 num_blocks, u32 num_probes, then num_blocks * 64 bytes of bits
+
+struct FilterStats {
+    std::atomic<uint64_t> useful{0};          // filter said "absent": table not searched
+    std::atomic<uint64_t> positive{0};        // filter said "maybe": table searched
+    std::atomic<uint64_t> false_positive{0};  // ...and the key was not there
+};
+
+class BloomFilterBuilder {
+   public:
+    explicit BloomFilterBuilder(int bits_per_key);
+
+    void add(std::string_view key);
+    size_t num_keys() const { return hashes_.size(); }
+
+    // Serialize the filter for all keys added so far.
+    std::string finish() const;
+
+   private:
+    int bits_per_key_;
+    std::vector<uint64_t> hashes_;
+};
+
+class BloomFilter {
+   public:
+    // Parse a block produced by BloomFilterBuilder::finish(). Copies the bits
+    // into cache-line aligned storage.
+    bool load(std::string_view data);
+
+    bool empty() const { return blocks_.empty(); }
+    bool may_contain(std::string_view key) const;
+    size_t bytes() const { return blocks_.size() * sizeof(Block); }
+
+   private:
+    struct alignas(64) Block {
+        uint64_t words[8];
+    };
+    std::vector<Block> blocks_;
+    uint32_t num_probes_ = 0;
+};
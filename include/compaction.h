@@ -0,0 +1,94 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "version.h"
+
+struct CompactionOptions {
+    bool background = true;              // run compactions on the engine's own thread
+    int num_levels = 7;
+    int l0_compaction_trigger = 4;       // compact L0 once it holds this many tables
+    uint64_t level1_max_bytes = 16ull * 1024 * 1024;
+    int level_size_multiplier = 10;      // max_bytes(Ln+1) = max_bytes(Ln) * multiplier
+    uint64_t target_file_size = 4ull * 1024 * 1024;  // split outputs at about this size
+};
+
+// One unit of compaction work: merge `inputs` (from `level`) with the
+// overlapping `next_inputs` (from level + 1) into new level + 1 tables.
+struct Compaction {
+    int level = 0;
+    std::vector<TableRef> inputs;       // L0: newest first; L1+: sorted
+    std::vector<TableRef> next_inputs;  // sorted
+    // No deeper level holds data in the compacted key range, so tombstones
+    // have nothing left to shadow and can be dropped.
+    bool bottommost = false;
+    // Live snapshots (ascending) when the compaction was picked; snapshots
+    // taken later see every version in the inputs anyway.
+    std::vector<SequenceNumber> snapshots;
+
+    int output_level() const { return level + 1; }
+    // A lone table with nothing to merge against just changes level.
+    bool trivial_move() const { return inputs.size() == 1 && next_inputs.empty(); }
+};
+
+// Decides which versions a flush or compaction writes out. Fed every
+// version in (key ascending, seq descending) order, it drops a version when
+// a newer one of the same key is visible to every reader that could see it,
+// i.e. no live snapshot falls between the two. With bottommost, a tombstone
+// visible to every snapshot goes too, taking the versions below it along.
+class VersionFilter {
+   public:
+    VersionFilter(std::vector<SequenceNumber> snapshots, bool bottommost)
+        : snapshots_(std::move(snapshots)), bottommost_(bottommost) {}
+
+    bool keep(std::string_view key, SequenceNumber seq, RecType type);
+
+   private:
+    std::vector<SequenceNumber> snapshots_;  // ascending
+    bool bottommost_;
+    std::string last_key_;
+    bool has_last_ = false;
+    size_t last_stripe_ = 0;  // stripe of the last version of last_key_ seen
+};
+
+// Score of each level: L0 by table count, L1+ by bytes against its budget.
+// A level with score >= 1 needs compaction; the last level never does.
+double compaction_score(const Version& v, const CompactionOptions& o, int level);
+bool needs_compaction(const Version& v, const CompactionOptions& o);
+
+// Pick the highest-scoring level. L0 takes all of its tables; L1+ takes the
+// first table after compact_pointer[level] (round robin through the key
+// space) and advances it.
+std::optional<Compaction> pick_compaction(const Version& v, const CompactionOptions& o,
+                                          std::vector<std::string>& compact_pointer);
+
+// A finished table of a compaction or value log GC.
+struct CompactionOutput {
+    std::string path;
+    std::vector<ValueLogUsage> value_logs;   // the logs its ValueRefs point into
+};
+
+// Merge the inputs into new tables in `dir`, keeping the versions
+// VersionFilter keeps for c.snapshots; returns the finished tables in key
+// order. A key's versions never straddle two outputs. ValueRef entries are
+// copied as they are: the values stay where they are in their logs.
+bool run_compaction(const Compaction& c, const std::string& dir, const SSTableOptions& table_opts,
+                    uint64_t target_file_size, const std::function<uint64_t()>& new_file_id,
+                    std::vector<CompactionOutput>* outputs);
+
+// Value log GC: the log with the highest share of bytes no table points at,
+// if that share is at least o.gc_garbage_ratio. Logs an L0 table points
+// into are left alone; compaction moves those tables down soon anyway.
+std::optional<uint64_t> pick_value_log_gc(const Version& v, const ValueLogOptions& o);
+
+// Value log GC of one table: copy it to a new table in `dir`, every entry
+// as it is except that the values it points at in log `victim` are
+// appended to `log` and the entries pointed there instead. moved_bytes
+// grows by the size of the records moved.
+bool rewrite_value_refs(const SSTable& table, const ValueLog& victim, ValueLogBuilder* log,
+                        const std::string& dir, const SSTableOptions& table_opts, uint64_t file_id,
+                        CompactionOutput* output, uint64_t* moved_bytes);
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// CRC-32C (Castagnoli), as used by the v2 WAL. Uses the SSE4.2 crc32
+// instruction when the CPU has it (checked once at runtime), the ARMv8 CRC
+// instructions when built with them, and a slicing-by-8 table otherwise.
+namespace crc32c {
+
+// CRC of data appended to a stream whose CRC so far is `crc` (0 to start),
+// so a record can be checksummed piecewise without being copied together.
+uint32_t extend(uint32_t crc, const char* data, size_t n);
+
+inline uint32_t value(std::string_view data) { return extend(0, data.data(), data.size()); }
+
+// True if extend() runs on the hardware instructions.
+bool hardware();
+
+// The table version, whatever the CPU; for tests.
+uint32_t extend_portable(uint32_t crc, const char* data, size_t n);
+
+}  // namespace crc32c
@@ -0,0 +1,28 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "iterator.h"
+#include "version.h"
+
+// Concatenation of one L1+ level: tables sorted and disjoint, each opened
+// only when the scan reaches it. A non-empty upper_bound (exclusive) stops
+// before opening a table that starts at or past it.
+std::unique_ptr<Iterator> NewLevelIterator(std::vector<TableRef> tables, bool fill_cache,
+                                           std::string upper_bound = {});
+
+// Reads the value an encoded ValueRef points at; false on I/O error or
+// corruption.
+using ValueResolver = std::function<bool(std::string_view ref, std::string* value)>;
+
+// User-facing view of a merged iterator (children newest first) as of
+// `sequence`: yields the newest version of each key with seq <= sequence
+// only, hides deleted keys and keeps within [lower_bound, upper_bound); an
+// empty bound is unbounded. pin keeps the sources of `merged` alive and is
+// released after it. type() is always Put: ValueRef entries yield the value
+// `resolve` reads for them, and without a resolver fail the iterator.
+std::unique_ptr<Iterator> NewDBIterator(std::unique_ptr<Iterator> merged, std::string lower_bound,
+                                        std::string upper_bound, SequenceNumber sequence,
+                                        std::shared_ptr<const void> pin, ValueResolver resolve = {});
@@ -1,49 +1,294 @@
 #pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <set>
+#include <span>
 #include <string>
+#include <thread>
 #include <vector>
 #include <filesystem>
 
 #include "memtable.h"
 #include "wal.h"
+#include "write_batch.h"
 #include "sstable.h"
+#include "version.h"
+#include "compaction.h"
+#include "manifest.h"
+#include "iterator.h"
+#include "statistics.h"
 
+// When WAL appends are made durable with fdatasync.
+enum class WalSyncMode : uint8_t {
+    None,        // left to the OS and explicit sync() calls; a crash of the
+                 // machine can lose whatever was still in the page cache
+    Periodic,    // a background thread syncs every wal_sync_interval_ms, or
+                 // sooner once wal_sync_bytes have been appended
+    EveryWrite,  // put/del/write return once their record is on disk;
+                 // concurrent writers share each fdatasync (group commit)
+};
+
+struct EngineOptions {
+    size_t mem_flush_threshold_bytes = 4 * 1024 * 1024;
+    // Full memtables queued for the flush thread; writes stall beyond this.
+    size_t max_immutable_memtables = 2;
+    // Durability / latency trade-off of the write path.
+    WalSyncMode wal_sync = WalSyncMode::None;
+    uint32_t wal_sync_interval_ms = 100;    // Periodic
+    size_t wal_sync_bytes = 1 << 20;        // Periodic; 0 syncs on the timer only
+    // WAL segments are fallocate'd to this size, so appends do not change
+    // the file size; 0 = mem_flush_threshold_bytes + 1/8, at most 64 MiB.
+    size_t wal_preallocate_bytes = 0;
+    // Flushed segments kept (already allocated) for the next memtables to
+    // write into instead of being deleted.
+    size_t max_recycled_wals = 2;
+    // std::map (default) or the lock-free skip list.
+    MemTableRep memtable_rep = MemTableRep::Map;
+    // Byte budget of the block cache shared by all tables; 0 disables it.
+    size_t block_cache_bytes = 8 * 1024 * 1024;
+    // Read mode, Bloom bits per key, block size, ... Tables are read with
+    // pread() through the block cache by default; Mmap bypasses the cache.
+    SSTableOptions table{SSTReadMode::Syscall};
+    // Level layout, size ratios and whether a background thread compacts.
+    CompactionOptions compaction;
+    // Key-value separation: values at least value_log.min_value_size long
+    // go to value logs at flush (off by default).
+    ValueLogOptions value_log;
+};
+
+// A point-in-time view (Engine::GetSnapshot): reads through it see the
+// writes made before it was taken and none made after, and compaction keeps
+// the versions it needs until it is released.
+class Snapshot {
+public:
+    SequenceNumber sequence() const { return seq_; }
+
+private:
+    friend class Engine;
+    explicit Snapshot(SequenceNumber seq) : seq_(seq) {}
+    const SequenceNumber seq_;
+};
+
+// Options of a range scan (Engine::NewIterator).
+struct ReadOptions {
+    // Keys in [lower_bound, upper_bound); empty = unbounded. Tables and
+    // blocks entirely past upper_bound are never read.
+    std::string lower_bound;
+    std::string upper_bound;
+    bool fill_cache = true;     // false for one-off scans that should not evict hot blocks
+    const Snapshot* snapshot = nullptr;   // null: as of the iterator's creation
+};
+
+// Thread safety: put/del/write/flush and every read may be called from any
+// number of threads at once. Writers queue up and the one at the head
+// writes the whole queue as one WAL record and one memtable insert (group
+// commit); readers pin the current SuperVersion (copied under a short
+// sv_mu_ lock) and never take mu_ or wait on the write queue.
+//
+// Every write is numbered with the next sequence number, stored with the
+// record in the WAL, memtable and tables. A read sees the versions up to
+// one sequence number: the latest published one, or a Snapshot's.
 class Engine {
 public:
     explicit Engine(std::string data_dir, size_t mem_flush_threshold_bytes = 4 * 1024 * 1024);
+    Engine(std::string data_dir, const EngineOptions& opts);
     ~Engine();
 
-    bool open();        // load SSTables, open WAL, replay WAL -> MemTable
-    bool flush();       // MemTable -> SSTable (V0), WAL reset, clear MemTable
-    bool sync();        // fsync WAL
+    bool open();        // recover levels from MANIFEST, replay WAL segments, start threads
+    bool flush();       // hand the MemTable to the flush thread, wait until it is in L0
+    bool sync();        // fdatasync every WAL segment not yet flushed
+
+    // Compaction: with compaction.background the engine's thread is woken
+    // after each flush; compact() runs every needed compaction inline.
+    bool compact();
+    bool wait_for_compactions();   // until the background thread is idle; false if it failed
 
-    // Mutations
+    // Mutations; put/del/write return once their write is visible to get
     bool put(const std::string& key, const std::string& value);
     bool del(const std::string& key);
+    // All of the batch or none of it, also across a crash. An empty batch
+    // is a no-op.
+    bool write(const WriteBatch& batch);
 
-    // Lookup
-    std::optional<std::string> get(const std::string& key) const;
+    // Lookup, as of snapshot if given
+    std::optional<std::string> get(const std::string& key, const Snapshot* snapshot = nullptr) const;
+    // get() of every key, results in the same order. Keys are looked up in
+    // sorted order, so each table is probed once for the keys still
+    // unresolved and keys landing in the same block share its read.
+    std::vector<std::optional<std::string>> multi_get(std::span<const std::string_view> keys,
+                                                      const Snapshot* snapshot = nullptr) const;
+    // Sorted scan over the live keys: the newest value of each key, deleted
+    // keys hidden, as of ro.snapshot or else of the iterator's creation.
+    // Starts unpositioned; call SeekToFirst() or Seek().
+    std::unique_ptr<Iterator> NewIterator(const ReadOptions& ro = {}) const;
+
+    // Pin the current state for reads; every snapshot must be released.
+    const Snapshot* GetSnapshot();
+    void ReleaseSnapshot(const Snapshot* snapshot);
+    SequenceNumber last_sequence() const { return visible_seq_.load(std::memory_order_acquire); }
 
     // Debug / info
     void list_tables() const;
-    size_t mem_bytes() const { return mem_.bytes(); }
-    size_t mem_size()  const { return mem_.size();  }
+    size_t mem_bytes() const { return super_version()->mem->bytes(); }
+    size_t mem_size()  const { return super_version()->mem->size();  }
+    size_t num_immutable_memtables() const;
+    uint64_t write_stalls() const { return write_stalls_.load(); }
+    uint64_t background_syncs() const { return background_syncs_.load(); }   // Periodic WAL syncs
+    const FilterStats& filter_stats() const { return filter_stats_; }
+    const BlockCache* block_cache() const { return cache_.get(); }   // null if disabled
+    std::vector<size_t> level_table_counts() const;
+
+    // Tickers and latency / size histograms of every operation so far
+    const Statistics& stats() const { return *stats_; }
+    void reset_stats() { stats_->reset(); }
+    // stats() plus gauges (memtables, levels, per-table probe counts) and
+    // the filter and block cache counters, in Prometheus text format.
+    std::string prometheus_text() const;
 
 private:
-    bool load_existing_sstables();          // scan dir, open *.sst newest->oldest
-    uint64_t next_file_id() const;          // 1 + max existing id
-    static std::optional<uint64_t> parse_id(const std::filesystem::path& p);
+    // MANIFEST, or upgrade an older directory; returns the WAL segments found
+    bool load_existing_sstables(std::vector<uint64_t>* wal_segments);
+    bool recover_manifest(Version& v);
+    bool load_levels(const std::string& levels_path, Version& v);
+    VersionEdit snapshot_edit(const Version& v) const;   // one edit recreating v
+    uint64_t new_file_id() { return next_file_id_++; }
+    static std::optional<uint64_t> parse_id(const std::filesystem::path& p, const char* ext = ".sst");
+    std::string log_path(uint64_t number) const;   // data_dir_/NNNNNN.log
+
+    std::shared_ptr<const Version> current() const;
+
+    // Everything a read looks at, published as one immutable, ref-counted
+    // object: readers copy the pointer under sv_mu_, held for nothing else,
+    // and never take mu_ or wait on a writer; whatever it references stays
+    // alive while they hold it.
+    struct SuperVersion {
+        std::shared_ptr<const MemTable> mem;                  // active (still written to)
+        std::vector<std::shared_ptr<const MemTable>> imms;    // newest first
+        std::shared_ptr<const Version> version;
+    };
+    // With read_seq, also the sequence number to read it at: every version
+    // in its tables and switched-out memtables is at or below it.
+    std::shared_ptr<const SuperVersion> super_version(SequenceNumber* read_seq = nullptr) const {
+        std::lock_guard<std::mutex> g(sv_mu_);
+        if (read_seq) *read_seq = visible_seq_.load(std::memory_order_acquire);
+        return super_version_;
+    }
+    void install_super_version();           // mu_ held, after mem_, imm_ or current_ changed
+
+    // A put/del/write, or a flush's memtable switch, waiting in the write queue.
+    struct Writer {
+        RecType type = RecType::Put;        // single op: key (and value)
+        const std::string* key = nullptr;
+        const std::string* value = nullptr;
+        const WriteBatch* batch = nullptr;  // or a batch
+        bool force_switch = false;          // or neither: flush()
+        bool done = false;
+        bool ok = false;
+        std::condition_variable cv;
+    };
+    static constexpr size_t kMaxGroupBytes = 1 << 20;   // per leader write
+    bool write_queued(Writer& w);
+    bool write_group(const std::vector<Writer*>& group);   // leader only
+    // Apply the edit to a copy of the current version, log it to the
+    // MANIFEST, then publish it. `added` holds the opened edit.added tables,
+    // new_logs the value logs they point into that are new. Value logs no
+    // table points into any more are deleted once unpinned.
+    bool apply_edit(VersionEdit& edit, const std::vector<TableRef>& added,
+                    const std::vector<ValueLogRef>& new_logs = {});
+    // The value an encoded ValueRef of one of v's tables points at
+    bool read_value(const Version& v, std::string_view ref, std::string* value) const;
+
+    std::vector<SequenceNumber> live_snapshots() const;   // ascending, distinct
+    bool do_compaction(const Compaction& c);
+    // Value log GC: rewrite the tables pointing into log `number`, moving
+    // their values out of it, so it can be deleted.
+    bool collect_value_log(uint64_t number);
+    void maybe_schedule_compaction();
+    void bg_loop();
 
-    bool flush_if_needed();                 // internal helper
+    // A full memtable waiting for (or being written by) the flush thread,
+    // with the WAL segment holding its writes.
+    struct ImmMemTable {
+        std::shared_ptr<const MemTable> mem;
+        std::shared_ptr<WAL> wal;
+        uint64_t log_number = 0;
+    };
+
+    bool make_room_for_write();             // switch memtables once the active one is full
+    bool switch_memtable();                 // active -> imm_, fresh MemTable + WAL segment
+    // Open segment `number`, reusing a recycled file if there is one.
+    std::shared_ptr<WAL> new_segment(uint64_t number);
+    void retire_segment(uint64_t number);   // flushed: recycle or delete
+    // Write mem as an L0 table (nothing if empty) and log it with `edit`.
+    bool write_level0(const MemTable& mem, VersionEdit& edit);
+    void flush_loop();
+    // Periodic WAL sync: account appended bytes, and the timer thread
+    void note_wal_append(size_t bytes);
+    void sync_loop();
 
 private:
     std::string data_dir_;
-    size_t flush_threshold_;
+    EngineOptions opts_;
+    FilterStats filter_stats_;              // shared by every table we open
+    std::unique_ptr<Statistics> stats_;     // also handed to each WAL segment
+    std::unique_ptr<BlockCache> cache_;
+
+    // The active memtable and WAL segment are written by the write-queue
+    // leader only; swapping them and the imm_ queue is guarded by mu_.
+    std::shared_ptr<MemTable> mem_;
+    std::shared_ptr<WAL> wal_;              // data_dir_/<log_number_>.log
+    uint64_t log_number_ = 0;
+    std::deque<ImmMemTable> imm_;           // oldest first
+    std::vector<uint64_t> recycled_wals_;   // flushed segments to reuse, guarded by mu_
+
+    // Flushes and compactions publish a new version under mu_; each change
+    // of mem_, imm_ or current_ is republished in super_version_, which is
+    // all readers look at.
+    mutable std::mutex mu_;
+    std::shared_ptr<const Version> current_;
+    mutable std::mutex sv_mu_;              // only to copy or swap super_version_
+    std::shared_ptr<const SuperVersion> super_version_;
+
+    // Write queue: the head writer (the leader) owns mem_/wal_ for writing
+    // and writes every queued write as one group.
+    std::mutex write_mu_;                   // guards writers_
+    std::deque<Writer*> writers_;
+    WriteBatch group_batch_;                // leader only
+    SequenceNumber last_seq_ = 0;           // last one handed out; leader only
+    // Last sequence number whose write is in the memtable, published by the
+    // leader after the insert and before any memtable switch.
+    std::atomic<SequenceNumber> visible_seq_{0};
+    std::multiset<SequenceNumber> snapshots_;   // live Snapshots, guarded by mu_
+    std::mutex edit_mu_;                    // serializes apply_edit (flush vs compaction)
+    Manifest manifest_;                     // data_dir_/MANIFEST, appended under edit_mu_
+    std::atomic<uint64_t> next_file_id_{1};
+    uint64_t wal_number_ = 0;               // oldest WAL segment still needed, guarded by edit_mu_
+
+    std::mutex compaction_mu_;              // one compaction at a time
+    std::vector<std::string> compact_pointer_;  // per level, guarded by compaction_mu_
+
+    // background compaction thread; flags guarded by mu_
+    std::thread bg_thread_;
+    std::condition_variable bg_cv_;         // work scheduled / shutdown
+    std::condition_variable bg_idle_cv_;
 
-    mutable MemTable mem_;
-    WAL wal_;                               // append WAL at data_dir_/wal.log
+    // background flush thread
+    std::thread flush_thread_;
+    std::condition_variable flush_cv_;      // imm_ grew / shutdown
+    std::condition_variable imm_cv_;        // imm_ shrank: stalled writers, flush()
+    std::atomic<uint64_t> write_stalls_{0};
 
-    // newest -> oldest
-    std::vector<std::shared_ptr<SSTable>> tables_;
+    // periodic WAL sync thread (WalSyncMode::Periodic)
+    std::thread sync_thread_;
+    std::condition_variable sync_cv_;       // wal_sync_bytes reached / shutdown
+    std::atomic<size_t> unsynced_bytes_{0};
+    std::atomic<uint64_t> background_syncs_{0};
+    bool bg_scheduled_ = false;
+    bool bg_running_ = false;
+    bool bg_error_ = false;                 // a flush or compaction failed
+    std::atomic<bool> shutting_down_{false};
 };
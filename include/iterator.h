@@ -0,0 +1,36 @@
+#pragma once
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "memtable.h"  // RecType
+
+// Sorted cursor over (key, type, value) entries. Tombstones are surfaced as
+// entries with type() == RecType::Del; callers decide whether to hide them.
+// Sources that keep several versions of a key yield them newest (highest
+// seq()) first. key()/value() stay valid until the iterator is moved or
+// destroyed.
+class Iterator {
+   public:
+    virtual ~Iterator() = default;
+
+    virtual bool Valid() const = 0;
+    virtual void SeekToFirst() = 0;
+    virtual void Seek(std::string_view target) = 0;  // first entry with key >= target
+    virtual void Next() = 0;
+
+    virtual std::string_view key() const = 0;
+    virtual std::string_view value() const = 0;
+    virtual RecType type() const = 0;
+    virtual SequenceNumber seq() const { return 0; }
+
+    // False once an I/O error or corruption was hit; Valid() is false then too.
+    virtual bool ok() const { return true; }
+};
+
+// k-way merge of sorted children using a binary heap. Children are given
+// newest first: when several children hold the same key, all of them are
+// yielded, the highest seq() first and, on equal seqs, the newest child
+// first, so a caller keeping only the first entry of each key sees the
+// live version.
+std::unique_ptr<Iterator> NewMergingIterator(std::vector<std::unique_ptr<Iterator>> children);
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "value_log.h"
+
+// One atomic change to the table set. Flushes add an L0 table, compactions
+// remove their inputs and add their outputs in the same edit, so a crash
+// never exposes half a compaction.
+struct VersionEdit {
+    struct NewTable {
+        int level = 0;
+        uint64_t file_id = 0;
+        uint64_t file_size = 0;
+        std::string smallest;
+        std::string largest;
+        std::vector<ValueLogUsage> value_logs;   // the logs its ValueRefs point into
+    };
+    std::vector<std::pair<int, uint64_t>> removed;  // (level, file_id)
+    std::vector<NewTable> added;                     // applied after removals
+    std::optional<uint64_t> next_file_id;
+    // WAL segments numbered below this are fully persisted in tables.
+    std::optional<uint64_t> wal_number;
+    // Highest sequence number handed out so far; tables hold none above it.
+    std::optional<uint64_t> last_sequence;
+
+    void remove_table(int level, uint64_t file_id) { removed.emplace_back(level, file_id); }
+    void add_table(int level, uint64_t file_id, uint64_t file_size,
+                   std::string smallest, std::string largest,
+                   std::vector<ValueLogUsage> value_logs = {});
+
+    void encode(std::string* out) const;
+    bool decode(std::string_view in);
+};
+
+// Table set rebuilt by replaying a MANIFEST; metadata only, no files opened.
+struct ManifestState {
+    explicit ManifestState(int num_levels) : levels(num_levels) {}
+
+    std::vector<std::vector<VersionEdit::NewTable>> levels;  // L0 newest first
+    uint64_t next_file_id = 1;
+    uint64_t wal_number = 0;
+    uint64_t last_sequence = 0;
+    std::vector<uint64_t> removed_ids;  // every table some edit removed
+
+    bool apply(const VersionEdit& e);   // false if a level is out of range
+};
+
+// MANIFEST layout:
+//   Header: u32 magic 'KVMF' (0x4B564D46), u32 version=1
+//   Records: u32 crc32(payload), u32 payload_len, payload = encoded VersionEdit
+// A torn record at the tail (crash mid-append) is ignored on recovery.
+// The log is rewritten as a single snapshot edit on open and once it grows
+// past a size limit, via MANIFEST.tmp + fsync + rename.
+class Manifest {
+   public:
+    explicit Manifest(std::string dir);
+    ~Manifest();
+    Manifest(const Manifest&) = delete;
+    Manifest& operator=(const Manifest&) = delete;
+
+    const std::string& path() const { return path_; }
+    bool exists() const;
+
+    // Replay dir/MANIFEST into *st. False on I/O error or corruption.
+    bool recover(ManifestState* st) const;
+
+    // Replace the log with one edit describing the whole state and keep the
+    // new file open for appends.
+    bool rewrite(const VersionEdit& snapshot);
+
+    // Append one edit and fdatasync it.
+    bool append(const VersionEdit& e);
+
+    uint64_t size() const { return size_; }
+
+   private:
+    std::string dir_;
+    std::string path_;
+    int fd_ = -1;
+    uint64_t size_ = 0;
+};
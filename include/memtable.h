@@ -1,45 +1,79 @@
 #pragma once
 #include <cstdint>
-#include <map>
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
-enum class RecType : uint8_t { Put = 1, Del = 2 };
+class Iterator;
+class WriteBatch;
+
+// ValueRef only appears in tables: a Put whose value was moved to a value
+// log, the entry's value being the encoded ValueRef (value_log.h). 3 is
+// taken by the WAL's batch records.
+enum class RecType : uint8_t { Put = 1, Del = 2, ValueRef = 4 };
+
+// Every write gets the next sequence number; a read at sequence S sees the
+// versions with seq <= S. 0 is "older than any write" (tables and logs
+// written before sequence numbers existed, standalone memtables).
+using SequenceNumber = uint64_t;
+constexpr SequenceNumber kMaxSequence = UINT64_MAX;
 
 struct MemValue {
     RecType type;
     std::string value; // empty when Del
+    SequenceNumber seq = 0;
+};
+
+// In-memory index behind a MemTable; chosen at construction.
+enum class MemTableRep : uint8_t {
+    Map,       // std::map behind a shared_mutex
+    SkipList,  // lock-free skip list (skiplist.h): concurrent inserts, wait-free reads
 };
 
+// Both reps are safe to use from several threads at once, except clear(),
+// which needs exclusive access.
+//
+// A key keeps one version per sequence number: writing it again with a new
+// seq adds a version, with the same seq replaces that version. Versions of
+// a key must be added in increasing seq order (the engine's write queue
+// does that).
 class MemTable {
 public:
+    explicit MemTable(MemTableRep rep = MemTableRep::Map);
+    ~MemTable();
+    MemTable(const MemTable&) = delete;
+    MemTable& operator=(const MemTable&) = delete;
+
     // mutations
-    bool put(std::string key, std::string value);
-    bool del(std::string key);
+    bool put(std::string key, std::string value, SequenceNumber seq = 0);
+    bool del(std::string key, SequenceNumber seq = 0);
+    // every op, in order, in one pass; op i gets first_seq + i (all 0 if first_seq is 0)
+    bool apply(const WriteBatch& batch, SequenceNumber first_seq = 0);
 
-    // lookup
-    std::optional<MemValue> get(const std::string& key) const;
+    // lookup: newest version with seq <= snapshot
+    std::optional<MemValue> get(std::string_view key, SequenceNumber snapshot = kMaxSequence) const;
 
     // admin
     void   clear();
-    bool   empty() const { return kv_.empty(); }
-    size_t bytes() const { return bytes_; }           // engine uses this
-    size_t size()  const { return kv_.size(); }       // engine uses this
-
-    // optional iteration (useful for debugging)
-    using Iter = std::map<std::string, MemValue>::const_iterator;
-    Iter begin() const { return kv_.begin(); }
-    Iter end()   const { return kv_.end(); }
+    bool   empty() const { return size() == 0; }
+    size_t bytes() const;                             // arena bytes held; engine uses this
+    size_t size()  const;                             // distinct keys; engine uses this
+    MemTableRep rep() const { return kind_; }
 
-    // flush helper (engine calls this)
+    // flush helper (engine calls this): every version, keys ascending and
+    // each key's versions newest (highest seq) first
     void snapshot(std::vector<std::pair<std::string, MemValue>>& out) const;
 
-    // (optional) keep this ONLY if other files still call approxBytes()
-    // [[deprecated("Use bytes() instead")]]
-    // size_t approxBytes() const { return bytes(); }
+    // Sorted cursor over every version in the same order, tombstones
+    // included (type() == Del). Safe alongside writers, whose inserts it may
+    // or may not see. The MemTable must outlive it.
+    std::unique_ptr<Iterator> NewIterator() const;
+
+    class Rep;
 
 private:
-    std::map<std::string, MemValue> kv_;  // ordered for flush → SSTable
-    size_t bytes_ = 0;                     // rough size tracker
+    MemTableRep kind_;
+    std::unique_ptr<Rep> rep_;
 };
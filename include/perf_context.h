@@ -0,0 +1,86 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Per-thread breakdown of where an operation spent its work, for finding
+// out why one get() was slow. Off by default; each thread opts in:
+//
+//   set_perf_level(PerfLevel::Timings);
+//   perf_context().reset();
+//   db.get(key);
+//   std::cout << perf_context().to_string();
+//
+// The engine and tables add to the calling thread's context as they go;
+// nothing is reset for you, so a context accumulates until reset(). When
+// off, each instrumented point costs one thread-local load and a branch.
+enum class PerfLevel : uint8_t {
+    Off,       // nothing recorded
+    Counts,    // counters only
+    Timings,   // counters and the *_nanos phases (two clock reads each)
+};
+
+struct PerfContext {
+    // Counts
+    uint64_t memtable_lookups = 0;      // memtables searched
+    uint64_t tables_probed = 0;         // SSTable probes
+    uint64_t bloom_checks = 0;          // filter queries
+    uint64_t bloom_negatives = 0;       // ... that skipped the table
+    uint64_t index_comparisons = 0;     // keys compared searching table indexes
+    uint64_t restart_comparisons = 0;   // keys compared searching block restart arrays
+    uint64_t entries_scanned = 0;       // entries decoded walking to the key
+    uint64_t block_reads = 0;           // blocks (V0/V1: index intervals) loaded
+    uint64_t block_cache_hits = 0;      // ... found in the block cache
+    uint64_t value_log_reads = 0;       // separated values read (value_log.h)
+    uint64_t bytes_read = 0;            // bytes of those blocks and values
+    uint64_t read_syscalls = 0;         // pread() calls for them
+
+    // Timings (PerfLevel::Timings), in nanoseconds
+    uint64_t get_nanos = 0;             // whole Engine::get
+    uint64_t memtable_nanos = 0;        // memtable lookups
+    uint64_t index_seek_nanos = 0;      // filter check and index binary search
+    uint64_t block_read_nanos = 0;      // block cache lookup, pread, checksum
+    uint64_t block_seek_nanos = 0;      // restart search and scan in the block
+    uint64_t value_log_read_nanos = 0;  // reading separated values
+
+    void reset() { *this = PerfContext{}; }
+    // "name=value" for every non-zero field, space separated
+    std::string to_string() const;
+};
+
+namespace perf_detail {
+extern constinit thread_local PerfLevel level;
+extern constinit thread_local PerfContext context;
+}  // namespace perf_detail
+
+// The calling thread's level and context.
+inline void set_perf_level(PerfLevel l) { perf_detail::level = l; }
+inline PerfLevel perf_level() { return perf_detail::level; }
+inline PerfContext& perf_context() { return perf_detail::context; }
+
+// Add n to a counter of the calling thread's context, if counting.
+inline void perf_count(uint64_t PerfContext::*field, uint64_t n = 1) {
+    if (perf_detail::level >= PerfLevel::Counts) perf_detail::context.*field += n;
+}
+
+// Adds the nanoseconds from construction to destruction to a timing of the
+// calling thread's context, if timing.
+class PerfTimer {
+   public:
+    explicit PerfTimer(uint64_t PerfContext::*field)
+        : field_(perf_detail::level >= PerfLevel::Timings ? field : nullptr) {
+        if (field_) start_ = std::chrono::steady_clock::now();
+    }
+    ~PerfTimer() {
+        if (field_)
+            perf_detail::context.*field_ += static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_)
+                    .count());
+    }
+    PerfTimer(const PerfTimer&) = delete;
+    PerfTimer& operator=(const PerfTimer&) = delete;
+
+   private:
+    uint64_t PerfContext::*field_;
+    std::chrono::steady_clock::time_point start_;
+};
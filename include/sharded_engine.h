@@ -0,0 +1,88 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "engine.h"
+
+// Keys hash-partitioned across N independent Engines, each in its own
+// subdirectory (data_dir/shard-000, ...) with its own WAL, memtables,
+// write queue and flush and compaction threads, so writes to different
+// shards never contend.
+//
+// Same thread safety as Engine. put/del/get run on the calling thread in
+// the key's shard; multi_get, write, flush, sync and compact fan out to a
+// worker thread per shard and run the shards in parallel.
+//
+// Each shard is its own engine with its own sequence numbers: a write
+// batch is atomic within each shard only, and there are no snapshots
+// across shards. The shard count is recorded in data_dir/SHARDS and cannot
+// change once the directory exists.
+class ShardedEngine {
+public:
+    // opts apply to every shard (memtable size, WAL mode, ... are per
+    // shard), except block_cache_bytes, which is split evenly among them.
+    ShardedEngine(std::string data_dir, size_t num_shards, const EngineOptions& opts = {});
+    ~ShardedEngine();
+
+    bool open();   // every shard; false if data_dir holds another shard count
+    bool flush();
+    bool sync();
+    bool compact();
+    bool wait_for_compactions();
+
+    bool put(const std::string& key, const std::string& value);
+    bool del(const std::string& key);
+    // Split by shard; each part is applied atomically, but a failure or
+    // crash can leave some shards' parts applied and not others'.
+    bool write(const WriteBatch& batch);
+
+    std::optional<std::string> get(const std::string& key) const;
+    // Keys grouped by shard, each group one Engine::multi_get, the shards
+    // in parallel; results in the same order as keys.
+    std::vector<std::optional<std::string>> multi_get(std::span<const std::string_view> keys) const;
+    // Sorted scan merging every shard's iterator; null if ro.snapshot is set,
+    // as a snapshot belongs to a single shard.
+    std::unique_ptr<Iterator> NewIterator(const ReadOptions& ro = {}) const;
+
+    size_t num_shards() const { return shards_.size(); }
+    size_t shard_of(std::string_view key) const;
+    const Engine& shard(size_t i) const { return *shards_[i]; }
+
+private:
+    // Runs tasks for one shard, in the order posted.
+    class Worker {
+    public:
+        Worker();
+        ~Worker();
+        void post(std::function<void()> task);
+
+    private:
+        void loop();
+
+        std::mutex mu_;
+        std::condition_variable cv_;
+        std::deque<std::function<void()>> tasks_;
+        bool stop_ = false;
+        std::thread thread_;
+    };
+
+    // fn(i) for every listed shard, each on its worker except the last,
+    // which the caller runs itself; returns once all are done.
+    void run_on_shards(const std::vector<size_t>& shards, const std::function<void(size_t)>& fn) const;
+    bool run_on_all(const std::function<bool(Engine&)>& fn);   // true if fn was true for every shard
+    bool check_shard_count();   // create data_dir/SHARDS, or check it matches
+
+    std::string data_dir_;
+    std::vector<std::unique_ptr<Engine>> shards_;
+    std::vector<std::unique_ptr<Worker>> workers_;   // workers_[i] serves shards_[i]
+};
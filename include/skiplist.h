@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "arena.h"
+#include "memtable.h"  // RecType
+
+// Concurrent skip list mapping each key to its versions, newest first:
+// (type, value, seq) records chained through Value::prev.
+//
+// Writers: any number of threads may insert at once. A new node is linked
+// bottom-up with one CAS per level (a lost race re-searches that level from
+// the predecessor it already has); an existing key gets a new Value swapped
+// in with a CAS on the node's value pointer, the old one becoming its prev.
+//
+// Readers take no locks and never retry: every pointer they follow is
+// acquire-loaded, and nothing reachable is freed before the list itself, so
+// a lookup is bounded by the list height whatever the writers do.
+//
+// Nodes, keys and values live in the list's Arena and are released together
+// when the list is destroyed.
+class SkipList {
+    struct Node;
+
+   public:
+    struct Value {
+        RecType type;
+        uint32_t size;
+        const Value* prev;  // version this one replaced, kept alive for readers
+        const char* data;   // size bytes in the arena; empty for Del
+        SequenceNumber seq;
+
+        std::string_view value() const { return {data, size}; }
+    };
+
+    // First version in the chain starting at v with seq <= snapshot, or null.
+    static const Value* visible(const Value* v, SequenceNumber snapshot) {
+        while (v && v->seq > snapshot) v = v->prev;
+        return v;
+    }
+
+    SkipList();
+    ~SkipList();
+    SkipList(const SkipList&) = delete;
+    SkipList& operator=(const SkipList&) = delete;
+
+    // Insert key, or push a new version in front of its existing ones.
+    void upsert(std::string_view key, RecType type, std::string_view value, SequenceNumber seq = 0);
+
+    // Newest version of key with seq <= snapshot, or null.
+    const Value* find(std::string_view key, SequenceNumber snapshot = kMaxSequence) const;
+
+    size_t size() const { return size_.load(std::memory_order_relaxed); }  // distinct keys
+    size_t memory_usage() const { return arena_.memory_usage(); }
+
+    // Sorted walk; sees every insert that completed before it reached that key.
+    class Iter {
+       public:
+        explicit Iter(const SkipList* list) : list_(list) {}
+        bool Valid() const { return node_ != nullptr; }
+        void SeekToFirst();
+        void Seek(std::string_view target);  // first key >= target
+        void Next();
+        std::string_view key() const;
+        const Value* value() const;  // newest version; older ones via prev
+
+       private:
+        const SkipList* list_;
+        const Node* node_ = nullptr;
+    };
+
+   private:
+    static constexpr int kMaxHeight = 12;
+    static constexpr unsigned kBranching = 4;  // 1 in 4 nodes reaches the next level
+
+    Node* new_node(std::string_view key, int height, const Value* v);
+    static int random_height();
+    static void replace(Node* n, Value* v);
+
+    // First node with key >= key.
+    Node* find_greater_or_equal(std::string_view key) const;
+    // Walk `level` forward from `before` (whose key is < key) to the pair
+    // before.key < key <= after.key.
+    static void find_splice_for_level(std::string_view key, int level, Node* before,
+                                      Node** out_prev, Node** out_next);
+
+    Arena arena_;
+    Node* head_;
+    std::atomic<int> max_height_{1};
+    std::atomic<size_t> size_{0};
+};
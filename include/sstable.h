@@ -1,44 +1,136 @@
 #pragma once
+#include <atomic>
 #include <cstdint>
+#include <memory>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 #include <vector>
 
+#include "block.h"
+#include "block_cache.h"
+#include "bloom.h"
+#include "iterator.h"
+#include "value_log.h"
 // Reuse your existing types
 #include "memtable.h"  // expects: enum class RecType { Put=1, Del=2 }; struct MemValue { RecType type; std::string value; }
 
+// How an opened table serves lookups.
+//   Syscall: pread() the index interval (V0/V1) or data block (V2) holding the
+//            key from an fd kept open for the table's lifetime, going through
+//            the block cache first when one is configured.
+//   Mmap:    map the whole file once in Open() and decode records in place;
+//            the page cache already holds the blocks, so no block cache.
+enum class SSTReadMode { Syscall,
+                         Mmap };
+
+struct SSTableOptions {
+    SSTReadMode read_mode = SSTReadMode::Mmap;
+
+    // Build: Bloom filter density; 0 writes no filter. ~1% false positives at 10.
+    int bloom_bits_per_key = 10;
+    // Build: target uncompressed size of a V2 data block, and how many entries
+    // share a key prefix chain before the next restart point.
+    size_t block_size = 4 * 1024;
+    int block_restart_interval = 16;
+    // Open: check the CRC of every data block read (index/filter are always checked).
+    bool verify_checksums = false;
+    // Open: optional sink for filter hit / false-positive counts (not owned).
+    FilterStats* filter_stats = nullptr;
+    // Open: optional cache for Syscall-mode block reads (not owned).
+    BlockCache* block_cache = nullptr;
+};
+
 struct SSTIndexRec {
-    std::string key;  // full key of the indexed entry
-    uint64_t offset;  // absolute file offset to the start of the entry in data section
+    std::string key;    // V0/V1: first key of the interval; V2: last key of the block
+    uint64_t offset;    // absolute file offset of the interval / block
+    uint64_t size = 0;  // V2: block size in bytes, excluding the CRC trailer
 };
 
 class SSTable {
+    friend class SSTableBuilder;
+    friend class SSTableIterator;
+
    public:
-    // Build a new table from a **sorted** and **deduplicated** snapshot.
-    // For each key, include exactly one MemValue; key order must be strict lexicographic ascending.
+    SSTable() = default;
+    ~SSTable();
+    SSTable(const SSTable&) = delete;
+    SSTable& operator=(const SSTable&) = delete;
+
+    // Build a new V3 table from a **sorted** snapshot: keys ascending, and
+    // several versions of a key (if any) with strictly decreasing seqs.
     static bool Build(const std::string& dir, uint64_t file_id,
                       const std::vector<std::pair<std::string, MemValue>>& entries,
-                      std::string* out_final_path = nullptr);
+                      std::string* out_final_path = nullptr,
+                      const SSTableOptions& opts = {});
 
-    // Open an existing table (e.g., "data/000001.sst"); loads sparse index into memory.
-    bool Open(const std::string& path);
+    // Open an existing table (e.g., "data/000001.sst") of any format version;
+    // loads the index and filter into memory. In Mmap mode the mapping is
+    // kept until the table is destroyed, in Syscall mode the fd.
+    bool Open(const std::string& path, const SSTableOptions& opts = {});
+    // Same, with the key range already known (recorded in the MANIFEST),
+    // which saves reading the first data block.
+    bool Open(const std::string& path, const SSTableOptions& opts,
+              std::string smallest, std::string largest);
 
-    // Lookup key in this table. Returns:
+    // Lookup the newest version of key. Returns:
     //   - std::optional<std::string>{"value"} if found as Put
-    //   - std::optional<std::string>{} (nullopt) if found as Del (tombstone) or absent
+    //   - std::optional<std::string>{} (nullopt) if found as Del (tombstone) or absent,
+    //     or as a ValueRef, which only the engine can resolve (use Probe)
     std::optional<std::string> Get(std::string_view key) const;
 
     const std::string& path() const { return path_; }
     uint64_t file_id() const { return file_id_; }
     size_t index_size() const { return index_.size(); }
+    uint64_t num_entries() const { return num_entries_; }  // 0 if unknown (V0/V1)
+    // Keys looked up in this table since it was opened (Probe, MultiProbe, Get)
+    uint64_t probes() const { return probes_.load(std::memory_order_relaxed); }
+    uint64_t file_size() const { return file_size_; }
+    // Key range covered by the table (both empty for an empty table).
+    const std::string& smallest_key() const { return smallest_; }
+    const std::string& largest_key() const { return largest_; }
+    // Value logs the table's ValueRef entries point into, as recorded in the
+    // MANIFEST; set once before the table is published.
+    const std::vector<ValueLogUsage>& value_logs() const { return value_logs_; }
+    void set_value_logs(std::vector<ValueLogUsage> usage) { value_logs_ = std::move(usage); }
+
+    // Full scan / range iterator, block by block. The table must outlive it.
+    // fill_cache=false keeps one-off scans (compaction) from evicting hot blocks.
+    // A non-empty upper_bound (exclusive) stops the scan before it loads a
+    // block holding only keys >= upper_bound; callers still check each key.
+    std::unique_ptr<Iterator> NewIterator(bool fill_cache = true, std::string upper_bound = {}) const;
+
+    // Delete the file once the last reference to this table is dropped
+    // (the table was compacted away but readers may still hold it).
+    void mark_obsolete() { obsolete_.store(true); }
+    SSTReadMode read_mode() const { return map_ ? SSTReadMode::Mmap : SSTReadMode::Syscall; }
+    uint32_t format_version() const { return version_; }
+    bool has_filter() const { return !filter_.empty(); }
+
+    // False only if the key is definitely not in this table (no filter => true).
+    bool MayContain(std::string_view key) const { return filter_.may_contain(key); }
 
     enum class ProbeKind { Absent,
                            Tombstone,
-                           Put };
+                           Put,
+                           ValueRef };   // a Put whose value is in a value log
 
-    // Probe key with tombstone awareness. If Put, fills *out.
-    ProbeKind Probe(std::string_view key, std::string* out) const;
+    // Probe key with tombstone awareness, looking at the newest version with
+    // seq <= snapshot. If Put, fills *out; if ValueRef, with the encoded ValueRef. bytes_read, if given, grows by the
+    // size of the blocks (V0/V1: index intervals) the probe loaded.
+    ProbeKind Probe(std::string_view key, std::string* out, SequenceNumber snapshot = kMaxSequence,
+                    uint64_t* bytes_read = nullptr) const;
+    // Probe many keys, sorted ascending, in one pass: keys falling in the
+    // same block (V0/V1: index interval) share one read. (*kinds)[i] and
+    // (*outs)[i] are the result for keys[i]; both are resized to fit.
+    void MultiProbe(std::span<const std::string_view> keys, std::vector<ProbeKind>* kinds,
+                    std::vector<std::string>* outs, SequenceNumber snapshot = kMaxSequence,
+                    uint64_t* bytes_read = nullptr) const;
+
+    // dir/NNNNNN.sst
+    static std::string file_name_for(const std::string& dir, uint64_t id);
+    static bool fsync_dir(const std::string& dir);
 
    private:
     // --- On-disk layout (V0) ---
@@ -50,37 +142,204 @@ class SSTable {
     //   repeated: u32 key_len, key bytes, u64 file_offset
     // Footer (fixed size):
     //   u64 index_offset, u32 index_count, u32 magic, u32 version
+    //
+    // --- V1 (version=2): V0 plus a Bloom filter block after the index ---
+    // Filter: BloomFilterBuilder::finish() bytes over every key (Put and Del)
+    // Footer (fixed size):
+    //   u64 index_offset, u32 index_count, u64 filter_offset, u32 filter_size,
+    //   u32 magic, u32 version
+    // filter_size == 0 means the table was built without a filter.
+    //
+    // --- V2 (version=3): block based ---
+    // Header: u32 magic, u32 version=3
+    // Data blocks (~block_size each, see block.h): prefix-compressed keys,
+    //   varint lengths, restart array; each followed by a u32 crc32 trailer
+    // Index block (block.h encoding, then u32 crc32): one entry per data block,
+    //   key = last key in the block, value = varint64 offset | varint64 size
+    // Filter block: BloomFilterBuilder::finish() bytes, then u32 crc32
+    // Footer (fixed size):
+    //   u64 index_offset, u32 index_size, u64 filter_offset, u32 filter_size,
+    //   u64 num_entries, u32 magic, u32 version
+    //
+    // --- V3 (version=4): V2 with a seq in every data block entry ---
+    // Data blocks are built with_seq (block.h) and may hold several versions
+    // of a key, newest first, possibly running on into the next block; the
+    // filter has each key once and num_entries counts versions. V0-V2
+    // entries read as seq 0.
 
     static constexpr uint32_t kMagic = 0x4B565354;  // 'K''V''S''T'
-    static constexpr uint32_t kVersion = 1;
-    static constexpr uint32_t kIndexInterval = 64;  // every 64 entries add an index record
+    static constexpr uint32_t kVersionV0 = 1;
+    static constexpr uint32_t kVersionV1 = 2;
+    static constexpr uint32_t kVersionV2 = 3;
+    static constexpr uint32_t kVersionV3 = 4;
+    static constexpr size_t kHeaderSize = 2 * sizeof(uint32_t);
+    static constexpr size_t kBlockTrailerSize = sizeof(uint32_t);  // crc32
+
+    static constexpr size_t kFooterSizeV0 = sizeof(uint64_t) + 3 * sizeof(uint32_t);
+    static constexpr size_t kFooterSizeV1 = 2 * sizeof(uint64_t) + 4 * sizeof(uint32_t);
+    static constexpr size_t kFooterSizeV2 = 3 * sizeof(uint64_t) + 4 * sizeof(uint32_t);
+
+    struct Footer {
+        uint64_t index_offset = 0;
+        uint32_t index_count = 0;  // V0/V1: number of index records
+        uint32_t index_size = 0;   // V2: index block size
+        uint64_t filter_offset = 0;
+        uint32_t filter_size = 0;
+        uint64_t num_entries = 0;  // V2 only
+        uint32_t version = 0;
+    };
 
     // helpers
-    static bool fsync_dir(const std::string& dir);
     static bool write_all(int fd, const void* p, size_t n);
     static bool read_all(int fd, void* p, size_t n);
-    static bool write_u32(int fd, uint32_t v);
-    static bool write_u64(int fd, uint64_t v);
-    static bool write_u8(int fd, uint8_t v);
+    static bool pread_all(int fd, void* p, size_t n, uint64_t off);
     static bool read_u32(int fd, uint32_t& v);
     static bool read_u64(int fd, uint64_t& v);
-    static bool read_u8(int fd, uint8_t& v);
 
-    static std::string file_name_for(const std::string& dir, uint64_t id);
     static std::string tmp_name_for(const std::string& dir, uint64_t id);
 
     // open-time helpers
-    bool read_footer(int fd, uint64_t& index_off, uint32_t& index_count) const;
-    bool load_index(int fd, uint64_t index_off, uint32_t index_count);
+    bool open_file(const std::string& path, const SSTableOptions& opts);  // all but the key range
+    bool read_footer(int fd, Footer& f) const;
+    bool load_index(int fd, uint64_t index_off, uint32_t index_count);       // V0/V1
+    bool load_index_block(int fd, uint64_t index_off, uint32_t index_size);  // V2
+    bool load_filter(int fd, uint64_t filter_off, uint32_t filter_size);
+    bool map_file(int fd);
+    bool load_key_range();
+    void release();
+
+    // Bytes [off, off+n) of the file: a view into the mapping, or a block-cache
+    // entry / fresh read kept alive by *holder. `trailer` extra bytes (the V2
+    // crc) are read along but not returned; verified if verify_checksums is set.
+    bool read_region(uint64_t off, uint64_t n, size_t trailer,
+                     BlockCache::Handle* holder, std::string_view* out,
+                     bool fill_cache = true) const;
+    bool read_block(const SSTIndexRec& h, BlockCache::Handle* holder, std::string_view* out,
+                    bool fill_cache = true) const;
 
-    // scan from offset for target key (returns Put/Del/Absent)
+    // search for target key (returns Put/Del/Absent)
     enum class ScanResult { Absent,
                             Put,
-                            Del };
-    ScanResult scan_for_key(int fd, uint64_t start_off, std::string_view key, std::string* out) const;
+                            Del,
+                            ValueRef };
+    // The region a lookup last read; a following lookup landing in the same
+    // one (MultiProbe) reuses it instead of reading it again.
+    struct LastRegion {
+        uint64_t offset = UINT64_MAX;
+        BlockCache::Handle holder;
+        std::string_view contents;
+        uint64_t bytes = 0;   // total size of the regions read into it
+    };
+    ScanResult scan_records(std::string_view region, std::string_view key, std::string* out) const;  // V0/V1
+    ScanResult lookup_v0(std::string_view key, std::string* out, LastRegion* last) const;
+    ScanResult lookup_v2(std::string_view key, std::string* out, LastRegion* last, SequenceNumber snapshot) const;
+    ScanResult lookup(std::string_view key, std::string* out, LastRegion* last, SequenceNumber snapshot) const;
+    bool has_seq() const { return version_ >= kVersionV3; }
+    static ProbeKind probe_kind(ScanResult r);
 
    private:
     std::string path_;
     uint64_t file_id_ = 0;
     std::vector<SSTIndexRec> index_;
+    uint64_t data_end_ = 0;  // == index_offset; records never extend past it
+    uint32_t version_ = 0;
+    uint64_t num_entries_ = 0;  // V2 only
+    uint64_t file_size_ = 0;
+    std::string smallest_, largest_;
+    std::vector<ValueLogUsage> value_logs_;
+    std::atomic<bool> obsolete_{false};
+    mutable std::atomic<uint64_t> probes_{0};
+    bool verify_checksums_ = false;
+    BloomFilter filter_;
+    FilterStats* filter_stats_ = nullptr;
+    BlockCache* cache_ = nullptr;
+
+    // Mmap mode only
+    const char* map_ = nullptr;
+    size_t map_size_ = 0;
+    // Syscall mode only
+    int fd_ = -1;
+};
+
+// Iterator over one table (see SSTable::NewIterator).
+class SSTableIterator final : public Iterator {
+   public:
+    SSTableIterator(const SSTable* t, bool fill_cache, std::string upper_bound = {});
+
+    bool Valid() const override { return valid_; }
+    void SeekToFirst() override;
+    void Seek(std::string_view target) override;
+    void Next() override;
+    std::string_view key() const override;
+    std::string_view value() const override;
+    RecType type() const override;
+    SequenceNumber seq() const override;
+    bool ok() const override { return ok_; }
+
+   private:
+    bool load(size_t i);  // region i = V2 data block i / V0 index interval i
+    bool parse_v0();
+    void skip_forward();
+    bool fail();
+    bool past_upper_bound(size_t i) const;  // regions after i are all >= upper_
+
+    const SSTable* t_;
+    bool fill_cache_;
+    std::string upper_;  // empty: unbounded
+    bool v2_;
+    size_t block_ = 0;
+    BlockCache::Handle holder_;  // keeps region_ alive in Syscall mode
+    std::string_view region_;
+    bool valid_ = false;
+    bool ok_ = true;
+
+    BlockIter bi_;  // V2
+    const char* next_ = nullptr;  // V0/V1: next record in region_
+    std::string_view key_, value_;
+    RecType type_ = RecType::Put;
+};
+
+// Streams sorted entries into a V3 table at dir/tmp_NNNNNN.sst, flushing each
+// data block as it fills; finish() fsyncs and renames it to NNNNNN.sst.
+// Destroying an unfinished builder removes the tmp file.
+class SSTableBuilder {
+   public:
+    SSTableBuilder(std::string dir, uint64_t file_id, const SSTableOptions& opts = {});
+    ~SSTableBuilder();
+    SSTableBuilder(const SSTableBuilder&) = delete;
+    SSTableBuilder& operator=(const SSTableBuilder&) = delete;
+
+    bool open();
+    // Keys must be increasing; a repeated key must come with a lower seq than
+    // the version before it. value is ignored for Del, and must be an
+    // encoded ValueRef for RecType::ValueRef.
+    bool add(std::string_view key, RecType type, std::string_view value, SequenceNumber seq = 0);
+    bool finish(std::string* out_final_path = nullptr);
+    void abandon();
+
+    uint64_t num_entries() const { return num_entries_; }
+    uint64_t file_size() const { return written_ + buf_.size(); }  // bytes so far
+    // Value logs the ValueRef entries added so far point into
+    const std::vector<ValueLogUsage>& value_logs() const { return value_log_usage_.usage(); }
+
+   private:
+    bool flush_buffer();
+    bool emit_block(std::string_view contents, uint64_t* off);
+    bool finish_data_block();
+
+    std::string dir_;
+    uint64_t file_id_;
+    SSTableOptions opts_;
+    std::string tmp_path_;
+    int fd_ = -1;
+
+    std::string buf_;       // pending output, written in large chunks
+    uint64_t written_ = 0;  // bytes already written to fd_
+    BlockBuilder data_block_;
+    BlockBuilder index_block_;
+    BloomFilterBuilder bloom_;
+    std::string last_key_;
+    SequenceNumber last_seq_ = 0;
+    uint64_t num_entries_ = 0;
+    ValueLogUsageCounter value_log_usage_;
 };
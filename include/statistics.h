@@ -0,0 +1,137 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Counters of engine activity.
+enum class Ticker : uint32_t {
+    GetCalls,
+    GetFound,               // gets that returned a value
+    GetMemtableHits,        // gets a memtable answered (value or tombstone)
+    MultiGetCalls,
+    MultiGetKeys,
+    PutCalls,
+    DelCalls,
+    WriteCalls,             // Engine::write batches
+    BytesWritten,           // user keys and values of puts, dels and batches
+    TablesProbed,           // SSTable probes by gets and multi_gets, filter rejects included
+    TableBytesRead,         // blocks (V0/V1: index intervals) those probes loaded
+    WalBytes,               // bytes written to WAL segments
+    WalSyncs,               // fdatasync calls on WAL segments
+    FlushCount,
+    FlushBytes,             // table bytes written by flushes
+    CompactionCount,        // merging compactions; trivial moves excluded
+    CompactionBytesRead,    // input table bytes
+    CompactionBytesWritten,
+    ValueLogBytesWritten,   // value log bytes written by flushes and GC
+    ValueLogBytesRead,      // separated values read by gets and scans
+    ValueLogGcCount,        // value logs garbage collected
+    ValueLogGcBytes,        // live value bytes GC moved to new logs
+    kCount
+};
+
+// Distributions of latencies (nanoseconds) and per-operation sizes.
+enum class Histogram : uint32_t {
+    GetNanos,
+    MultiGetNanos,
+    PutNanos,
+    DelNanos,
+    WriteNanos,
+    FlushNanos,             // one memtable written to L0
+    CompactionNanos,
+    WalSyncNanos,           // one fdatasync
+    TablesPerGet,           // SSTables a get probed
+    BytesPerGet,            // table bytes a get loaded
+    kCount
+};
+
+const char* ticker_name(Ticker t);         // "get.calls", ...
+const char* histogram_name(Histogram h);   // "get.nanos", ...
+
+// A point-in-time copy of one histogram.
+struct HistogramData {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t min = 0;
+    uint64_t max = 0;
+    std::vector<uint64_t> buckets;   // Statistics::kBuckets counts
+
+    double average() const { return count ? static_cast<double>(sum) / static_cast<double>(count) : 0; }
+    // p in [0, 100], interpolated within its bucket; 0 if empty.
+    double percentile(double p) const;
+};
+
+// Tickers and histograms of one engine. Recording takes no lock: each
+// thread adds to one of a few cache-line aligned stripes with relaxed
+// atomics, and readers sum the stripes. A read racing with writers sees
+// every value at some recent point, not all at the same one.
+//
+// Histograms are log-linear (HDR style): values 0..15 get a bucket each,
+// every power of two above 8 buckets, so a bucket spans at most 1/8 of
+// its values.
+class Statistics {
+   public:
+    static constexpr size_t kSubBuckets = 8;
+    static constexpr size_t kBuckets = 16 + (64 - 4) * kSubBuckets;
+    static size_t bucket_of(uint64_t v);
+    static uint64_t bucket_floor(size_t b);   // smallest value in bucket b
+
+    void add(Ticker t, uint64_t n = 1) {
+        stripe().tickers[static_cast<size_t>(t)].fetch_add(n, std::memory_order_relaxed);
+    }
+    void record(Histogram h, uint64_t v);
+
+    uint64_t ticker(Ticker t) const;
+    HistogramData histogram(Histogram h) const;
+    void reset();
+
+    // One line per ticker and histogram, then the amplification ratios.
+    std::string to_string() const;
+    // Prometheus text exposition: tickers as counters (kv_get_calls_total),
+    // histograms as summaries with p50/p95/p99/p99.9.
+    std::string to_prometheus() const;
+
+   private:
+    static constexpr size_t kStripes = 8;
+    struct Hist {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> min{UINT64_MAX};
+        std::atomic<uint64_t> max{0};
+        std::array<std::atomic<uint64_t>, kBuckets> buckets{};
+    };
+    struct alignas(64) Stripe {
+        std::array<std::atomic<uint64_t>, static_cast<size_t>(Ticker::kCount)> tickers{};
+        std::array<Hist, static_cast<size_t>(Histogram::kCount)> hists;
+    };
+    Stripe& stripe();   // the calling thread's
+
+    std::array<Stripe, kStripes> stripes_;
+};
+
+// Records the nanoseconds from construction to destruction into h; nothing
+// if stats is null.
+class StopWatch {
+   public:
+    StopWatch(Statistics* stats, Histogram h)
+        : stats_(stats), h_(h), start_(stats ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{}) {}
+    ~StopWatch() {
+        if (stats_) stats_->record(h_, elapsed_nanos());
+    }
+    StopWatch(const StopWatch&) = delete;
+    StopWatch& operator=(const StopWatch&) = delete;
+
+    uint64_t elapsed_nanos() const {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now() - start_).count());
+    }
+
+   private:
+    Statistics* stats_;
+    Histogram h_;
+    std::chrono::steady_clock::time_point start_;
+};
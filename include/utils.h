@@ -1,5 +1,22 @@
 #pragma once
 #include <cstdint>
 #include <string>
+#include <string_view>
 
-uint32_t compute_crc32(const std::string& data);
+uint32_t compute_crc32(std::string_view data);
+
+// 64-bit non-cryptographic hash (MurmurHash64A), used for Bloom filters.
+uint64_t hash64(std::string_view data, uint64_t seed = 0);
+
+// ---- encoding helpers (little-endian fixed ints, LEB128 varints) ----
+void put_fixed32(std::string* dst, uint32_t v);
+void put_fixed64(std::string* dst, uint64_t v);
+uint32_t decode_fixed32(const char* p);
+uint64_t decode_fixed64(const char* p);
+
+void put_varint32(std::string* dst, uint32_t v);
+void put_varint64(std::string* dst, uint64_t v);
+// Decode a varint from [p, limit). Returns the byte after it, or nullptr if
+// the input is truncated or malformed.
+const char* get_varint32(const char* p, const char* limit, uint32_t* v);
+const char* get_varint64(const char* p, const char* limit, uint64_t* v);
@@ -0,0 +1,123 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Key-value separation (WiscKey style): values of at least min_value_size
+// bytes are moved out of the tables into an append-only value log when
+// their memtable is flushed, and the table entry (RecType::ValueRef) holds
+// only a ValueRef to them. Compactions then merge and rewrite small
+// entries instead of the values themselves.
+struct ValueLogOptions {
+    // 0 keeps every value inline in the tables.
+    size_t min_value_size = 0;
+    // Garbage collect a value log once at least this fraction of its bytes
+    // is no longer referenced by any table: its live values are copied to a
+    // new log and the tables pointing at them rewritten.
+    double gc_garbage_ratio = 0.5;
+};
+
+// Where a separated value lives: the record at [offset, offset + size) of
+// value log `number`.
+struct ValueRef {
+    uint64_t number = 0;
+    uint64_t offset = 0;
+    uint64_t size = 0;
+
+    // varint64 number | varint64 offset | varint64 size
+    void encode(std::string* out) const;
+    bool decode(std::string_view in);
+};
+
+// The bytes of one value log's records a table points at. Recorded with
+// the table in the MANIFEST; a log no table points into is deleted.
+struct ValueLogUsage {
+    uint64_t number = 0;
+    uint64_t bytes = 0;
+};
+
+// An opened, immutable value log.
+//
+// Layout:
+//   Header: u32 magic 'KVVL' (0x4B56564C), u32 version=1
+//   Records: u32 crc32(rest of record), u32 key_len, u32 value_len, key, value
+// The key is kept so a log can be checked and read on its own.
+class ValueLog {
+   public:
+    ValueLog() = default;
+    ~ValueLog();
+    ValueLog(const ValueLog&) = delete;
+    ValueLog& operator=(const ValueLog&) = delete;
+
+    bool Open(const std::string& path, uint64_t number);
+
+    // The value ref points at; false if ref is out of range or the record
+    // does not verify.
+    bool Read(const ValueRef& ref, std::string* value) const;
+
+    uint64_t number() const { return number_; }
+    const std::string& path() const { return path_; }
+    uint64_t file_size() const { return file_size_; }
+    uint64_t data_bytes() const { return file_size_ - kHeaderSize; }   // all records
+
+    // Delete the file once the last reference to it is dropped.
+    void mark_obsolete() { obsolete_.store(true); }
+
+    // dir/NNNNNN.vlog
+    static std::string file_name_for(const std::string& dir, uint64_t number);
+
+    static constexpr uint32_t kMagic = 0x4B56564C;  // 'K''V''V''L'
+    static constexpr uint32_t kVersion = 1;
+    static constexpr size_t kHeaderSize = 2 * sizeof(uint32_t);
+    static constexpr size_t kRecordHeaderSize = 3 * sizeof(uint32_t);
+
+   private:
+    std::string path_;
+    uint64_t number_ = 0;
+    uint64_t file_size_ = 0;
+    int fd_ = -1;
+    std::atomic<bool> obsolete_{false};
+};
+
+// Appends records to a new value log at dir/NNNNNN.vlog; finish() fsyncs
+// it. The log is only referenced once a MANIFEST edit names a table
+// pointing into it, so an unfinished or unreferenced file is removed (by
+// the destructor, or at the next open after a crash).
+class ValueLogBuilder {
+   public:
+    ValueLogBuilder(std::string dir, uint64_t number);
+    ~ValueLogBuilder();
+    ValueLogBuilder(const ValueLogBuilder&) = delete;
+    ValueLogBuilder& operator=(const ValueLogBuilder&) = delete;
+
+    bool open();
+    bool add(std::string_view key, std::string_view value, ValueRef* ref);
+    bool finish(std::string* out_path = nullptr);
+    void abandon();
+
+    uint64_t number() const { return number_; }
+    uint64_t file_size() const { return written_ + buf_.size(); }   // bytes so far
+
+   private:
+    bool flush_buffer();
+
+    std::string dir_;
+    uint64_t number_;
+    std::string path_;
+    int fd_ = -1;
+    std::string buf_;
+    uint64_t written_ = 0;
+};
+
+// Adds the bytes every ValueRef entry points at to the usage of its log.
+class ValueLogUsageCounter {
+   public:
+    // false if value is not a valid ValueRef
+    bool add(std::string_view value);
+    const std::vector<ValueLogUsage>& usage() const { return usage_; }   // ascending by number
+
+   private:
+    std::vector<ValueLogUsage> usage_;
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "sstable.h"
+
+struct VersionEdit;
+
+using TableRef = std::shared_ptr<SSTable>;
+using ValueLogRef = std::shared_ptr<ValueLog>;
+
+// Immutable snapshot of the table set, organized in levels:
+//   L0:  flush outputs, newest -> oldest, key ranges may overlap
+//   L1+: sorted by smallest key, key ranges disjoint within a level
+// A level holds newer data than every level below it. Readers copy the
+// shared_ptr and keep using it while compaction installs a successor.
+struct Version {
+    explicit Version(int num_levels) : levels(num_levels) {}
+
+    std::vector<std::vector<TableRef>> levels;
+    // Every value log some table points into, by number; a version keeps
+    // them open (and on disk) like its tables.
+    std::map<uint64_t, ValueLogRef> value_logs;
+
+    int num_levels() const { return static_cast<int>(levels.size()); }
+    size_t num_tables() const;
+    uint64_t level_bytes(int level) const;
+
+    // L1+: the one table whose range may contain key, or null.
+    const SSTable* find_in_level(int level, std::string_view key) const;
+
+    // Tables of `level` whose key range intersects [lo, hi].
+    std::vector<TableRef> overlapping(int level, std::string_view lo, std::string_view hi) const;
+
+    // Put an L1+ level back into smallest-key order after edits.
+    void sort_level(int level);
+
+    // Bytes of value log `number` the tables point at.
+    uint64_t value_log_live_bytes(uint64_t number) const;
+
+    // Drop edit.removed, then add edit.added, whose tables are given opened
+    // in the same order. New L0 tables go to the front. new_logs are the
+    // value logs the added tables point into that are not in the version
+    // yet; logs no table points into any more are dropped.
+    void apply(const VersionEdit& edit, const std::vector<TableRef>& added,
+               const std::vector<ValueLogRef>& new_logs = {});
+};
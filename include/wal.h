@@ -1,31 +1,102 @@
 #pragma once
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <sys/types.h>
 
 #include "memtable.h"
+#include "statistics.h"
+#include "write_batch.h"
 
+// Appends and sync() may be called from several threads at once and go
+// through a group commit: the writer at the head of the queue becomes the
+// leader, writes every record queued behind it with one write() and, if any
+// of them asked for durability, one fdatasync(), then releases them all.
+// open(), replay() and reset() need exclusive access.
+//
+// New logs are v4: records carry the sequence number of their (first) op,
+// and their CRC is seeded with the log number, so a segment can be
+// preallocated or recycled and replay stops where this log's records end.
+// v1 (zlib CRC32 trailer per record), v2 (unseeded CRC) and v3 (no seq) logs
+// are still replayed, but only accept appends after reset().
 class WAL {
    public:
-    explicit WAL(std::string path);
+    // Record header, followed by the key and value bytes:
+    //   u32 crc32c (of everything after it) | u8 type | u32 klen | u32 vlen | u64 seq
+    // type is a RecType, or kBatchRecord with the WriteBatch encoding as the
+    // value and no key; a batch's ops take seq, seq + 1, ... (v2/v3 headers
+    // stop before seq.)
+    static constexpr uint8_t kBatchRecord = 3;
+    static constexpr size_t kRecordHeader = 21;
+
+    // log_number identifies this incarnation of the file (its segment number).
+    // stats, if given, counts the bytes written and times each fdatasync.
+    explicit WAL(std::string path, uint64_t log_number = 0, Statistics* stats = nullptr);
     ~WAL();
 
-    bool open();
-    bool appendPut(const std::string& key, const std::string& value);
-    bool appendDel(const std::string& key);
+    // Appends go after the last record of this log_number, wherever the
+    // file ends; preallocate_bytes sizes the file up front (fallocate).
+    bool open(size_t preallocate_bytes = 0);
+    // With sync, returns once the record is on disk. seq is the op's
+    // sequence number (0: unsequenced).
+    bool appendPut(const std::string& key, const std::string& value, bool sync = false, SequenceNumber seq = 0);
+    bool appendDel(const std::string& key, bool sync = false, SequenceNumber seq = 0);
+    // The whole batch as one record: replay applies all of it or none.
+    bool appendBatch(const WriteBatch& batch, bool sync = false, SequenceNumber seq = 0);
 
-    bool sync();
+    bool sync();    // fdatasync everything appended so far
 
-    bool replay(MemTable& memtable);
+    // Apply every complete record to memtable, with its seq; reads the log
+    // through mmap. With last_seq, ops of pre-v4 logs are numbered on from
+    // *last_seq, and *last_seq ends up at the highest seq applied.
+    bool replay(MemTable& memtable, SequenceNumber* last_seq = nullptr);
 
     bool reset();
 
+    uint64_t log_number() const { return log_number_; }
+
+    // group commit counters
+    uint64_t groups() const { return groups_.load(std::memory_order_relaxed); }  // write() calls
+    uint64_t syncs() const { return syncs_.load(std::memory_order_relaxed); }    // fdatasync() calls
+
    private:
+    // A caller waiting in the commit queue.
+    struct Writer {
+        char header[kRecordHeader];
+        std::string_view key, value;    // the caller's; valid until commit returns
+        bool has_record = false;        // false for a bare sync()
+        bool sync = false;
+        bool done = false;
+        bool ok = false;
+        std::condition_variable cv;
+    };
+    static constexpr size_t kMaxGroupBytes = 1 << 20;  // per leader write
+    static constexpr size_t kReplayChunkBytes = 1 << 20;  // per memtable apply
+
     std::string path_;
+    uint64_t log_number_;
+    uint32_t seed_;             // CRC32C of log_number_
+    Statistics* stats_;         // not owned; may be null
     int fd_ = -1;
+    uint32_t version_ = 0;      // of the open log
+    off_t end_ = 0;             // end of the last complete group; -1 until found
+
+    std::mutex mu_;             // guards writers_
+    std::deque<Writer*> writers_;
+    std::string group_;         // leader's write buffer
+    std::atomic<uint64_t> groups_{0};
+    std::atomic<uint64_t> syncs_{0};
 
     bool ensureOpenForWrite();
-    bool writeRecord(const std::string& key, RecType t, const std::string* val);
+    void encodeRecord(Writer* w, uint8_t type, std::string_view key, std::string_view value, SequenceNumber seq);
+    bool commit(Writer& w);
+    bool writeGroup(bool sync);     // leader only
     static bool writeAll(int fd, const void* p, size_t n);
     static bool readAll(int fd, void* p, size_t n);
     bool validateHeader();
+    bool findEnd();             // after the last record of this log_number
 };
\ No newline at end of file
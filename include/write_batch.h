@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "memtable.h"
+#include "utils.h"
+
+// Puts and deletes applied atomically by Engine::write: the batch is one WAL
+// record with one CRC, and replay applies all of it or none of it. Operations
+// apply in the order added, so a later put of the same key wins.
+//
+// Encoding (also the WAL record payload):
+//   u32 count | { u8 type | varint32 klen | key | [varint32 vlen | value] }*
+// the value part only for Put. Reuse a batch with clear().
+class WriteBatch {
+public:
+    WriteBatch() { clear(); }
+    // the moved-from batch is left empty and usable
+    WriteBatch(WriteBatch&& o) noexcept : rep_(std::move(o.rep_)) { o.clear(); }
+    WriteBatch& operator=(WriteBatch&& o) noexcept {
+        rep_ = std::move(o.rep_);
+        o.clear();
+        return *this;
+    }
+    WriteBatch(const WriteBatch&) = delete;
+    WriteBatch& operator=(const WriteBatch&) = delete;
+
+    void put(std::string_view key, std::string_view value);
+    void del(std::string_view key);
+    void append(const WriteBatch& other);   // other's operations, after ours
+    void clear();
+
+    uint32_t count() const { return decode_fixed32(rep_.data()); }
+    bool empty() const { return count() == 0; }
+    size_t byte_size() const { return rep_.size(); }
+    const std::string& rep() const { return rep_; }
+
+    // Call fn(RecType, key, value) for every operation in an encoded batch,
+    // in order. Returns false, possibly after some calls, if rep is malformed;
+    // validate first with for_each(rep, no-op) when that matters.
+    template <typename Fn>
+    static bool for_each(std::string_view rep, Fn&& fn);
+
+private:
+    std::string rep_;
+};
+
+template <typename Fn>
+bool WriteBatch::for_each(std::string_view rep, Fn&& fn) {
+    if (rep.size() < 4) return false;
+    uint32_t n = decode_fixed32(rep.data());
+    const char* p = rep.data() + 4;
+    const char* limit = rep.data() + rep.size();
+    for (uint32_t i = 0; i < n; ++i) {
+        if (p >= limit) return false;
+        auto type = static_cast<RecType>(*p++);
+        if (type != RecType::Put && type != RecType::Del) return false;
+        uint32_t klen = 0, vlen = 0;
+        p = get_varint32(p, limit, &klen);
+        if (!p || static_cast<size_t>(limit - p) < klen) return false;
+        std::string_view key(p, klen);
+        p += klen;
+        std::string_view value;
+        if (type == RecType::Put) {
+            p = get_varint32(p, limit, &vlen);
+            if (!p || static_cast<size_t>(limit - p) < vlen) return false;
+            value = std::string_view(p, vlen);
+            p += vlen;
+        }
+        fn(type, key, value);
+    }
+    return p == limit;
+}
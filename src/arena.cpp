@@ -0,0 +1,73 @@
+#include "arena.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace {
+// Offset at which an object aligned to `align` can start in a block whose
+// data begins at `base`, given `used` bytes already handed out.
+size_t aligned_offset(const char* base, size_t used, size_t align) {
+    auto addr = reinterpret_cast<uintptr_t>(base) + used;
+    return used + ((align - (addr & (align - 1))) & (align - 1));
+}
+}  // namespace
+
+char* Arena::allocate(size_t n, size_t align) {
+    Block* b = current_.load(std::memory_order_acquire);
+    if (b) {
+        // Claim n + worst-case padding, then align inside the claimed range.
+        size_t claim = n + align - 1;
+        size_t used = b->used.fetch_add(claim, std::memory_order_relaxed);
+        if (used + claim <= b->size) {
+            return b->data.get() + aligned_offset(b->data.get(), used, align);
+        }
+    }
+    return allocate_fallback(n, align, b);
+}
+
+char* Arena::allocate_fallback(size_t n, size_t align, Block* seen) {
+    std::lock_guard<std::mutex> g(mu_);
+    if (n + align - 1 > kBlockSize / 4) {
+        // Large: its own block, so the current block's tail is not wasted.
+        Block* big = new_block(n + align - 1);
+        big->used.store(big->size, std::memory_order_relaxed);
+        return big->data.get() + aligned_offset(big->data.get(), 0, align);
+    }
+    Block* b = current_.load(std::memory_order_acquire);
+    if (b == seen) {
+        b = new_block(kBlockSize);
+        current_.store(b, std::memory_order_release);
+    }
+    // Another thread may have started a block while we waited; either way
+    // retry through the fast path.
+    size_t claim = n + align - 1;
+    size_t used = b->used.fetch_add(claim, std::memory_order_relaxed);
+    if (used + claim <= b->size) return b->data.get() + aligned_offset(b->data.get(), used, align);
+    // Already full again (heavy contention): this request gets a fresh block.
+    b = new_block(kBlockSize);
+    b->used.store(claim, std::memory_order_relaxed);
+    current_.store(b, std::memory_order_release);
+    return b->data.get() + aligned_offset(b->data.get(), 0, align);
+}
+
+Arena::Block* Arena::new_block(size_t size) {
+    auto b = std::make_unique<Block>();
+    b->data.reset(new char[size]);  // left uninitialized
+    b->size = size;
+    blocks_.push_back(std::move(b));
+    usage_.fetch_add(size + sizeof(Block), std::memory_order_relaxed);
+    return blocks_.back().get();
+}
+
+char* Arena::copy(const char* p, size_t n) {
+    char* dst = allocate(n, 1);
+    if (n) std::memcpy(dst, p, n);
+    return dst;
+}
+
+void Arena::reset() {
+    std::lock_guard<std::mutex> g(mu_);
+    current_.store(nullptr, std::memory_order_relaxed);
+    blocks_.clear();
+    usage_.store(0, std::memory_order_relaxed);
+}
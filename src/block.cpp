@@ -0,0 +1,174 @@
+#include "block.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "perf_context.h"
+#include "utils.h"
+
+// ===== BlockBuilder =====
+BlockBuilder::BlockBuilder(int restart_interval, bool with_seq)
+    : restart_interval_(restart_interval < 1 ? 1 : restart_interval), with_seq_(with_seq) {
+    restarts_.push_back(0);
+}
+
+void BlockBuilder::reset() {
+    buf_.clear();
+    restarts_.clear();
+    restarts_.push_back(0);
+    counter_ = 0;
+    counter_total_ = 0;
+    last_key_.clear();
+    finished_ = false;
+}
+
+void BlockBuilder::add(std::string_view key, RecType type, std::string_view value, SequenceNumber seq) {
+    assert(!finished_);
+    assert(counter_total_ == 0 || std::string_view(last_key_) <= key);
+
+    size_t shared = 0;
+    if (counter_ < restart_interval_) {
+        const size_t n = std::min(last_key_.size(), key.size());
+        while (shared < n && last_key_[shared] == key[shared]) ++shared;
+    } else {
+        restarts_.push_back(static_cast<uint32_t>(buf_.size()));
+        counter_ = 0;
+    }
+    const size_t non_shared = key.size() - shared;
+
+    put_varint32(&buf_, static_cast<uint32_t>(shared));
+    put_varint32(&buf_, static_cast<uint32_t>(non_shared));
+    put_varint32(&buf_, static_cast<uint32_t>(value.size()));
+    buf_.push_back(static_cast<char>(type));
+    if (with_seq_) put_varint64(&buf_, seq);
+    buf_.append(key.data() + shared, non_shared);
+    buf_.append(value.data(), value.size());
+
+    last_key_.resize(shared);
+    last_key_.append(key.data() + shared, non_shared);
+    ++counter_;
+    ++counter_total_;
+}
+
+std::string_view BlockBuilder::finish() {
+    if (!finished_) {
+        for (uint32_t r : restarts_) put_fixed32(&buf_, r);
+        put_fixed32(&buf_, static_cast<uint32_t>(restarts_.size()));
+        finished_ = true;
+    }
+    return buf_;
+}
+
+// ===== BlockIter =====
+BlockIter::BlockIter(std::string_view contents, bool with_seq) : data_(contents.data()), with_seq_(with_seq) {
+    if (contents.size() < sizeof(uint32_t)) {
+        mark_corrupt();
+        return;
+    }
+    num_restarts_ = decode_fixed32(contents.data() + contents.size() - sizeof(uint32_t));
+    const uint64_t restart_bytes = (uint64_t(num_restarts_) + 1) * sizeof(uint32_t);
+    if (num_restarts_ == 0 || restart_bytes > contents.size()) {
+        mark_corrupt();
+        return;
+    }
+    restarts_off_ = static_cast<uint32_t>(contents.size() - restart_bytes);
+}
+
+void BlockIter::mark_corrupt() {
+    corrupt_ = true;
+    valid_ = false;
+    num_restarts_ = 0;
+    restarts_off_ = 0;
+}
+
+uint32_t BlockIter::restart_point(uint32_t i) const {
+    return decode_fixed32(data_ + restarts_off_ + i * sizeof(uint32_t));
+}
+
+void BlockIter::seek_to_restart(uint32_t i) {
+    key_.clear();
+    next_ = restart_point(i);
+}
+
+bool BlockIter::parse_next() {
+    const char* p = data_ + next_;
+    const char* limit = data_ + restarts_off_;
+    if (p >= limit) {
+        valid_ = false;
+        return false;
+    }
+    uint32_t shared = 0, non_shared = 0, vlen = 0;
+    if (!(p = get_varint32(p, limit, &shared)) ||
+        !(p = get_varint32(p, limit, &non_shared)) ||
+        !(p = get_varint32(p, limit, &vlen)) ||
+        shared > key_.size() ||
+        static_cast<uint64_t>(limit - p) < uint64_t(1) + non_shared + vlen) {
+        mark_corrupt();
+        return false;
+    }
+    type_ = static_cast<RecType>(*p++);
+    if (with_seq_ && (!(p = get_varint64(p, limit, &seq_)) ||
+                      static_cast<uint64_t>(limit - p) < uint64_t(non_shared) + vlen)) {
+        mark_corrupt();
+        return false;
+    }
+    key_.resize(shared);
+    key_.append(p, non_shared);
+    p += non_shared;
+    value_ = std::string_view(p, vlen);
+    p += vlen;
+    next_ = static_cast<uint32_t>(p - data_);
+    valid_ = true;
+    return true;
+}
+
+void BlockIter::SeekToFirst() {
+    valid_ = false;
+    if (corrupt_) return;
+    seek_to_restart(0);
+    parse_next();
+}
+
+void BlockIter::Next() {
+    if (!valid_) return;
+    parse_next();
+}
+
+void BlockIter::Seek(std::string_view target) {
+    valid_ = false;
+    if (corrupt_) return;
+
+    // Last restart point whose key is < target; restart keys are stored whole.
+    uint32_t lo = 0, hi = num_restarts_ - 1;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi + 1) / 2;
+        const char* p = data_ + restart_point(mid);
+        const char* limit = data_ + restarts_off_;
+        uint32_t shared = 0, non_shared = 0, vlen = 0;
+        if (!(p = get_varint32(p, limit, &shared)) ||
+            !(p = get_varint32(p, limit, &non_shared)) ||
+            !(p = get_varint32(p, limit, &vlen)) ||
+            shared != 0 || static_cast<uint64_t>(limit - p) < uint64_t(1) + non_shared) {
+            mark_corrupt();
+            return;
+        }
+        ++p;  // type
+        uint64_t seq = 0;
+        if (with_seq_ && (!(p = get_varint64(p, limit, &seq)) || static_cast<uint64_t>(limit - p) < non_shared)) {
+            mark_corrupt();
+            return;
+        }
+        std::string_view mid_key(p, non_shared);
+        perf_count(&PerfContext::restart_comparisons);
+        if (mid_key < target)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    seek_to_restart(lo);
+    while (parse_next()) {
+        perf_count(&PerfContext::entries_scanned);
+        if (std::string_view(key_) >= target) return;
+    }
+}
@@ -0,0 +1,91 @@
+#include "block_cache.h"
+
+namespace {
+// Per-entry bookkeeping (list node, map slot, shared_ptr control block),
+// charged on top of the block bytes so tiny blocks can't blow the budget.
+constexpr size_t kEntryOverhead = 96;
+
+inline uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+}  // namespace
+
+size_t BlockCache::KeyHash::operator()(const Key& k) const {
+    return static_cast<size_t>(mix(k.file_id * 0x9e3779b97f4a7c15ULL ^ k.offset));
+}
+
+BlockCache::BlockCache(size_t capacity_bytes, int shard_bits)
+    : capacity_(capacity_bytes),
+      shard_bits_(shard_bits < 0 ? 0 : (shard_bits > 8 ? 8 : shard_bits)),
+      shards_(size_t(1) << shard_bits_) {
+    const size_t per_shard = (capacity_ + shards_.size() - 1) / shards_.size();
+    for (auto& s : shards_) s.capacity = per_shard;
+}
+
+BlockCache::Shard& BlockCache::shard_for(const Key& k) {
+    if (shard_bits_ == 0) return shards_[0];
+    // high bits pick the shard; the map inside uses the (differently mixed) low bits
+    return shards_[mix(k.file_id ^ (k.offset * 0x9e3779b97f4a7c15ULL)) >> (64 - shard_bits_)];
+}
+
+BlockCache::Handle BlockCache::lookup(uint64_t file_id, uint64_t offset) {
+    Key k{file_id, offset};
+    Shard& s = shard_for(k);
+    std::lock_guard<std::mutex> lk(s.mu);
+    auto it = s.map.find(k);
+    if (it == s.map.end()) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    s.lru.splice(s.lru.begin(), s.lru, it->second);
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return it->second->value;
+}
+
+BlockCache::Handle BlockCache::insert(uint64_t file_id, uint64_t offset, std::string contents) {
+    Key k{file_id, offset};
+    const size_t charge = contents.size() + kEntryOverhead;
+    Handle h = std::make_shared<const std::string>(std::move(contents));
+
+    Shard& s = shard_for(k);
+    std::lock_guard<std::mutex> lk(s.mu);
+    if (auto it = s.map.find(k); it != s.map.end()) {
+        s.usage -= it->second->charge;
+        s.lru.erase(it->second);
+        s.map.erase(it);
+    }
+    s.lru.push_front(Entry{k, h, charge});
+    s.map.emplace(k, s.lru.begin());
+    s.usage += charge;
+    inserts_.fetch_add(1, std::memory_order_relaxed);
+
+    // Evict from the cold end. The new entry itself goes last if it alone
+    // exceeds the shard budget; the caller still holds it through `h`.
+    while (s.usage > s.capacity && !s.lru.empty()) {
+        Entry& victim = s.lru.back();
+        s.usage -= victim.charge;
+        s.map.erase(victim.key);
+        s.lru.pop_back();
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return h;
+}
+
+BlockCache::Stats BlockCache::stats() const {
+    Stats st;
+    st.hits = hits_.load(std::memory_order_relaxed);
+    st.misses = misses_.load(std::memory_order_relaxed);
+    st.inserts = inserts_.load(std::memory_order_relaxed);
+    st.evictions = evictions_.load(std::memory_order_relaxed);
+    for (const auto& s : shards_) {
+        std::lock_guard<std::mutex> lk(s.mu);
+        st.usage += s.usage;
+    }
+    st.capacity = capacity_;
+    return st;
+}
@@ -0,0 +1,76 @@
+#include "bloom.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "utils.h"
+
+namespace {
+constexpr uint32_t kBlockBits = 512;
+constexpr size_t kHeaderSize = 2 * sizeof(uint32_t);
+
+// Upper 32 bits of the hash pick the block, lower 32 bits drive the probes
+// (double hashing within the block).
+inline uint32_t block_of(uint64_t h, uint32_t num_blocks) {
+    return static_cast<uint32_t>(((h >> 32) * num_blocks) >> 32);
+}
+}  // namespace
+
+BloomFilterBuilder::BloomFilterBuilder(int bits_per_key) : bits_per_key_(bits_per_key) {}
+
+void BloomFilterBuilder::add(std::string_view key) { hashes_.push_back(hash64(key)); }
+
+std::string BloomFilterBuilder::finish() const {
+    uint64_t total_bits = static_cast<uint64_t>(hashes_.size()) * static_cast<uint64_t>(bits_per_key_);
+    uint32_t num_blocks = static_cast<uint32_t>(std::max<uint64_t>(1, (total_bits + kBlockBits - 1) / kBlockBits));
+    // k = ln(2) * bits_per_key minimizes the false positive rate
+    uint32_t num_probes = static_cast<uint32_t>(std::clamp(bits_per_key_ * 69 / 100, 1, 30));
+
+    std::string out(kHeaderSize + size_t(num_blocks) * (kBlockBits / 8), '\0');
+    std::memcpy(out.data(), &num_blocks, sizeof(num_blocks));
+    std::memcpy(out.data() + sizeof(num_blocks), &num_probes, sizeof(num_probes));
+    char* bits = out.data() + kHeaderSize;
+
+    for (uint64_t h : hashes_) {
+        char* block = bits + size_t(block_of(h, num_blocks)) * (kBlockBits / 8);
+        uint32_t a = static_cast<uint32_t>(h);
+        const uint32_t delta = (a >> 17) | (a << 15);
+        for (uint32_t i = 0; i < num_probes; ++i) {
+            uint32_t bit = a % kBlockBits;
+            block[bit / 8] |= static_cast<char>(1u << (bit % 8));
+            a += delta;
+        }
+    }
+    return out;
+}
+
+bool BloomFilter::load(std::string_view data) {
+    blocks_.clear();
+    num_probes_ = 0;
+    if (data.size() < kHeaderSize) return false;
+    uint32_t num_blocks = 0, num_probes = 0;
+    std::memcpy(&num_blocks, data.data(), sizeof(num_blocks));
+    std::memcpy(&num_probes, data.data() + sizeof(num_blocks), sizeof(num_probes));
+    if (num_blocks == 0 || num_probes == 0 || num_probes > 30) return false;
+    if (data.size() != kHeaderSize + size_t(num_blocks) * sizeof(Block)) return false;
+
+    blocks_.resize(num_blocks);
+    std::memcpy(blocks_.data(), data.data() + kHeaderSize, size_t(num_blocks) * sizeof(Block));
+    num_probes_ = num_probes;
+    return true;
+}
+
+bool BloomFilter::may_contain(std::string_view key) const {
+    if (blocks_.empty()) return true;
+    uint64_t h = hash64(key);
+    const auto* block = reinterpret_cast<const unsigned char*>(
+        blocks_[block_of(h, static_cast<uint32_t>(blocks_.size()))].words);
+    uint32_t a = static_cast<uint32_t>(h);
+    const uint32_t delta = (a >> 17) | (a << 15);
+    for (uint32_t i = 0; i < num_probes_; ++i) {
+        uint32_t bit = a % kBlockBits;
+        if ((block[bit / 8] & (1u << (bit % 8))) == 0) return false;
+        a += delta;
+    }
+    return true;
+}
@@ -0,0 +1,184 @@
+#include "compaction.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <set>
+
+double compaction_score(const Version& v, const CompactionOptions& o, int level) {
+    if (level >= v.num_levels() - 1) return 0.0;
+    if (level == 0) {
+        return static_cast<double>(v.levels[0].size()) / std::max(1, o.l0_compaction_trigger);
+    }
+    double max_bytes = static_cast<double>(o.level1_max_bytes);
+    for (int l = 1; l < level; ++l) max_bytes *= std::max(1, o.level_size_multiplier);
+    return static_cast<double>(v.level_bytes(level)) / max_bytes;
+}
+
+bool needs_compaction(const Version& v, const CompactionOptions& o) {
+    for (int l = 0; l < v.num_levels() - 1; ++l)
+        if (compaction_score(v, o, l) >= 1.0) return true;
+    return false;
+}
+
+bool VersionFilter::keep(std::string_view key, SequenceNumber seq, RecType type) {
+    // stripe i holds the seqs visible to snapshots_[i] but not to
+    // snapshots_[i - 1]; past the last snapshot only the live view reads
+    size_t stripe = std::lower_bound(snapshots_.begin(), snapshots_.end(), seq) - snapshots_.begin();
+    const bool same_key = has_last_ && key == last_key_;
+    if (same_key && stripe == last_stripe_) return false;  // a newer version answers every reader
+    if (!same_key) {
+        last_key_.assign(key.data(), key.size());
+        has_last_ = true;
+    }
+    last_stripe_ = stripe;
+    // nothing older can be read past it, and nothing deeper is left to hide
+    if (type == RecType::Del && bottommost_ && stripe == 0) return false;
+    return true;
+}
+
+// Union of the key ranges of non-empty tables; false if all are empty.
+static bool key_range(const std::vector<TableRef>& tables, std::string* lo, std::string* hi) {
+    bool any = false;
+    for (const auto& t : tables) {
+        if (t->index_size() == 0) continue;
+        if (!any || t->smallest_key() < *lo) *lo = t->smallest_key();
+        if (!any || t->largest_key() > *hi) *hi = t->largest_key();
+        any = true;
+    }
+    return any;
+}
+
+std::optional<Compaction> pick_compaction(const Version& v, const CompactionOptions& o,
+                                          std::vector<std::string>& compact_pointer) {
+    int best = -1;
+    double best_score = 1.0;
+    for (int l = 0; l < v.num_levels() - 1; ++l) {
+        double s = compaction_score(v, o, l);
+        if (s >= best_score) {
+            best = l;
+            best_score = s;
+        }
+    }
+    if (best < 0) return std::nullopt;
+
+    Compaction c;
+    c.level = best;
+    if (best == 0) {
+        c.inputs = v.levels[0];
+    } else {
+        const auto& files = v.levels[best];
+        if (compact_pointer.size() < static_cast<size_t>(v.num_levels())) compact_pointer.resize(v.num_levels());
+        const std::string& ptr = compact_pointer[best];
+        auto it = std::find_if(files.begin(), files.end(),
+                               [&](const TableRef& t) { return ptr.empty() || t->largest_key() > ptr; });
+        if (it == files.end()) it = files.begin();  // wrap around
+        c.inputs.push_back(*it);
+        compact_pointer[best] = (*it)->largest_key();
+    }
+
+    std::string lo, hi;
+    if (key_range(c.inputs, &lo, &hi)) {
+        c.next_inputs = v.overlapping(c.output_level(), lo, hi);
+        std::string nlo, nhi;
+        if (key_range(c.next_inputs, &nlo, &nhi)) {
+            lo = std::min(lo, nlo);
+            hi = std::max(hi, nhi);
+        }
+        c.bottommost = true;
+        for (int l = c.output_level() + 1; l < v.num_levels() && c.bottommost; ++l)
+            c.bottommost = v.overlapping(l, lo, hi).empty();
+    }
+    return c;
+}
+
+bool run_compaction(const Compaction& c, const std::string& dir, const SSTableOptions& table_opts,
+                    uint64_t target_file_size, const std::function<uint64_t()>& new_file_id,
+                    std::vector<CompactionOutput>* outputs) {
+    // newest first: L0 inputs are already newest -> oldest, and any level
+    // is newer than the level below it
+    std::vector<std::unique_ptr<Iterator>> children;
+    for (const auto& t : c.inputs) children.push_back(t->NewIterator(/*fill_cache=*/false));
+    for (const auto& t : c.next_inputs) children.push_back(t->NewIterator(/*fill_cache=*/false));
+    auto merged = NewMergingIterator(std::move(children));
+
+    std::vector<CompactionOutput> done;
+    auto fail = [&] {
+        for (const auto& o : done) ::unlink(o.path.c_str());
+        return false;
+    };
+
+    std::unique_ptr<SSTableBuilder> out;
+    auto finish_output = [&] {
+        CompactionOutput o;
+        o.value_logs = out->value_logs();
+        if (!out->finish(&o.path)) return false;
+        done.push_back(std::move(o));
+        out.reset();
+        return true;
+    };
+
+    VersionFilter filter(c.snapshots, c.bottommost);
+    std::string last_key;  // last key written to out
+    for (merged->SeekToFirst(); merged->Valid(); merged->Next()) {
+        std::string_view key = merged->key();
+        if (!filter.keep(key, merged->seq(), merged->type())) continue;
+
+        // split only between keys: a level's tables must not share one
+        if (out && out->file_size() >= target_file_size && key != last_key && !finish_output()) return fail();
+        if (!out) {
+            out = std::make_unique<SSTableBuilder>(dir, new_file_id(), table_opts);
+            if (!out->open()) return fail();
+        }
+        if (!out->add(key, merged->type(), merged->value(), merged->seq())) return fail();
+        last_key.assign(key.data(), key.size());
+    }
+    if (!merged->ok()) return fail();
+    if (out && !finish_output()) return fail();
+
+    for (auto& o : done) outputs->push_back(std::move(o));
+    return true;
+}
+
+std::optional<uint64_t> pick_value_log_gc(const Version& v, const ValueLogOptions& o) {
+    std::set<uint64_t> in_l0;
+    for (const auto& t : v.levels[0])
+        for (const auto& u : t->value_logs()) in_l0.insert(u.number);
+    std::optional<uint64_t> best;
+    double best_ratio = o.gc_garbage_ratio;
+    for (const auto& [number, log] : v.value_logs) {
+        if (in_l0.count(number) || log->data_bytes() == 0) continue;
+        const uint64_t live = std::min(v.value_log_live_bytes(number), log->data_bytes());
+        const double ratio = 1.0 - static_cast<double>(live) / static_cast<double>(log->data_bytes());
+        if (ratio >= best_ratio && ratio > 0) {
+            best = number;
+            best_ratio = ratio;
+        }
+    }
+    return best;
+}
+
+bool rewrite_value_refs(const SSTable& table, const ValueLog& victim, ValueLogBuilder* log,
+                        const std::string& dir, const SSTableOptions& table_opts, uint64_t file_id,
+                        CompactionOutput* output, uint64_t* moved_bytes) {
+    auto it = table.NewIterator(/*fill_cache=*/false);
+    SSTableBuilder out(dir, file_id, table_opts);
+    if (!out.open()) return false;
+    std::string value, moved;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        std::string_view v = it->value();
+        ValueRef ref;
+        if (it->type() == RecType::ValueRef && ref.decode(v) && ref.number == victim.number()) {
+            if (!victim.Read(ref, &value) || !log->add(it->key(), value, &ref)) return false;
+            *moved_bytes += ref.size;
+            moved.clear();
+            ref.encode(&moved);
+            v = moved;
+        }
+        if (!out.add(it->key(), it->type(), v, it->seq())) return false;
+    }
+    if (!it->ok()) return false;
+    output->value_logs = out.value_logs();
+    return out.finish(&output->path);
+}
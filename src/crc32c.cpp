@@ -0,0 +1,98 @@
+#include "crc32c.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define KV_CRC32C_SSE42 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define KV_CRC32C_ARM 1
+#endif
+
+namespace crc32c {
+namespace {
+
+constexpr uint32_t kPoly = 0x82F63B78;  // reflected Castagnoli polynomial
+
+// table[k][b]: CRC of byte b followed by k zero bytes
+struct Tables {
+    std::array<std::array<uint32_t, 256>, 8> t{};
+    Tables() {
+        for (uint32_t b = 0; b < 256; ++b) {
+            uint32_t c = b;
+            for (int i = 0; i < 8; ++i) c = (c >> 1) ^ (kPoly & (0u - (c & 1)));
+            t[0][b] = c;
+        }
+        for (uint32_t b = 0; b < 256; ++b)
+            for (int k = 1; k < 8; ++k) t[k][b] = (t[k - 1][b] >> 8) ^ t[0][t[k - 1][b] & 0xff];
+    }
+};
+
+const Tables& tables() {
+    static const Tables tables;
+    return tables;
+}
+
+#if defined(KV_CRC32C_SSE42)
+__attribute__((target("sse4.2"))) uint32_t extend_hw(uint32_t crc, const char* p, size_t n) {
+    uint64_t c = ~crc;
+#if defined(__x86_64__)
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t w;
+        std::memcpy(&w, p, sizeof(w));
+        c = _mm_crc32_u64(c, w);
+    }
+#endif
+    uint32_t c32 = static_cast<uint32_t>(c);
+    for (; n; ++p, --n) c32 = _mm_crc32_u8(c32, static_cast<uint8_t>(*p));
+    return ~c32;
+}
+
+bool detect_hw() { return __builtin_cpu_supports("sse4.2"); }
+#elif defined(KV_CRC32C_ARM)
+uint32_t extend_hw(uint32_t crc, const char* p, size_t n) {
+    uint32_t c = ~crc;
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t w;
+        std::memcpy(&w, p, sizeof(w));
+        c = __crc32cd(c, w);
+    }
+    for (; n; ++p, --n) c = __crc32cb(c, static_cast<uint8_t>(*p));
+    return ~c;
+}
+
+bool detect_hw() { return true; }  // the compiler was told the CPU has it
+#else
+uint32_t extend_hw(uint32_t crc, const char* p, size_t n) { return extend_portable(crc, p, n); }
+bool detect_hw() { return false; }
+#endif
+
+using ExtendFn = uint32_t (*)(uint32_t, const char*, size_t);
+const bool kHardware = detect_hw();
+const ExtendFn kExtend = kHardware ? extend_hw : extend_portable;
+
+}  // namespace
+
+uint32_t extend_portable(uint32_t crc, const char* data, size_t n) {
+    const auto& t = tables().t;
+    const auto* p = reinterpret_cast<const uint8_t*>(data);
+    uint32_t c = ~crc;
+    for (; n >= 8; p += 8, n -= 8) {
+        uint32_t lo, hi;
+        std::memcpy(&lo, p, 4);  // little-endian hosts only, like the on-disk formats
+        std::memcpy(&hi, p + 4, 4);
+        lo ^= c;
+        c = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+            t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    }
+    for (; n; ++p, --n) c = (c >> 8) ^ t[0][(c ^ *p) & 0xff];
+    return ~c;
+}
+
+uint32_t extend(uint32_t crc, const char* data, size_t n) { return kExtend(crc, data, n); }
+
+bool hardware() { return kHardware; }
+
+}  // namespace crc32c
@@ -0,0 +1,158 @@
+#include "db_iter.h"
+
+#include <algorithm>
+
+namespace {
+
+class LevelIterator final : public Iterator {
+   public:
+    LevelIterator(std::vector<TableRef> tables, bool fill_cache, std::string upper_bound)
+        : tables_(std::move(tables)), fill_cache_(fill_cache), upper_(std::move(upper_bound)) {}
+
+    bool Valid() const override { return cur_ && cur_->Valid(); }
+
+    void SeekToFirst() override {
+        if (!open(0)) return;
+        cur_->SeekToFirst();
+        skip_exhausted();
+    }
+
+    void Seek(std::string_view target) override {
+        // first table whose largest key is >= target
+        auto it = std::lower_bound(tables_.begin(), tables_.end(), target,
+                                   [](const TableRef& t, std::string_view k) { return t->largest_key() < k; });
+        if (!open(static_cast<size_t>(it - tables_.begin()))) return;
+        cur_->Seek(target);
+        skip_exhausted();
+    }
+
+    void Next() override {
+        if (!Valid()) return;
+        cur_->Next();
+        skip_exhausted();
+    }
+
+    std::string_view key() const override { return cur_->key(); }
+    std::string_view value() const override { return cur_->value(); }
+    RecType type() const override { return cur_->type(); }
+    SequenceNumber seq() const override { return cur_->seq(); }
+    bool ok() const override { return !cur_ || cur_->ok(); }
+
+   private:
+    bool open(size_t i) {
+        idx_ = i;
+        cur_.reset();
+        if (i >= tables_.size()) return false;
+        cur_ = tables_[i]->NewIterator(fill_cache_, upper_);
+        return true;
+    }
+
+    // Current table done: continue with the next one unless it lies past the bound.
+    void skip_exhausted() {
+        while (cur_ && !cur_->Valid() && cur_->ok() && idx_ + 1 < tables_.size()) {
+            if (!upper_.empty() && tables_[idx_ + 1]->smallest_key() >= upper_) return;
+            open(idx_ + 1);
+            cur_->SeekToFirst();
+        }
+    }
+
+    std::vector<TableRef> tables_;
+    bool fill_cache_;
+    std::string upper_;
+    size_t idx_ = 0;
+    std::unique_ptr<Iterator> cur_;
+};
+
+class DBIterator final : public Iterator {
+   public:
+    DBIterator(std::unique_ptr<Iterator> merged, std::string lower, std::string upper, SequenceNumber sequence,
+               std::shared_ptr<const void> pin, ValueResolver resolve)
+        : pin_(std::move(pin)),
+          iter_(std::move(merged)),
+          lower_(std::move(lower)),
+          upper_(std::move(upper)),
+          sequence_(sequence),
+          resolve_(std::move(resolve)) {}
+
+    bool Valid() const override { return valid_; }
+
+    void SeekToFirst() override {
+        if (lower_.empty()) {
+            iter_->SeekToFirst();
+        } else {
+            iter_->Seek(lower_);
+        }
+        find_next_entry(false);
+    }
+
+    void Seek(std::string_view target) override {
+        iter_->Seek(std::max(target, std::string_view(lower_)));
+        find_next_entry(false);
+    }
+
+    void Next() override {
+        if (!valid_) return;
+        iter_->Next();
+        find_next_entry(true);  // older versions of key_ follow
+    }
+
+    std::string_view key() const override { return iter_->key(); }
+    std::string_view value() const override { return resolved_ ? std::string_view(value_) : iter_->value(); }
+    RecType type() const override { return RecType::Put; }
+    bool ok() const override { return ok_ && iter_->ok(); }
+
+   private:
+    // Move to the newest live entry at or after iter_, skipping versions
+    // newer than sequence_, older versions of key_ when `skipping` and every
+    // version of a deleted key.
+    void find_next_entry(bool skipping) {
+        valid_ = false;
+        resolved_ = false;
+        if (!ok_) return;
+        for (; iter_->Valid(); iter_->Next()) {
+            std::string_view k = iter_->key();
+            if (!upper_.empty() && k >= upper_) return;
+            if (iter_->seq() > sequence_) continue;
+            if (skipping && k == key_) continue;
+            key_.assign(k);
+            if (iter_->type() == RecType::Del) {
+                skipping = true;
+                continue;
+            }
+            if (iter_->type() == RecType::ValueRef) {
+                if (!resolve_ || !resolve_(iter_->value(), &value_)) {
+                    ok_ = false;
+                    return;
+                }
+                resolved_ = true;
+            }
+            valid_ = true;
+            return;
+        }
+    }
+
+    std::shared_ptr<const void> pin_;  // declared first: outlives iter_
+    std::unique_ptr<Iterator> iter_;
+    std::string lower_, upper_;
+    SequenceNumber sequence_;
+    ValueResolver resolve_;
+    std::string key_;  // last key yielded or deleted
+    std::string value_;  // the current value, if it was read from a value log
+    bool resolved_ = false;
+    bool valid_ = false;
+    bool ok_ = true;   // false once a value could not be read
+};
+
+}  // namespace
+
+std::unique_ptr<Iterator> NewLevelIterator(std::vector<TableRef> tables, bool fill_cache,
+                                           std::string upper_bound) {
+    return std::make_unique<LevelIterator>(std::move(tables), fill_cache, std::move(upper_bound));
+}
+
+std::unique_ptr<Iterator> NewDBIterator(std::unique_ptr<Iterator> merged, std::string lower_bound,
+                                        std::string upper_bound, SequenceNumber sequence,
+                                        std::shared_ptr<const void> pin, ValueResolver resolve) {
+    return std::make_unique<DBIterator>(std::move(merged), std::move(lower_bound), std::move(upper_bound),
+                                        sequence, std::move(pin), std::move(resolve));
+}
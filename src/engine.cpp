@@ -1,21 +1,63 @@
 #include "engine.h"
+#include "db_iter.h"
+#include "perf_context.h"
 #include <algorithm>
+#include <chrono>
+#include <fstream>
 #include <iostream>
 #include <cstdio>
+#include <unordered_set>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 
+// Start a fresh MANIFEST once the log of edits grows past this.
+static constexpr uint64_t kManifestRewriteBytes = 4 * 1024 * 1024;
+
+static EngineOptions with_threshold(size_t mem_flush_threshold_bytes) {
+    EngineOptions o;
+    o.mem_flush_threshold_bytes = mem_flush_threshold_bytes;
+    return o;
+}
+
 Engine::Engine(std::string data_dir, size_t mem_flush_threshold_bytes)
-    : data_dir_(std::move(data_dir))
-    , flush_threshold_(mem_flush_threshold_bytes)
-    , mem_()
-    , wal_( (fs::path(data_dir_) / "wal.log").string() )
+    : Engine(std::move(data_dir), with_threshold(mem_flush_threshold_bytes))
 {}
 
-Engine::~Engine() {}
+Engine::Engine(std::string data_dir, const EngineOptions& opts)
+    : data_dir_(std::move(data_dir))
+    , opts_(opts)
+    , stats_(std::make_unique<Statistics>())
+    , mem_(std::make_shared<MemTable>(opts_.memtable_rep))
+    , manifest_(data_dir_)
+{
+    opts_.table.filter_stats = &filter_stats_;
+    if (opts_.block_cache_bytes > 0)
+        cache_ = std::make_unique<BlockCache>(opts_.block_cache_bytes);
+    opts_.table.block_cache = cache_.get();
+    install_super_version();
+}
+
+Engine::~Engine() {
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        shutting_down_.store(true);
+    }
+    bg_cv_.notify_all();
+    flush_cv_.notify_all();
+    imm_cv_.notify_all();
+    sync_cv_.notify_all();
+    if (bg_thread_.joinable()) bg_thread_.join();
+    // Memtables still queued stay in their WAL segments for the next open.
+    if (flush_thread_.joinable()) flush_thread_.join();
+    if (sync_thread_.joinable()) {
+        sync_thread_.join();
+        sync();  // a clean close loses nothing written since the last tick
+    }
+}
 
-std::optional<uint64_t> Engine::parse_id(const fs::path& p) {
-    if (p.extension() != ".sst") return std::nullopt;
+std::optional<uint64_t> Engine::parse_id(const fs::path& p, const char* ext) {
+    if (p.extension() != ext) return std::nullopt;
     const auto stem = p.stem().string();
     if (stem.size() == 0) return std::nullopt;
     try {
@@ -25,41 +67,209 @@ std::optional<uint64_t> Engine::parse_id(const fs::path& p) {
     }
 }
 
-uint64_t Engine::next_file_id() const {
-    uint64_t max_id = 0;
-    for (const auto& t : tables_) {
-        if (t) max_id = std::max(max_id, t->file_id());
+std::string Engine::log_path(uint64_t number) const {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%06llu.log", static_cast<unsigned long long>(number));
+    return (fs::path(data_dir_) / buf).string();
+}
+
+std::shared_ptr<const Version> Engine::current() const {
+    std::lock_guard<std::mutex> g(mu_);
+    return current_;
+}
+
+void Engine::install_super_version() {
+    auto sv = std::make_shared<SuperVersion>();
+    sv->mem = mem_;
+    for (auto it = imm_.rbegin(); it != imm_.rend(); ++it) sv->imms.push_back(it->mem);
+    sv->version = current_;
+    std::shared_ptr<const SuperVersion> old = std::move(sv);
+    {
+        std::lock_guard<std::mutex> g(sv_mu_);
+        super_version_.swap(old);
     }
-    // If no tables, scan directory once (first open)
-    for (auto& de : fs::directory_iterator(data_dir_)) {
-        if (!de.is_regular_file()) continue;
-        auto id = parse_id(de.path());
-        if (id) max_id = std::max(max_id, *id);
+    // the previous one is released outside sv_mu_
+}
+
+VersionEdit Engine::snapshot_edit(const Version& v) const {
+    VersionEdit e;
+    e.next_file_id = next_file_id_.load();
+    e.wal_number = wal_number_;
+    e.last_sequence = visible_seq_.load();
+    for (int l = 0; l < v.num_levels(); ++l) {
+        // replay prepends L0 tables, so list them oldest first
+        auto add = [&](const TableRef& t) {
+            e.add_table(l, t->file_id(), t->file_size(), t->smallest_key(), t->largest_key(), t->value_logs());
+        };
+        if (l == 0)
+            std::for_each(v.levels[0].rbegin(), v.levels[0].rend(), add);
+        else
+            std::for_each(v.levels[l].begin(), v.levels[l].end(), add);
+    }
+    return e;
+}
+
+// LEVELS (written before the MANIFEST existed): one "<level> <file_id>"
+// line per live table, L0 lines newest first. Only read to upgrade.
+bool Engine::load_levels(const std::string& levels_path, Version& v) {
+    std::ifstream in(levels_path);
+    int level;
+    uint64_t id;
+    while (in >> level >> id) {
+        if (level < 0 || level >= v.num_levels()) {
+            std::cerr << "Error: bad level " << level << " in " << levels_path << "\n";
+            return false;
+        }
+        auto t = std::make_shared<SSTable>();
+        const std::string path = SSTable::file_name_for(data_dir_, id);
+        if (!t->Open(path, opts_.table)) {
+            std::cerr << "Error: failed to open SSTable " << path << "\n";
+            return false;
+        }
+        v.levels[level].push_back(std::move(t));
+    }
+    if (!in.eof()) {
+        std::cerr << "Error: malformed " << levels_path << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool Engine::recover_manifest(Version& v) {
+    ManifestState st(v.num_levels());
+    if (!manifest_.recover(&st)) {
+        std::cerr << "Error: cannot read " << manifest_.path() << "\n";
+        return false;
+    }
+    for (int l = 0; l < v.num_levels(); ++l) {
+        for (auto& meta : st.levels[l]) {
+            auto t = std::make_shared<SSTable>();
+            const std::string path = SSTable::file_name_for(data_dir_, meta.file_id);
+            if (!t->Open(path, opts_.table, std::move(meta.smallest), std::move(meta.largest))) {
+                std::cerr << "Error: failed to open SSTable " << path << "\n";
+                return false;
+            }
+            t->set_value_logs(std::move(meta.value_logs));
+            v.levels[l].push_back(std::move(t));
+        }
     }
-    return max_id + 1;
+    // the value logs the tables point into
+    for (const auto& level : v.levels)
+        for (const auto& t : level)
+            for (const auto& u : t->value_logs()) {
+                if (v.value_logs.count(u.number)) continue;
+                auto log = std::make_shared<ValueLog>();
+                const std::string path = ValueLog::file_name_for(data_dir_, u.number);
+                if (!log->Open(path, u.number)) {
+                    std::cerr << "Error: failed to open value log " << path << "\n";
+                    return false;
+                }
+                v.value_logs.emplace(u.number, std::move(log));
+            }
+    next_file_id_.store(st.next_file_id);
+    wal_number_ = st.wal_number;
+    last_seq_ = st.last_sequence;
+    visible_seq_.store(last_seq_);
+
+    // compacted-away tables a crash (or a reader) kept from being unlinked
+    std::unordered_set<uint64_t> live;
+    for (const auto& level : v.levels)
+        for (const auto& t : level) live.insert(t->file_id());
+    for (uint64_t id : st.removed_ids)
+        if (!live.count(id)) ::unlink(SSTable::file_name_for(data_dir_, id).c_str());
+    return true;
 }
 
-bool Engine::load_existing_sstables() {
-    tables_.clear();
+bool Engine::load_existing_sstables(std::vector<uint64_t>* wal_segments) {
+    auto v = std::make_shared<Version>(std::max(2, opts_.compaction.num_levels));
+    const std::string levels_path = (fs::path(data_dir_) / "LEVELS").string();
+
+    // The directory is listed once, only to find leftovers; which tables
+    // are live, and in which order, comes from the MANIFEST.
     std::vector<std::pair<uint64_t, std::string>> files;
+    std::vector<std::pair<uint64_t, std::string>> value_log_files;
     for (auto& de : fs::directory_iterator(data_dir_)) {
         if (!de.is_regular_file()) continue;
-        auto id = parse_id(de.path());
-        if (!id) continue;
-        files.emplace_back(*id, de.path().string());
+        if (de.path().filename().string().rfind("tmp_", 0) == 0) {
+            ::unlink(de.path().c_str());  // builder leftovers from a crash
+            continue;
+        }
+        if (auto id = parse_id(de.path())) files.emplace_back(*id, de.path().string());
+        if (auto n = parse_id(de.path(), ".log")) wal_segments->push_back(*n);
+        if (auto n = parse_id(de.path(), ".vlog")) value_log_files.emplace_back(*n, de.path().string());
     }
-    // newest first
-    std::sort(files.begin(), files.end(),
-              [](const auto& a, const auto& b){ return a.first > b.first; });
 
-    for (auto& [id, path] : files) {
-        auto t = std::make_shared<SSTable>();
-        if (t->Open(path)) {
-            tables_.push_back(std::move(t));
+    const bool have_manifest = manifest_.exists();
+    if (have_manifest) {
+        if (!recover_manifest(*v)) return false;
+    } else {
+        if (fs::exists(levels_path)) {
+            if (!load_levels(levels_path, *v)) return false;
         } else {
-            std::cerr << "Warning: failed to open SSTable " << path << "\n";
+            // pre-compaction directory: every table is an L0 flush output, newest first
+            std::sort(files.begin(), files.end(),
+                      [](const auto& a, const auto& b){ return a.first > b.first; });
+            for (auto& [id, path] : files) {
+                auto t = std::make_shared<SSTable>();
+                if (t->Open(path, opts_.table)) {
+                    v->levels[0].push_back(std::move(t));
+                } else {
+                    std::cerr << "Warning: failed to open SSTable " << path << "\n";
+                }
+            }
         }
     }
+    for (int l = 1; l < v->num_levels(); ++l) v->sort_level(l);
+
+    // WAL segments, and tables of a crashed flush or compaction, may carry
+    // ids handed out after the last edit recorded the counter
+    uint64_t max_id = 0;
+    for (const auto& f : files) max_id = std::max(max_id, f.first);
+    for (uint64_t n : *wal_segments) max_id = std::max(max_id, n);
+    for (const auto& f : value_log_files) max_id = std::max(max_id, f.first);
+    next_file_id_.store(std::max(next_file_id_.load(), max_id + 1));
+
+    // outputs of a flush or compaction that crashed before its edit was logged
+    std::unordered_set<uint64_t> live;
+    for (const auto& level : v->levels)
+        for (const auto& t : level) live.insert(t->file_id());
+    for (const auto& [id, path] : files)
+        if (!live.count(id)) ::unlink(path.c_str());
+    // value logs of such outputs, or that no table pointed into any more
+    for (const auto& [number, path] : value_log_files)
+        if (!v->value_logs.count(number)) ::unlink(path.c_str());
+
+    // start every run with a one-record MANIFEST
+    if (!manifest_.rewrite(snapshot_edit(*v))) return false;
+    if (!have_manifest) ::unlink(levels_path.c_str());
+
+    std::lock_guard<std::mutex> g(mu_);
+    current_ = std::move(v);
+    install_super_version();
+    return true;
+}
+
+bool Engine::apply_edit(VersionEdit& edit, const std::vector<TableRef>& added,
+                        const std::vector<ValueLogRef>& new_logs) {
+    std::lock_guard<std::mutex> e(edit_mu_);
+    edit.next_file_id = next_file_id_.load();
+    edit.last_sequence = visible_seq_.load();   // >= every seq in the tables
+    const auto prev = current();
+    auto next = std::make_shared<Version>(*prev);
+    next->apply(edit, added, new_logs);
+    if (!manifest_.append(edit)) return false;
+    // unlinked once the last reader drops a version holding them
+    for (const auto& [number, log] : prev->value_logs)
+        if (!next->value_logs.count(number)) log->mark_obsolete();
+    if (edit.wal_number) wal_number_ = *edit.wal_number;
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        current_ = next;
+        install_super_version();
+    }
+    // The edit is durable either way; a failed rewrite leaves the old log.
+    if (manifest_.size() > kManifestRewriteBytes && !manifest_.rewrite(snapshot_edit(*next)))
+        std::cerr << "Warning: failed to rewrite " << manifest_.path() << "\n";
     return true;
 }
 
@@ -67,96 +277,888 @@ bool Engine::open() {
     std::error_code ec;
     fs::create_directories(data_dir_, ec);
 
-    // 1) Load SSTables (newest -> oldest)
-    if (!load_existing_sstables()) return false;
+    // 1) Load SSTables into their levels
+    std::vector<uint64_t> segments;
+    if (!load_existing_sstables(&segments)) return false;
+    std::sort(segments.begin(), segments.end());
+
+    // 2) Replay WAL segments not yet in tables, oldest first; wal.log is
+    //    the single log written before segments existed. Records keep their
+    //    sequence numbers; those of older logs get new ones after the
+    //    MANIFEST's last_sequence.
+    const std::string legacy_wal = (fs::path(data_dir_) / "wal.log").string();
+    std::vector<std::pair<std::string, uint64_t>> replayed;   // path, log number
+    if (fs::exists(legacy_wal)) replayed.emplace_back(legacy_wal, 0);
+    for (uint64_t n : segments)
+        if (n >= wal_number_) replayed.emplace_back(log_path(n), n);
+    for (const auto& [path, number] : replayed) {
+        WAL reader(path, number);
+        if (!reader.open()) return false;
+        if (!reader.replay(*mem_, &last_seq_)) return false;
+    }
+    visible_seq_.store(last_seq_);
 
-    // 2) Open WAL for appends
-    if (!wal_.open()) return false;
+    // 3) Open a fresh segment for appends
+    log_number_ = new_file_id();
+    wal_ = new_segment(log_number_);
+    if (!wal_) return false;
 
-    // 3) Replay WAL into MemTable
+    // 4) Persist what was replayed; older segments are no longer needed
+    VersionEdit edit;
+    edit.wal_number = log_number_;
+    if (!write_level0(*mem_, edit)) return false;
     {
-        WAL reader( (fs::path(data_dir_) / "wal.log").string() );
-        if (!reader.open()) return false;    // open read-only is fine (same format)
-        if (!reader.replay(mem_)) return false;
+        std::lock_guard<std::mutex> g(mu_);
+        mem_ = std::make_shared<MemTable>(opts_.memtable_rep);
+        install_super_version();
+    }
+    ::unlink(legacy_wal.c_str());
+    // deleted, not recycled: they may be in an older log format
+    for (uint64_t n : segments) ::unlink(log_path(n).c_str());
+
+    flush_thread_ = std::thread([this] { flush_loop(); });
+    if (opts_.wal_sync == WalSyncMode::Periodic && !sync_thread_.joinable())
+        sync_thread_ = std::thread([this] { sync_loop(); });
+    if (opts_.compaction.background && !bg_thread_.joinable()) {
+        bg_thread_ = std::thread([this] { bg_loop(); });
+        maybe_schedule_compaction();
     }
     return true;
 }
 
-bool Engine::flush() {
+bool Engine::write_level0(const MemTable& mem, VersionEdit& edit) {
     // Snapshot memtable
     std::vector<std::pair<std::string, MemValue>> snap;
-    mem_.snapshot(snap);
+    mem.snapshot(snap);
+
+    // Already in (key, seq descending) order; keep only the versions some
+    // reader can still tell apart
+    VersionFilter filter(live_snapshots(), /*bottommost=*/false);
+    size_t kept = 0;
+    for (size_t i = 0; i < snap.size(); ++i) {
+        if (!filter.keep(snap[i].first, snap[i].second.seq, snap[i].second.type)) continue;
+        if (kept != i) snap[kept] = std::move(snap[i]);
+        ++kept;
+    }
+    snap.resize(kept);
+
+    std::vector<TableRef> added;
+    std::vector<ValueLogRef> new_logs;
+    auto drop_logs = [&] {
+        for (const auto& log : new_logs) log->mark_obsolete();
+        return false;
+    };
+    if (!snap.empty()) {
+        StopWatch sw(stats_.get(), Histogram::FlushNanos);
+        // Large values go to a value log of their own, synced before the
+        // table pointing into it is logged
+        ValueLogUsageCounter usage;
+        if (opts_.value_log.min_value_size > 0) {
+            std::unique_ptr<ValueLogBuilder> vlog;
+            for (auto& [key, mv] : snap) {
+                if (mv.type != RecType::Put || mv.value.size() < opts_.value_log.min_value_size) continue;
+                if (!vlog) {
+                    vlog = std::make_unique<ValueLogBuilder>(data_dir_, new_file_id());
+                    if (!vlog->open()) return false;
+                }
+                ValueRef ref;
+                if (!vlog->add(key, mv.value, &ref)) return false;
+                mv.type = RecType::ValueRef;
+                mv.value.clear();
+                ref.encode(&mv.value);
+                usage.add(mv.value);
+            }
+            std::string log_path;
+            if (vlog && !vlog->finish(&log_path)) return false;
+            if (vlog) {
+                auto log = std::make_shared<ValueLog>();
+                if (!log->Open(log_path, vlog->number())) {
+                    ::unlink(log_path.c_str());
+                    return false;
+                }
+                stats_->add(Ticker::ValueLogBytesWritten, log->file_size());
+                new_logs.push_back(std::move(log));
+            }
+        }
+
+        uint64_t id = new_file_id();
+        std::string out_path;
+        if (!SSTable::Build(data_dir_, id, snap, &out_path, opts_.table)) return drop_logs();
+
+        auto t = std::make_shared<SSTable>();
+        if (!t->Open(out_path, opts_.table)) {
+            ::unlink(out_path.c_str());
+            return drop_logs();
+        }
+        t->set_value_logs(usage.usage());
+        edit.add_table(0, t->file_id(), t->file_size(), t->smallest_key(), t->largest_key(), t->value_logs());
+        stats_->add(Ticker::FlushCount);
+        stats_->add(Ticker::FlushBytes, t->file_size());
+        added.push_back(std::move(t));
+    }
+    // adds the table to the front of L0 (newest first)
+    if (!apply_edit(edit, added, new_logs)) {
+        for (const auto& t : added) t->mark_obsolete();
+        return drop_logs();
+    }
+    return true;
+}
+
+bool Engine::switch_memtable() {
+    // Create the next segment before taking the lock; readers never wait on it.
+    const uint64_t number = new_file_id();
+    auto wal = new_segment(number);
+    if (!wal) return false;
+    {
+        std::unique_lock<std::mutex> lk(mu_);
+        if (imm_.size() >= std::max<size_t>(1, opts_.max_immutable_memtables)) {
+            write_stalls_.fetch_add(1);
+            imm_cv_.wait(lk, [&] {
+                return imm_.size() < std::max<size_t>(1, opts_.max_immutable_memtables) || bg_error_ ||
+                       shutting_down_.load();
+            });
+        }
+        if (bg_error_ || shutting_down_.load()) {
+            lk.unlock();
+            ::unlink(log_path(number).c_str());
+            return false;
+        }
+        imm_.push_back(ImmMemTable{mem_, wal_, log_number_});
+        mem_ = std::make_shared<MemTable>(opts_.memtable_rep);
+        wal_ = std::move(wal);
+        log_number_ = number;
+        install_super_version();
+    }
+    flush_cv_.notify_one();
+    return true;
+}
+
+std::shared_ptr<WAL> Engine::new_segment(uint64_t number) {
+    std::optional<uint64_t> reuse;
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        if (!recycled_wals_.empty()) {
+            reuse = recycled_wals_.back();
+            recycled_wals_.pop_back();
+        }
+    }
+    // A recycled file keeps its blocks and its old records. Those were
+    // checksummed with the old number, so if we crash before writing here,
+    // replay of `number` finds nothing in it.
+    if (reuse && ::rename(log_path(*reuse).c_str(), log_path(number).c_str()) != 0)
+        ::unlink(log_path(*reuse).c_str());
+
+    size_t prealloc = opts_.wal_preallocate_bytes;
+    if (prealloc == 0)
+        prealloc = std::min<size_t>(opts_.mem_flush_threshold_bytes + opts_.mem_flush_threshold_bytes / 8,
+                                    64 << 20);
+    auto wal = std::make_shared<WAL>(log_path(number), number, stats_.get());
+    if (!wal->open(prealloc)) {
+        ::unlink(log_path(number).c_str());
+        return nullptr;
+    }
+    return wal;
+}
+
+void Engine::retire_segment(uint64_t number) {
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        if (recycled_wals_.size() < opts_.max_recycled_wals) {
+            recycled_wals_.push_back(number);
+            return;
+        }
+    }
+    ::unlink(log_path(number).c_str());
+}
+
+void Engine::flush_loop() {
+    std::unique_lock<std::mutex> lk(mu_);
+    for (;;) {
+        flush_cv_.wait(lk, [&] { return shutting_down_.load() || (!imm_.empty() && !bg_error_); });
+        if (shutting_down_.load()) break;
+        ImmMemTable imm = imm_.front();
+        // once this table is logged, replay can start at the next segment
+        VersionEdit edit;
+        edit.wal_number = imm_.size() > 1 ? imm_[1].log_number : log_number_;
+        lk.unlock();
+
+        bool ok = write_level0(*imm.mem, edit);
+        if (ok) {
+            retire_segment(imm.log_number);  // replay skips it now
+            // before flush() can return, so wait_for_compactions() sees it
+            maybe_schedule_compaction();
+        }
+
+        lk.lock();
+        if (!ok) {
+            bg_error_ = true;
+            std::cerr << "Error: background flush failed\n";
+            imm_cv_.notify_all();
+            continue;
+        }
+        // The version holding the new table is already published, so a get
+        // never misses these keys between the two steps.
+        imm_.pop_front();
+        install_super_version();
+        imm_cv_.notify_all();
+    }
+}
+
+bool Engine::flush() {
+    Writer w;
+    w.force_switch = true;
+    if (!write_queued(w)) return false;
+    std::unique_lock<std::mutex> lk(mu_);
+    imm_cv_.wait(lk, [&] { return imm_.empty() || bg_error_ || shutting_down_.load(); });
+    return imm_.empty() && !bg_error_;
+}
+
+size_t Engine::num_immutable_memtables() const {
+    std::lock_guard<std::mutex> g(mu_);
+    return imm_.size();
+}
+
+// ---- compaction ----
+
+std::vector<SequenceNumber> Engine::live_snapshots() const {
+    std::lock_guard<std::mutex> g(mu_);
+    std::vector<SequenceNumber> seqs;
+    for (SequenceNumber s : snapshots_)
+        if (seqs.empty() || seqs.back() != s) seqs.push_back(s);
+    return seqs;
+}
+
+bool Engine::do_compaction(const Compaction& c) {
+    std::vector<TableRef> outputs;
+    if (c.trivial_move()) {
+        outputs = c.inputs;
+    } else {
+        StopWatch sw(stats_.get(), Histogram::CompactionNanos);
+        std::vector<CompactionOutput> done;
+        if (!run_compaction(c, data_dir_, opts_.table, opts_.compaction.target_file_size,
+                            [this] { return new_file_id(); }, &done))
+            return false;
+        for (auto& o : done) {
+            auto t = std::make_shared<SSTable>();
+            if (!t->Open(o.path, opts_.table)) {
+                for (const auto& q : done) ::unlink(q.path.c_str());
+                return false;
+            }
+            t->set_value_logs(std::move(o.value_logs));
+            outputs.push_back(std::move(t));
+        }
+        stats_->add(Ticker::CompactionCount);
+        for (const auto& t : c.inputs) stats_->add(Ticker::CompactionBytesRead, t->file_size());
+        for (const auto& t : c.next_inputs) stats_->add(Ticker::CompactionBytesRead, t->file_size());
+        for (const auto& t : outputs) stats_->add(Ticker::CompactionBytesWritten, t->file_size());
+    }
 
-    if (snap.empty()) return true;
+    // Flushes may have added L0 tables since the pick; the edit only names
+    // the tables this compaction consumed, so it applies to any later version.
+    VersionEdit edit;
+    for (const auto& t : c.inputs) edit.remove_table(c.level, t->file_id());
+    for (const auto& t : c.next_inputs) edit.remove_table(c.output_level(), t->file_id());
+    for (const auto& t : outputs)
+        edit.add_table(c.output_level(), t->file_id(), t->file_size(), t->smallest_key(), t->largest_key(),
+                       t->value_logs());
+    bool ok = apply_edit(edit, outputs);
+    if (!ok) {
+        if (!c.trivial_move())
+            for (const auto& t : outputs) t->mark_obsolete();
+        return false;
+    }
 
-    // Ensure strict key ordering (works even if source is unordered_map)
-    std::sort(snap.begin(), snap.end(),
-              [](const auto& a, const auto& b){ return a.first < b.first; });
+    if (!c.trivial_move()) {
+        // unlinked once the last reader drops its version
+        for (const auto& t : c.inputs) t->mark_obsolete();
+        for (const auto& t : c.next_inputs) t->mark_obsolete();
+    }
+    return true;
+}
 
-    // Dedup by key (should already be unique in map; harmless otherwise)
-    snap.erase(std::unique(snap.begin(), snap.end(),
-                [](const auto& a, const auto& b){ return a.first == b.first; }),
-               snap.end());
+bool Engine::collect_value_log(uint64_t number) {
+    const auto v = current();
+    auto victim = v->value_logs.find(number);
+    if (victim == v->value_logs.end()) return true;
 
-    uint64_t id = next_file_id();
-    std::string out_path;
-    if (!SSTable::Build(data_dir_, id, snap, &out_path)) return false;
+    // Only L1+ tables point into it (pick_value_log_gc). Each is rewritten
+    // at its level with the same keys, so the level stays sorted.
+    ValueLogBuilder log(data_dir_, new_file_id());
+    if (!log.open()) return false;
+    VersionEdit edit;
+    std::vector<TableRef> inputs, outputs;
+    uint64_t moved = 0;
+    auto fail = [&] {
+        for (const auto& t : outputs) t->mark_obsolete();
+        return false;
+    };
+    for (int l = 1; l < v->num_levels(); ++l) {
+        for (const auto& t : v->levels[l]) {
+            const auto& logs = t->value_logs();
+            if (std::none_of(logs.begin(), logs.end(), [&](const ValueLogUsage& u) { return u.number == number; }))
+                continue;
+            CompactionOutput o;
+            if (!rewrite_value_refs(*t, *victim->second, &log, data_dir_, opts_.table, new_file_id(), &o, &moved))
+                return fail();
+            auto out = std::make_shared<SSTable>();
+            if (!out->Open(o.path, opts_.table)) {
+                ::unlink(o.path.c_str());
+                return fail();
+            }
+            out->set_value_logs(std::move(o.value_logs));
+            edit.remove_table(l, t->file_id());
+            edit.add_table(l, out->file_id(), out->file_size(), out->smallest_key(), out->largest_key(),
+                           out->value_logs());
+            inputs.push_back(t);
+            outputs.push_back(std::move(out));
+        }
+    }
 
-    // Open the new table and add to front (newest first)
-    auto t = std::make_shared<SSTable>();
-    if (!t->Open(out_path)) return false;
-    tables_.insert(tables_.begin(), std::move(t));
+    std::vector<ValueLogRef> new_logs;
+    if (moved > 0) {
+        std::string path;
+        if (!log.finish(&path)) return fail();
+        auto nl = std::make_shared<ValueLog>();
+        if (!nl->Open(path, log.number())) {
+            ::unlink(path.c_str());
+            return fail();
+        }
+        stats_->add(Ticker::ValueLogBytesWritten, nl->file_size());
+        new_logs.push_back(std::move(nl));
+    } else {
+        log.abandon();
+    }
+    if (!apply_edit(edit, outputs, new_logs)) {
+        for (const auto& nl : new_logs) nl->mark_obsolete();
+        return fail();
+    }
+    for (const auto& t : inputs) t->mark_obsolete();
+    stats_->add(Ticker::ValueLogGcCount);
+    stats_->add(Ticker::ValueLogGcBytes, moved);
+    return true;
+}
 
-    // Reset WAL and clear MemTable
-    if (!wal_.reset()) return false;
-    mem_.clear();
+bool Engine::compact() {
+    std::lock_guard<std::mutex> g(compaction_mu_);
+    while (!shutting_down_.load()) {
+        auto v = current();
+        if (auto c = pick_compaction(*v, opts_.compaction, compact_pointer_)) {
+            c->snapshots = live_snapshots();
+            if (!do_compaction(*c)) return false;
+            continue;
+        }
+        // levels in shape: collect the value log with the most garbage
+        auto victim = pick_value_log_gc(*v, opts_.value_log);
+        if (!victim) return true;
+        if (!collect_value_log(*victim)) return false;
+    }
     return true;
 }
 
-bool Engine::flush_if_needed() {
-    if (mem_.bytes() >= flush_threshold_) {
-        return flush();
+void Engine::maybe_schedule_compaction() {
+    if (!bg_thread_.joinable()) return;
+    const auto v = current();
+    if (!needs_compaction(*v, opts_.compaction) && !pick_value_log_gc(*v, opts_.value_log)) return;
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        bg_scheduled_ = true;
+    }
+    bg_cv_.notify_one();
+}
+
+void Engine::bg_loop() {
+    std::unique_lock<std::mutex> lk(mu_);
+    for (;;) {
+        bg_cv_.wait(lk, [&] { return bg_scheduled_ || shutting_down_.load(); });
+        if (shutting_down_.load()) break;
+        bg_scheduled_ = false;
+        bg_running_ = true;
+        lk.unlock();
+        bool ok = compact();
+        lk.lock();
+        bg_running_ = false;
+        if (!ok) {
+            bg_error_ = true;
+            std::cerr << "Error: background compaction failed\n";
+        }
+        bg_idle_cv_.notify_all();
+    }
+    bg_running_ = false;
+    bg_idle_cv_.notify_all();
+}
+
+bool Engine::wait_for_compactions() {
+    std::unique_lock<std::mutex> lk(mu_);
+    bg_idle_cv_.wait(lk, [&] { return (!bg_scheduled_ && !bg_running_) || shutting_down_.load(); });
+    return !bg_error_;
+}
+
+bool Engine::make_room_for_write() {
+    if (mem_->bytes() >= opts_.mem_flush_threshold_bytes) {
+        return switch_memtable();
     }
     return true;
 }
 
 bool Engine::sync() {
-    return wal_.sync();
+    std::vector<std::shared_ptr<WAL>> wals;
+    {
+        // the sync thread calls this while the writer may switch segments
+        std::lock_guard<std::mutex> g(mu_);
+        for (const auto& imm : imm_) wals.push_back(imm.wal);
+        wals.push_back(wal_);
+    }
+    for (const auto& w : wals)
+        if (!w->sync()) return false;
+    return true;
+}
+
+void Engine::note_wal_append(size_t bytes) {
+    if (opts_.wal_sync != WalSyncMode::Periodic) return;
+    size_t total = unsynced_bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    // A wakeup lost to a race only delays the sync to the next tick.
+    if (opts_.wal_sync_bytes && total >= opts_.wal_sync_bytes && total - bytes < opts_.wal_sync_bytes)
+        sync_cv_.notify_one();
+}
+
+void Engine::sync_loop() {
+    const auto interval = std::chrono::milliseconds(std::max<uint32_t>(1, opts_.wal_sync_interval_ms));
+    std::unique_lock<std::mutex> lk(mu_);
+    while (!shutting_down_.load()) {
+        sync_cv_.wait_for(lk, interval, [&] {
+            return shutting_down_.load() ||
+                   (opts_.wal_sync_bytes && unsynced_bytes_.load() >= opts_.wal_sync_bytes);
+        });
+        if (shutting_down_.load()) break;
+        size_t pending = unsynced_bytes_.exchange(0);
+        if (pending == 0) continue;  // nothing appended since the last sync
+        lk.unlock();
+        if (sync()) {
+            background_syncs_.fetch_add(1);
+        } else {
+            unsynced_bytes_.fetch_add(pending);
+            std::cerr << "WAL sync failed; retrying on the next tick\n";
+        }
+        lk.lock();
+    }
 }
 
 bool Engine::put(const std::string& key, const std::string& value) {
-    if (!wal_.appendPut(key, value)) return false;
-    if (!mem_.put(key, value)) return false;
-    return flush_if_needed();
+    StopWatch sw(stats_.get(), Histogram::PutNanos);
+    stats_->add(Ticker::PutCalls);
+    stats_->add(Ticker::BytesWritten, key.size() + value.size());
+    Writer w;
+    w.type = RecType::Put;
+    w.key = &key;
+    w.value = &value;
+    return write_queued(w);
 }
 
 bool Engine::del(const std::string& key) {
-    if (!wal_.appendDel(key)) return false;
-    if (!mem_.del(key)) return false;
-    return flush_if_needed();
+    StopWatch sw(stats_.get(), Histogram::DelNanos);
+    stats_->add(Ticker::DelCalls);
+    stats_->add(Ticker::BytesWritten, key.size());
+    Writer w;
+    w.type = RecType::Del;
+    w.key = &key;
+    return write_queued(w);
+}
+
+bool Engine::write(const WriteBatch& batch) {
+    if (batch.empty()) return true;
+    StopWatch sw(stats_.get(), Histogram::WriteNanos);
+    stats_->add(Ticker::WriteCalls);
+    stats_->add(Ticker::BytesWritten, batch.byte_size());
+    Writer w;
+    w.batch = &batch;
+    return write_queued(w);
+}
+
+bool Engine::write_queued(Writer& w) {
+    std::unique_lock<std::mutex> lk(write_mu_);
+    writers_.push_back(&w);
+    while (!w.done && writers_.front() != &w) w.cv.wait(lk);
+    if (w.done) return w.ok;  // a leader wrote it for us
+
+    // We lead: take the queue as it stands, up to kMaxGroupBytes, and write
+    // it outside the lock so the next group can queue up meanwhile. A
+    // memtable switch for flush() goes alone.
+    std::vector<Writer*> group;
+    size_t bytes = 0;
+    for (Writer* x : writers_) {
+        if (x->force_switch && !group.empty()) break;
+        group.push_back(x);
+        if (x->force_switch) break;
+        bytes += x->batch ? x->batch->byte_size() : x->key->size() + (x->value ? x->value->size() : 0);
+        if (bytes >= kMaxGroupBytes) break;
+    }
+    lk.unlock();
+    bool ok = w.force_switch ? mem_->empty() || switch_memtable() : write_group(group);
+    lk.lock();
+
+    for (size_t i = 0; i < group.size(); ++i) {
+        Writer* x = writers_.front();
+        writers_.pop_front();
+        x->ok = ok;
+        x->done = true;
+        if (x != &w) x->cv.notify_one();
+    }
+    if (!writers_.empty()) writers_.front()->cv.notify_one();  // next leader
+    return ok;
 }
 
-std::optional<std::string> Engine::get(const std::string& key) const {
-    // 1) MemTable first
-    if (auto mv = mem_.get(key)) {
-        if (mv->type == RecType::Put) return mv->value;
-        return std::nullopt; // Del tombstone
+bool Engine::write_group(const std::vector<Writer*>& group) {
+    const bool sync = opts_.wal_sync == WalSyncMode::EveryWrite;
+    const Writer& first = *group.front();
+    if (group.size() == 1 && !first.batch) {
+        // one put or del: a plain record, inserted without re-encoding
+        const SequenceNumber seq = last_seq_ + 1;
+        bool ok = first.type == RecType::Put ? wal_->appendPut(*first.key, *first.value, sync, seq)
+                                             : wal_->appendDel(*first.key, sync, seq);
+        if (!ok) return false;
+        last_seq_ = seq;
+        note_wal_append(WAL::kRecordHeader + first.key->size() + (first.value ? first.value->size() : 0));
+        ok = first.type == RecType::Put ? mem_->put(*first.key, *first.value, seq) : mem_->del(*first.key, seq);
+        visible_seq_.store(last_seq_, std::memory_order_release);
+        return ok && make_room_for_write();
     }
 
-    // 2) SSTables, newest -> oldest
-    for (const auto& t : tables_) {
+    // Several writers (or one batch): one batch record, applied in queue
+    // order, so replay rebuilds exactly what readers saw
+    const WriteBatch* batch = first.batch;
+    if (group.size() > 1) {
+        group_batch_.clear();
+        for (const Writer* x : group) {
+            if (x->batch)
+                group_batch_.append(*x->batch);
+            else if (x->type == RecType::Put)
+                group_batch_.put(*x->key, *x->value);
+            else
+                group_batch_.del(*x->key);
+        }
+        batch = &group_batch_;
+    }
+    const SequenceNumber first_seq = last_seq_ + 1;
+    if (!wal_->appendBatch(*batch, sync, first_seq)) return false;
+    last_seq_ += batch->count();
+    note_wal_append(WAL::kRecordHeader + batch->byte_size());
+    bool ok = mem_->apply(*batch, first_seq);
+    // the whole group becomes visible at once, before any memtable switch
+    visible_seq_.store(last_seq_, std::memory_order_release);
+    return ok && make_room_for_write();
+}
+
+std::optional<std::string> Engine::get(const std::string& key, const Snapshot* snapshot) const {
+    StopWatch sw(stats_.get(), Histogram::GetNanos);
+    PerfTimer perf_timer(&PerfContext::get_nanos);
+    stats_->add(Ticker::GetCalls);
+    // No lock: the SuperVersion keeps its memtables and tables alive
+    SequenceNumber seq = 0;
+    const auto sv = super_version(&seq);
+    if (snapshot) seq = snapshot->sequence();
+    const auto& mem = sv->mem;
+    const auto& imms = sv->imms;   // newest first
+    const auto& v = sv->version;
+
+    // 1) MemTables first: active, then those waiting to be flushed
+    std::optional<MemValue> mv;
+    {
+        PerfTimer timer(&PerfContext::memtable_nanos);
+        mv = mem->get(key, seq);
+        size_t searched = 1;
+        for (size_t i = 0; !mv && i < imms.size(); ++i, ++searched) mv = imms[i]->get(key, seq);
+        perf_count(&PerfContext::memtable_lookups, searched);
+    }
+    if (mv) {
+        stats_->add(Ticker::GetMemtableHits);
+        if (mv->type != RecType::Put) return std::nullopt;  // Del tombstone
+        stats_->add(Ticker::GetFound);
+        return std::move(mv->value);
+    }
+
+    // 2) SSTables, newest -> oldest: every L0 table, then at most one per level
+    uint64_t tables = 0, bytes = 0;
+    auto probe = [&](const SSTable& t, std::optional<std::string>* result) {
         std::string out;
-        auto kind = t->Probe(key, &out);
-        if (kind == SSTable::ProbeKind::Put) return out;
-        if (kind == SSTable::ProbeKind::Tombstone) return std::nullopt; // stop search
-        // else Absent: continue
+        ++tables;
+        auto kind = t.Probe(key, &out, seq, &bytes);
+        if (kind == SSTable::ProbeKind::Put) *result = std::move(out);
+        if (kind == SSTable::ProbeKind::ValueRef) {
+            std::string value;
+            if (read_value(*v, out, &value)) *result = std::move(value);
+        }
+        return kind != SSTable::ProbeKind::Absent;  // Tombstone stops the search too
+    };
+    std::optional<std::string> result;
+    [&] {
+        for (const auto& t : v->levels[0])
+            if (probe(*t, &result)) return;
+        for (int l = 1; l < v->num_levels(); ++l) {
+            const SSTable* t = v->find_in_level(l, key);
+            if (t && probe(*t, &result)) return;
+        }
+    }();
+    stats_->add(Ticker::TablesProbed, tables);
+    stats_->add(Ticker::TableBytesRead, bytes);
+    stats_->record(Histogram::TablesPerGet, tables);
+    stats_->record(Histogram::BytesPerGet, bytes);
+    if (result) stats_->add(Ticker::GetFound);
+    return result;
+}
+
+std::vector<std::optional<std::string>> Engine::multi_get(std::span<const std::string_view> keys,
+                                                          const Snapshot* snapshot) const {
+    StopWatch sw(stats_.get(), Histogram::MultiGetNanos);
+    stats_->add(Ticker::MultiGetCalls);
+    stats_->add(Ticker::MultiGetKeys, keys.size());
+    // No lock: the SuperVersion keeps its memtables and tables alive
+    SequenceNumber seq = 0;
+    const auto sv = super_version(&seq);
+    if (snapshot) seq = snapshot->sequence();
+    const auto& mem = sv->mem;
+    const auto& imms = sv->imms;   // newest first
+    const auto& v = sv->version;
+
+    // Distinct keys in sorted order; slot[i] is the one keys[i] maps to
+    std::vector<size_t> order(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a] < keys[b]; });
+    std::vector<std::string_view> uniq;
+    std::vector<size_t> slot(keys.size());
+    for (size_t i : order) {
+        if (uniq.empty() || uniq.back() != keys[i]) uniq.push_back(keys[i]);
+        slot[i] = uniq.size() - 1;
+    }
+    std::vector<std::optional<std::string>> found(uniq.size());
+    std::vector<size_t> pending;   // unresolved, ascending
+
+    // 1) MemTables first: active, then those waiting to be flushed
+    for (size_t u = 0; u < uniq.size(); ++u) {
+        PerfTimer timer(&PerfContext::memtable_nanos);
+        std::optional<MemValue> mv = mem->get(uniq[u], seq);
+        size_t searched = 1;
+        for (size_t i = 0; !mv && i < imms.size(); ++i, ++searched) mv = imms[i]->get(uniq[u], seq);
+        perf_count(&PerfContext::memtable_lookups, searched);
+        if (!mv)
+            pending.push_back(u);
+        else if (mv->type == RecType::Put)
+            found[u] = std::move(mv->value);
+    }
+
+    // 2) SSTables, newest -> oldest, each probed once with its run of pending keys
+    std::vector<std::string_view> batch;
+    std::vector<SSTable::ProbeKind> kinds;
+    std::vector<std::string> outs;
+    std::vector<bool> resolved(uniq.size(), false);
+    uint64_t tables = 0, bytes = 0;
+    auto probe = [&](const SSTable& t, size_t first, size_t last) {   // pending[first, last)
+        batch.clear();
+        for (size_t p = first; p < last; ++p) batch.push_back(uniq[pending[p]]);
+        ++tables;
+        t.MultiProbe(batch, &kinds, &outs, seq, &bytes);
+        for (size_t p = first; p < last; ++p) {
+            size_t u = pending[p];
+            auto kind = kinds[p - first];
+            if (kind == SSTable::ProbeKind::Put) found[u] = std::move(outs[p - first]);
+            if (kind == SSTable::ProbeKind::ValueRef) {
+                std::string value;
+                if (read_value(*v, outs[p - first], &value)) found[u] = std::move(value);
+            }
+            resolved[u] = kind != SSTable::ProbeKind::Absent;   // Tombstone stops the search too
+        }
+    };
+    auto drop_resolved = [&] {
+        pending.erase(std::remove_if(pending.begin(), pending.end(), [&](size_t u) { return resolved[u]; }),
+                      pending.end());
+    };
+    auto key_less = [&](size_t u, std::string_view k) { return uniq[u] < k; };
+
+    for (const auto& t : v->levels[0]) {
+        if (pending.empty()) break;
+        if (t->index_size() == 0) continue;
+        // the pending keys within the table's range
+        size_t first = std::lower_bound(pending.begin(), pending.end(), std::string_view(t->smallest_key()),
+                                        key_less) - pending.begin();
+        size_t last = first;
+        while (last < pending.size() && uniq[pending[last]] <= t->largest_key()) ++last;
+        if (first == last) continue;
+        probe(*t, first, last);
+        drop_resolved();
+    }
+    for (int l = 1; l < v->num_levels() && !pending.empty(); ++l) {
+        // both sorted and the tables disjoint: one merge walk pairs each
+        // table with its run of pending keys
+        const auto& files = v->levels[l];
+        size_t f = 0, p = 0;
+        while (p < pending.size() && f < files.size()) {
+            if (files[f]->largest_key() < uniq[pending[p]]) {
+                ++f;
+                continue;
+            }
+            size_t end = p;
+            while (end < pending.size() && uniq[pending[end]] <= files[f]->largest_key()) ++end;
+            size_t first = p;
+            while (first < end && uniq[pending[first]] < files[f]->smallest_key()) ++first;
+            if (first < end) probe(*files[f], first, end);
+            p = end;
+            ++f;
+        }
+        drop_resolved();
+    }
+    stats_->add(Ticker::TablesProbed, tables);
+    stats_->add(Ticker::TableBytesRead, bytes);
+
+    // copy a value only for repeated keys; the last occurrence takes it
+    std::vector<std::optional<std::string>> result(keys.size());
+    for (size_t j = keys.size(); j-- > 0;) {
+        size_t i = order[j];
+        if (j + 1 < keys.size() && slot[order[j + 1]] == slot[i])
+            result[i] = result[order[j + 1]];
+        else
+            result[i] = std::move(found[slot[i]]);
     }
-    return std::nullopt;
+    return result;
+}
+
+std::unique_ptr<Iterator> Engine::NewIterator(const ReadOptions& ro) const {
+    // Everything the children point into, released after the merged iterator
+    SequenceNumber seq = 0;
+    auto pin = super_version(&seq);
+    if (ro.snapshot) seq = ro.snapshot->sequence();
+    auto in_bounds = [&](const TableRef& t) {
+        if (t->index_size() == 0) return false;
+        if (!ro.upper_bound.empty() && t->smallest_key() >= ro.upper_bound) return false;
+        return ro.lower_bound.empty() || t->largest_key() >= ro.lower_bound;
+    };
+
+    // Children newest -> oldest, the order get() probes them in
+    std::vector<std::unique_ptr<Iterator>> children;
+    children.push_back(pin->mem->NewIterator());
+    for (const auto& imm : pin->imms) children.push_back(imm->NewIterator());
+    for (const auto& t : pin->version->levels[0])
+        if (in_bounds(t)) children.push_back(t->NewIterator(ro.fill_cache, ro.upper_bound));
+    for (int l = 1; l < pin->version->num_levels(); ++l) {
+        std::vector<TableRef> tables;
+        for (const auto& t : pin->version->levels[l])
+            if (in_bounds(t)) tables.push_back(t);
+        if (!tables.empty()) children.push_back(NewLevelIterator(std::move(tables), ro.fill_cache, ro.upper_bound));
+    }
+    ValueResolver resolve;
+    if (!pin->version->value_logs.empty())
+        resolve = [this, v = pin->version.get()](std::string_view ref, std::string* value) {
+            return read_value(*v, ref, value);
+        };
+    return NewDBIterator(NewMergingIterator(std::move(children)), ro.lower_bound, ro.upper_bound, seq,
+                         std::move(pin), std::move(resolve));
+}
+
+bool Engine::read_value(const Version& v, std::string_view encoded, std::string* value) const {
+    ValueRef ref;
+    if (!ref.decode(encoded)) return false;
+    auto it = v.value_logs.find(ref.number);
+    if (it == v.value_logs.end() || !it->second->Read(ref, value)) return false;
+    stats_->add(Ticker::ValueLogBytesRead, ref.size);
+    return true;
+}
+
+const Snapshot* Engine::GetSnapshot() {
+    std::lock_guard<std::mutex> g(mu_);
+    // registered before any flush or compaction could drop what it reads
+    auto* s = new Snapshot(visible_seq_.load(std::memory_order_acquire));
+    snapshots_.insert(s->sequence());
+    return s;
+}
+
+void Engine::ReleaseSnapshot(const Snapshot* snapshot) {
+    if (!snapshot) return;
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        snapshots_.erase(snapshots_.find(snapshot->sequence()));
+    }
+    delete snapshot;
+}
+
+std::vector<size_t> Engine::level_table_counts() const {
+    auto v = current();
+    std::vector<size_t> n;
+    for (const auto& level : v->levels) n.push_back(level.size());
+    return n;
 }
 
 void Engine::list_tables() const {
-    std::cout << "SSTables (newest->oldest): " << tables_.size() << "\n";
-    for (const auto& t : tables_) {
-        std::cout << "  " << t->path() << " (index=" << t->index_size() << ")\n";
+    auto v = current();
+    std::cout << "Immutable memtables: " << num_immutable_memtables() << "\n";
+    std::cout << "SSTables: " << v->num_tables() << "\n";
+    for (int l = 0; l < v->num_levels(); ++l) {
+        if (v->levels[l].empty()) continue;
+        std::cout << " L" << l << " (" << v->levels[l].size() << " tables, "
+                  << v->level_bytes(l) << " bytes" << (l == 0 ? ", newest->oldest" : "") << ")\n";
+        for (const auto& t : v->levels[l]) {
+            std::cout << "  " << t->path() << " (v" << t->format_version() - 1
+                      << ", index=" << t->index_size()
+                      << (t->has_filter() ? ", bloom" : "")
+                      << ", probes=" << t->probes()
+                      << ", [" << t->smallest_key() << " .. " << t->largest_key() << "])\n";
+        }
+    }
+    if (v->value_logs.empty()) return;
+    std::cout << "Value logs: " << v->value_logs.size() << "\n";
+    for (const auto& [number, log] : v->value_logs)
+        std::cout << "  " << log->path() << " (" << log->data_bytes() << " bytes, "
+                  << v->value_log_live_bytes(number) << " live)\n";
+}
+
+std::string Engine::prometheus_text() const {
+    std::string out = stats_->to_prometheus();
+    char line[256];
+    auto metric = [&](const char* name, const char* type, uint64_t value) {
+        std::snprintf(line, sizeof(line), "# TYPE %s %s\n%s %llu\n", name, type, name,
+                      static_cast<unsigned long long>(value));
+        out += line;
+    };
+    metric("kv_memtable_bytes", "gauge", mem_bytes());
+    metric("kv_immutable_memtables", "gauge", num_immutable_memtables());
+    metric("kv_last_sequence", "gauge", last_sequence());
+    metric("kv_write_stalls_total", "counter", write_stalls());
+    metric("kv_wal_background_syncs_total", "counter", background_syncs());
+    metric("kv_bloom_useful_total", "counter", filter_stats_.useful.load());
+    metric("kv_bloom_positive_total", "counter", filter_stats_.positive.load());
+    metric("kv_bloom_false_positive_total", "counter", filter_stats_.false_positive.load());
+    if (cache_) {
+        const auto cs = cache_->stats();
+        metric("kv_block_cache_hits_total", "counter", cs.hits);
+        metric("kv_block_cache_misses_total", "counter", cs.misses);
+        metric("kv_block_cache_usage_bytes", "gauge", cs.usage);
+    }
+
+    // one sample per level and per live table
+    auto v = current();
+    out += "# TYPE kv_level_tables gauge\n";
+    for (int l = 0; l < v->num_levels(); ++l) {
+        std::snprintf(line, sizeof(line), "kv_level_tables{level=\"%d\"} %zu\n", l, v->levels[l].size());
+        out += line;
     }
+    out += "# TYPE kv_level_bytes gauge\n";
+    for (int l = 0; l < v->num_levels(); ++l) {
+        std::snprintf(line, sizeof(line), "kv_level_bytes{level=\"%d\"} %llu\n", l,
+                      static_cast<unsigned long long>(v->level_bytes(l)));
+        out += line;
+    }
+    uint64_t vlog_bytes = 0, vlog_live = 0;
+    for (const auto& [number, log] : v->value_logs) {
+        vlog_bytes += log->data_bytes();
+        vlog_live += v->value_log_live_bytes(number);
+    }
+    metric("kv_value_log_files", "gauge", v->value_logs.size());
+    metric("kv_value_log_bytes", "gauge", vlog_bytes);
+    metric("kv_value_log_live_bytes", "gauge", vlog_live);
+    out += "# TYPE kv_sstable_probes_total counter\n";
+    for (int l = 0; l < v->num_levels(); ++l)
+        for (const auto& t : v->levels[l]) {
+            std::snprintf(line, sizeof(line), "kv_sstable_probes_total{level=\"%d\",file=\"%llu\"} %llu\n", l,
+                          static_cast<unsigned long long>(t->file_id()),
+                          static_cast<unsigned long long>(t->probes()));
+            out += line;
+        }
+    return out;
 }
@@ -0,0 +1,83 @@
+#include "iterator.h"
+
+#include <algorithm>
+
+namespace {
+
+class MergingIterator final : public Iterator {
+   public:
+    explicit MergingIterator(std::vector<std::unique_ptr<Iterator>> children)
+        : children_(std::move(children)) {
+        heap_.reserve(children_.size());
+    }
+
+    bool Valid() const override { return !heap_.empty(); }
+
+    void SeekToFirst() override {
+        for (auto& c : children_) c->SeekToFirst();
+        rebuild_heap();
+    }
+
+    void Seek(std::string_view target) override {
+        for (auto& c : children_) c->Seek(target);
+        rebuild_heap();
+    }
+
+    void Next() override {
+        if (heap_.empty()) return;
+        std::pop_heap(heap_.begin(), heap_.end(), cmp());
+        size_t i = heap_.back();
+        children_[i]->Next();
+        if (children_[i]->Valid()) {
+            std::push_heap(heap_.begin(), heap_.end(), cmp());
+        } else {
+            heap_.pop_back();
+        }
+    }
+
+    std::string_view key() const override { return top()->key(); }
+    std::string_view value() const override { return top()->value(); }
+    RecType type() const override { return top()->type(); }
+    SequenceNumber seq() const override { return top()->seq(); }
+
+    bool ok() const override {
+        for (const auto& c : children_)
+            if (!c->ok()) return false;
+        return true;
+    }
+
+   private:
+    // std::*_heap builds a max-heap; "greater" puts the smallest key (and, on
+    // ties, the highest seq, then the lowest child index = newest source) at
+    // the front.
+    struct Greater {
+        const MergingIterator* self;
+        bool operator()(size_t a, size_t b) const {
+            const Iterator* x = self->children_[a].get();
+            const Iterator* y = self->children_[b].get();
+            int c = x->key().compare(y->key());
+            if (c != 0) return c > 0;
+            if (x->seq() != y->seq()) return x->seq() < y->seq();
+            return a > b;
+        }
+    };
+    Greater cmp() const { return Greater{this}; }
+
+    const Iterator* top() const { return children_[heap_.front()].get(); }
+
+    void rebuild_heap() {
+        heap_.clear();
+        for (size_t i = 0; i < children_.size(); ++i)
+            if (children_[i]->Valid()) heap_.push_back(i);
+        std::make_heap(heap_.begin(), heap_.end(), cmp());
+    }
+
+    std::vector<std::unique_ptr<Iterator>> children_;
+    std::vector<size_t> heap_;  // indices of valid children
+};
+
+}  // namespace
+
+std::unique_ptr<Iterator> NewMergingIterator(std::vector<std::unique_ptr<Iterator>> children) {
+    return std::make_unique<MergingIterator>(std::move(children));
+}
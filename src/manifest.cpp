@@ -0,0 +1,282 @@
+#include "manifest.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+
+#include "sstable.h"
+#include "utils.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr uint32_t kMagic = 0x4B564D46;  // 'K''V''M''F' (KV manifest)
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderSize = 8;
+constexpr size_t kRecordHeaderSize = 8;  // crc + len
+
+// VersionEdit field tags
+enum Tag : uint32_t {
+    kNextFileId = 1,
+    kWalNumber = 2,
+    kRemovedTable = 3,
+    kAddedTable = 4,
+    kLastSequence = 5,
+    kTableValueLogs = 6,  // follows the kAddedTable of the table it describes
+};
+
+void put_length_prefixed(std::string* dst, std::string_view s) {
+    put_varint32(dst, static_cast<uint32_t>(s.size()));
+    dst->append(s.data(), s.size());
+}
+
+const char* get_length_prefixed(const char* p, const char* limit, std::string* out) {
+    uint32_t n = 0;
+    p = get_varint32(p, limit, &n);
+    if (!p || static_cast<size_t>(limit - p) < n) return nullptr;
+    out->assign(p, n);
+    return p + n;
+}
+
+bool write_all(int fd, const char* p, size_t n) {
+    while (n) {
+        ssize_t w = ::write(fd, p, n);
+        if (w < 0) return false;
+        p += w;
+        n -= static_cast<size_t>(w);
+    }
+    return true;
+}
+
+bool pread_all(int fd, char* p, size_t n, uint64_t off) {
+    while (n) {
+        ssize_t r = ::pread(fd, p, n, static_cast<off_t>(off));
+        if (r <= 0) return false;
+        p += r;
+        n -= static_cast<size_t>(r);
+        off += static_cast<uint64_t>(r);
+    }
+    return true;
+}
+
+void put_record(std::string* dst, const VersionEdit& e) {
+    std::string payload;
+    e.encode(&payload);
+    put_fixed32(dst, compute_crc32(payload));
+    put_fixed32(dst, static_cast<uint32_t>(payload.size()));
+    dst->append(payload);
+}
+}  // namespace
+
+// ===== VersionEdit =====
+
+void VersionEdit::add_table(int level, uint64_t file_id, uint64_t file_size,
+                            std::string smallest, std::string largest,
+                            std::vector<ValueLogUsage> value_logs) {
+    added.push_back(NewTable{level, file_id, file_size, std::move(smallest), std::move(largest),
+                             std::move(value_logs)});
+}
+
+void VersionEdit::encode(std::string* out) const {
+    if (next_file_id) {
+        put_varint32(out, kNextFileId);
+        put_varint64(out, *next_file_id);
+    }
+    if (wal_number) {
+        put_varint32(out, kWalNumber);
+        put_varint64(out, *wal_number);
+    }
+    if (last_sequence) {
+        put_varint32(out, kLastSequence);
+        put_varint64(out, *last_sequence);
+    }
+    for (const auto& [level, id] : removed) {
+        put_varint32(out, kRemovedTable);
+        put_varint32(out, static_cast<uint32_t>(level));
+        put_varint64(out, id);
+    }
+    for (const auto& t : added) {
+        put_varint32(out, kAddedTable);
+        put_varint32(out, static_cast<uint32_t>(t.level));
+        put_varint64(out, t.file_id);
+        put_varint64(out, t.file_size);
+        put_length_prefixed(out, t.smallest);
+        put_length_prefixed(out, t.largest);
+        if (!t.value_logs.empty()) {
+            put_varint32(out, kTableValueLogs);
+            put_varint32(out, static_cast<uint32_t>(t.value_logs.size()));
+            for (const auto& u : t.value_logs) {
+                put_varint64(out, u.number);
+                put_varint64(out, u.bytes);
+            }
+        }
+    }
+}
+
+bool VersionEdit::decode(std::string_view in) {
+    *this = VersionEdit{};
+    const char* p = in.data();
+    const char* limit = p + in.size();
+    while (p && p < limit) {
+        uint32_t tag = 0, level = 0;
+        uint64_t v = 0;
+        p = get_varint32(p, limit, &tag);
+        if (!p) return false;
+        switch (tag) {
+            case kNextFileId:
+                p = get_varint64(p, limit, &v);
+                next_file_id = v;
+                break;
+            case kWalNumber:
+                p = get_varint64(p, limit, &v);
+                wal_number = v;
+                break;
+            case kLastSequence:
+                p = get_varint64(p, limit, &v);
+                last_sequence = v;
+                break;
+            case kRemovedTable:
+                p = get_varint32(p, limit, &level);
+                if (p) p = get_varint64(p, limit, &v);
+                removed.emplace_back(static_cast<int>(level), v);
+                break;
+            case kAddedTable: {
+                NewTable t;
+                p = get_varint32(p, limit, &level);
+                t.level = static_cast<int>(level);
+                if (p) p = get_varint64(p, limit, &t.file_id);
+                if (p) p = get_varint64(p, limit, &t.file_size);
+                if (p) p = get_length_prefixed(p, limit, &t.smallest);
+                if (p) p = get_length_prefixed(p, limit, &t.largest);
+                added.push_back(std::move(t));
+                break;
+            }
+            case kTableValueLogs: {
+                uint32_t n = 0;
+                p = get_varint32(p, limit, &n);
+                if (!p || added.empty()) return false;
+                auto& logs = added.back().value_logs;
+                for (uint32_t i = 0; p && i < n; ++i) {
+                    ValueLogUsage u;
+                    p = get_varint64(p, limit, &u.number);
+                    if (p) p = get_varint64(p, limit, &u.bytes);
+                    logs.push_back(u);
+                }
+                break;
+            }
+            default:
+                return false;  // written by a newer version
+        }
+    }
+    return p == limit;
+}
+
+// ===== ManifestState =====
+
+bool ManifestState::apply(const VersionEdit& e) {
+    const int n = static_cast<int>(levels.size());
+    for (const auto& [level, id] : e.removed) {
+        if (level < 0 || level >= n) return false;
+        auto& files = levels[level];
+        files.erase(std::remove_if(files.begin(), files.end(),
+                                   [id = id](const VersionEdit::NewTable& t) { return t.file_id == id; }),
+                    files.end());
+        removed_ids.push_back(id);
+    }
+    for (const auto& t : e.added) {
+        if (t.level < 0 || t.level >= n) return false;
+        auto& files = levels[t.level];
+        if (t.level == 0)
+            files.insert(files.begin(), t);  // newest first
+        else
+            files.push_back(t);
+    }
+    if (e.next_file_id) next_file_id = std::max(next_file_id, *e.next_file_id);
+    if (e.wal_number) wal_number = *e.wal_number;
+    if (e.last_sequence) last_sequence = std::max(last_sequence, *e.last_sequence);
+    return true;
+}
+
+// ===== Manifest =====
+
+Manifest::Manifest(std::string dir) : dir_(std::move(dir)), path_((fs::path(dir_) / "MANIFEST").string()) {}
+
+Manifest::~Manifest() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool Manifest::exists() const {
+    std::error_code ec;
+    return fs::exists(path_, ec);
+}
+
+bool Manifest::recover(ManifestState* st) const {
+    int fd = ::open(path_.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat sb;
+    if (::fstat(fd, &sb) != 0) {
+        ::close(fd);
+        return false;
+    }
+    std::string buf(static_cast<size_t>(sb.st_size), '\0');
+    bool ok = pread_all(fd, buf.data(), buf.size(), 0);
+    ::close(fd);
+    if (!ok || buf.size() < kHeaderSize) return false;
+    if (decode_fixed32(buf.data()) != kMagic || decode_fixed32(buf.data() + 4) != kVersion) return false;
+
+    size_t off = kHeaderSize;
+    while (off < buf.size()) {
+        if (buf.size() - off < kRecordHeaderSize) break;  // torn tail
+        uint32_t crc = decode_fixed32(buf.data() + off);
+        uint32_t len = decode_fixed32(buf.data() + off + 4);
+        if (buf.size() - off - kRecordHeaderSize < len) break;  // torn tail
+        std::string_view payload(buf.data() + off + kRecordHeaderSize, len);
+        off += kRecordHeaderSize + len;
+        if (compute_crc32(payload) != crc) {
+            if (off == buf.size()) break;  // torn last record
+            return false;
+        }
+        VersionEdit e;
+        if (!e.decode(payload) || !st->apply(e)) return false;
+    }
+    return true;
+}
+
+bool Manifest::rewrite(const VersionEdit& snapshot) {
+    const std::string tmp = path_ + ".tmp";
+    std::string buf;
+    put_fixed32(&buf, kMagic);
+    put_fixed32(&buf, kVersion);
+    put_record(&buf, snapshot);
+
+    int fd = ::open(tmp.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd < 0) return false;
+    bool ok = write_all(fd, buf.data(), buf.size()) && ::fsync(fd) == 0;
+    ok = ok && ::rename(tmp.c_str(), path_.c_str()) == 0 && SSTable::fsync_dir(dir_);
+    if (!ok) {
+        ::close(fd);
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    // fd now refers to the live MANIFEST; keep appending to it
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = fd;
+    size_ = buf.size();
+    return true;
+}
+
+bool Manifest::append(const VersionEdit& e) {
+    if (fd_ < 0) return false;
+    std::string buf;
+    put_record(&buf, e);
+    if (!write_all(fd_, buf.data(), buf.size()) || ::fdatasync(fd_) != 0) {
+        // drop a partial record so later appends don't follow garbage
+        if (::ftruncate(fd_, static_cast<off_t>(size_)) == 0) ::lseek(fd_, static_cast<off_t>(size_), SEEK_SET);
+        return false;
+    }
+    size_ += buf.size();
+    return true;
+}
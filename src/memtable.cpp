@@ -1,44 +1,299 @@
 #include "memtable.h"
 
-static size_t approxSizeOf(const std::string& k, const MemValue& mv) {
-    return k.size() + (mv.type == RecType::Put ? mv.value.size() : 0) + 2;
+#include <atomic>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+
+#include "arena.h"
+#include "iterator.h"
+#include "skiplist.h"
+#include "write_batch.h"
+
+class MemTable::Rep {
+public:
+    virtual ~Rep() = default;
+    virtual void add(std::string key, RecType type, std::string value, SequenceNumber seq) = 0;
+    virtual void add_batch(const WriteBatch& batch, SequenceNumber first_seq) {
+        SequenceNumber seq = first_seq;
+        WriteBatch::for_each(batch.rep(), [&](RecType t, std::string_view k, std::string_view v) {
+            add(std::string(k), t, std::string(v), seq);
+            if (first_seq) ++seq;
+        });
+    }
+    virtual std::optional<MemValue> get(std::string_view key, SequenceNumber snapshot) const = 0;
+    virtual void clear() = 0;
+    virtual size_t bytes() const = 0;
+    virtual size_t size() const = 0;
+    virtual void snapshot(std::vector<std::pair<std::string, MemValue>>& out) const = 0;
+    virtual std::unique_ptr<Iterator> new_iterator() const = 0;
+};
+
+namespace {
+
+// Keys, values and map nodes all live in the arena, so bytes() is the
+// memory actually held and flush frees it with the table.
+class MapRep final : public MemTable::Rep {
+public:
+    MapRep() : resource_(&arena_), kv_(&resource_) {}
+
+    void add(std::string key, RecType type, std::string value, SequenceNumber seq) override {
+        std::unique_lock<std::shared_mutex> g(mu_);
+        add_locked(key, type, value, seq);
+    }
+
+    // one lock for the whole batch, so readers see all of it or none
+    void add_batch(const WriteBatch& batch, SequenceNumber first_seq) override {
+        std::unique_lock<std::shared_mutex> g(mu_);
+        SequenceNumber seq = first_seq;
+        WriteBatch::for_each(batch.rep(), [&](RecType t, std::string_view k, std::string_view v) {
+            add_locked(k, t, v, seq);
+            if (first_seq) ++seq;
+        });
+    }
+
+    std::optional<MemValue> get(std::string_view key, SequenceNumber snapshot) const override {
+        std::shared_lock<std::shared_mutex> g(mu_);
+        auto it = kv_.lower_bound(VersionKey{key, snapshot});  // newest version <= snapshot
+        if (it == kv_.end() || it->first.key != key) return std::nullopt;
+        return MemValue{it->second.type, std::string(it->second.value), it->first.seq};
+    }
+
+    void clear() override {
+        std::unique_lock<std::shared_mutex> g(mu_);
+        kv_.clear();
+        keys_ = 0;
+        arena_.reset();
+    }
+
+    size_t bytes() const override { return arena_.memory_usage(); }
+
+    size_t size() const override {
+        std::shared_lock<std::shared_mutex> g(mu_);
+        return keys_;
+    }
+
+    void snapshot(std::vector<std::pair<std::string, MemValue>>& out) const override {
+        std::shared_lock<std::shared_mutex> g(mu_);
+        out.clear();
+        out.reserve(kv_.size());
+        for (const auto& [vk, slot] : kv_) {
+            out.emplace_back(std::string(vk.key), MemValue{slot.type, std::string(slot.value), vk.seq});
+        }
+    }
+
+    std::unique_ptr<Iterator> new_iterator() const override { return std::make_unique<Iter>(this); }
+
+private:
+    struct Slot {
+        RecType type;
+        std::string_view value;  // in the arena; empty for Del
+    };
+    // One entry per version, ordered for flush → SSTable: keys ascending,
+    // each key's versions newest first.
+    struct VersionKey {
+        std::string_view key;  // in the arena, shared by all versions of the key
+        SequenceNumber seq;
+    };
+    struct VersionOrder {
+        bool operator()(const VersionKey& a, const VersionKey& b) const {
+            int c = a.key.compare(b.key);
+            return c != 0 ? c < 0 : a.seq > b.seq;
+        }
+    };
+    using Map = std::pmr::map<VersionKey, Slot, VersionOrder>;
+
+    // Map iterators survive inserts, so each step only needs the shared
+    // lock; keys and values are in the arena and stay put.
+    class Iter final : public Iterator {
+    public:
+        explicit Iter(const MapRep* rep) : rep_(rep) {}
+
+        bool Valid() const override { return valid_; }
+        void SeekToFirst() override {
+            std::shared_lock<std::shared_mutex> g(rep_->mu_);
+            it_ = rep_->kv_.begin();
+            load();
+        }
+        void Seek(std::string_view target) override {
+            std::shared_lock<std::shared_mutex> g(rep_->mu_);
+            it_ = rep_->kv_.lower_bound(VersionKey{target, kMaxSequence});
+            load();
+        }
+        void Next() override {
+            std::shared_lock<std::shared_mutex> g(rep_->mu_);
+            ++it_;
+            load();
+        }
+        std::string_view key() const override { return key_; }
+        std::string_view value() const override { return slot_.value; }
+        RecType type() const override { return slot_.type; }
+        SequenceNumber seq() const override { return seq_; }
+
+    private:
+        void load() {  // mu_ held
+            valid_ = it_ != rep_->kv_.end();
+            if (valid_) {
+                key_ = it_->first.key;
+                seq_ = it_->first.seq;
+                slot_ = it_->second;
+            }
+        }
+
+        const MapRep* rep_;
+        Map::const_iterator it_;
+        bool valid_ = false;
+        std::string_view key_;
+        SequenceNumber seq_ = 0;
+        Slot slot_{RecType::Put, {}};
+    };
+
+    void add_locked(std::string_view key, RecType type, std::string_view value, SequenceNumber seq) {
+        Slot slot{type, store(value)};
+        auto it = kv_.lower_bound(VersionKey{key, seq});
+        if (it != kv_.end() && it->first.key == key && it->first.seq == seq) {
+            it->second = slot;  // same version: the old value stays in the arena until flush
+            return;
+        }
+        // an older version sits at it, a newer one just before it
+        std::string_view stored;
+        if (it != kv_.end() && it->first.key == key) {
+            stored = it->first.key;
+        } else if (it != kv_.begin() && std::prev(it)->first.key == key) {
+            stored = std::prev(it)->first.key;
+        } else {
+            stored = store(key);
+            ++keys_;
+        }
+        kv_.emplace_hint(it, VersionKey{stored, seq}, slot);
+    }
+
+    std::string_view store(std::string_view s) { return {arena_.copy(s.data(), s.size()), s.size()}; }
+
+    mutable std::shared_mutex mu_;
+    Arena arena_;
+    ArenaResource resource_;
+    Map kv_;
+    size_t keys_ = 0;  // distinct keys in kv_
+};
+
+class SkipListRep final : public MemTable::Rep {
+public:
+    SkipListRep() : list_(std::make_unique<SkipList>()) {}
+
+    void add(std::string key, RecType type, std::string value, SequenceNumber seq) override {
+        list_->upsert(key, type, value, seq);
+    }
+
+    void add_batch(const WriteBatch& batch, SequenceNumber first_seq) override {
+        SequenceNumber seq = first_seq;
+        WriteBatch::for_each(batch.rep(), [&](RecType t, std::string_view k, std::string_view v) {
+            list_->upsert(k, t, v, seq);
+            if (first_seq) ++seq;
+        });
+    }
+
+    std::optional<MemValue> get(std::string_view key, SequenceNumber snapshot) const override {
+        const SkipList::Value* v = list_->find(key, snapshot);
+        if (!v) return std::nullopt;
+        return MemValue{v->type, std::string(v->value()), v->seq};
+    }
+
+    void clear() override { list_ = std::make_unique<SkipList>(); }
+
+    // Arena bytes, including values already overwritten: they are only
+    // released with the whole list.
+    size_t bytes() const override { return list_->memory_usage(); }
+    size_t size() const override { return list_->size(); }
+
+    void snapshot(std::vector<std::pair<std::string, MemValue>>& out) const override {
+        out.clear();
+        out.reserve(list_->size());
+        SkipList::Iter it(list_.get());
+        for (it.SeekToFirst(); it.Valid(); it.Next()) {
+            for (const SkipList::Value* v = it.value(); v; v = older(v))
+                out.emplace_back(std::string(it.key()), MemValue{v->type, std::string(v->value()), v->seq});
+        }
+    }
+
+    std::unique_ptr<Iterator> new_iterator() const override { return std::make_unique<Iter>(list_.get()); }
+
+private:
+    // The next version in v's chain with a lower seq: a rewrite under the
+    // same seq replaced the versions behind it.
+    static const SkipList::Value* older(const SkipList::Value* v) {
+        const SkipList::Value* p = v->prev;
+        while (p && p->seq == v->seq) p = p->prev;
+        return p;
+    }
+
+    class Iter final : public Iterator {
+    public:
+        explicit Iter(const SkipList* list) : it_(list) {}
+
+        bool Valid() const override { return it_.Valid(); }
+        void SeekToFirst() override { it_.SeekToFirst(); load(); }
+        void Seek(std::string_view target) override { it_.Seek(target); load(); }
+        void Next() override {
+            if ((v_ = older(v_))) return;  // the same key's next version
+            it_.Next();
+            load();
+        }
+        std::string_view key() const override { return it_.key(); }
+        std::string_view value() const override { return v_->value(); }
+        RecType type() const override { return v_->type; }
+        SequenceNumber seq() const override { return v_->seq; }
+
+    private:
+        // pin the newest version seen now; a concurrent write swaps in a new one
+        void load() { v_ = it_.Valid() ? it_.value() : nullptr; }
+
+        SkipList::Iter it_;
+        const SkipList::Value* v_ = nullptr;
+    };
+
+    std::unique_ptr<SkipList> list_;
+};
+
+}  // namespace
+
+MemTable::MemTable(MemTableRep rep) : kind_(rep) {
+    if (rep == MemTableRep::SkipList)
+        rep_ = std::make_unique<SkipListRep>();
+    else
+        rep_ = std::make_unique<MapRep>();
 }
 
-bool MemTable::put(std::string key, std::string value) {
-    if (auto it = kv_.find(key); it != kv_.end())
-        bytes_ -= approxSizeOf(it->first, it->second);
+MemTable::~MemTable() = default;
 
-    MemValue mv{RecType::Put, std::move(value)};
-    bytes_ += approxSizeOf(key, mv);
-    kv_[std::move(key)] = std::move(mv);
+bool MemTable::put(std::string key, std::string value, SequenceNumber seq) {
+    rep_->add(std::move(key), RecType::Put, std::move(value), seq);
     return true;
 }
 
-bool MemTable::del(std::string key) {
-    if (auto it = kv_.find(key); it != kv_.end())
-        bytes_ -= approxSizeOf(it->first, it->second);
-
-    MemValue mv{RecType::Del, {}};
-    bytes_ += approxSizeOf(key, mv);
-    kv_[std::move(key)] = std::move(mv);
+bool MemTable::del(std::string key, SequenceNumber seq) {
+    rep_->add(std::move(key), RecType::Del, {}, seq);
     return true;
 }
 
-std::optional<MemValue> MemTable::get(const std::string& key) const {
-    auto it = kv_.find(key);
-    if (it == kv_.end()) return std::nullopt;
-    return it->second;
+bool MemTable::apply(const WriteBatch& batch, SequenceNumber first_seq) {
+    if (!WriteBatch::for_each(batch.rep(), [](RecType, std::string_view, std::string_view) {})) return false;
+    rep_->add_batch(batch, first_seq);
+    return true;
 }
 
-void MemTable::clear() {
-    kv_.clear();
-    bytes_ = 0;
+std::optional<MemValue> MemTable::get(std::string_view key, SequenceNumber snapshot) const {
+    return rep_->get(key, snapshot);
 }
 
-void MemTable::snapshot(std::vector<std::pair<std::string, MemValue>>& out) const {
-    out.clear();
-    out.reserve(kv_.size());
-    for (const auto& kv : kv_) {
-        out.emplace_back(kv.first, kv.second);
-    }
-}
\ No newline at end of file
+void MemTable::clear() { rep_->clear(); }
+
+size_t MemTable::bytes() const { return rep_->bytes(); }
+
+size_t MemTable::size() const { return rep_->size(); }
+
+void MemTable::snapshot(std::vector<std::pair<std::string, MemValue>>& out) const { rep_->snapshot(out); }
+
+std::unique_ptr<Iterator> MemTable::NewIterator() const { return rep_->new_iterator(); }
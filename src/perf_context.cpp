@@ -0,0 +1,36 @@
+#include "perf_context.h"
+
+namespace perf_detail {
+constinit thread_local PerfLevel level = PerfLevel::Off;
+constinit thread_local PerfContext context;
+}  // namespace perf_detail
+
+std::string PerfContext::to_string() const {
+    std::string out;
+    auto field = [&](const char* name, uint64_t v) {
+        if (v == 0) return;
+        if (!out.empty()) out += ' ';
+        out += name;
+        out += '=';
+        out += std::to_string(v);
+    };
+    field("memtable_lookups", memtable_lookups);
+    field("tables_probed", tables_probed);
+    field("bloom_checks", bloom_checks);
+    field("bloom_negatives", bloom_negatives);
+    field("index_comparisons", index_comparisons);
+    field("restart_comparisons", restart_comparisons);
+    field("entries_scanned", entries_scanned);
+    field("block_reads", block_reads);
+    field("block_cache_hits", block_cache_hits);
+    field("value_log_reads", value_log_reads);
+    field("bytes_read", bytes_read);
+    field("read_syscalls", read_syscalls);
+    field("get_nanos", get_nanos);
+    field("memtable_nanos", memtable_nanos);
+    field("index_seek_nanos", index_seek_nanos);
+    field("block_read_nanos", block_read_nanos);
+    field("block_seek_nanos", block_seek_nanos);
+    field("value_log_read_nanos", value_log_read_nanos);
+    return out;
+}
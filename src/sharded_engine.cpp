@@ -0,0 +1,228 @@
+#include "sharded_engine.h"
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <latch>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "utils.h"
+
+namespace fs = std::filesystem;
+
+// Seed of the shard hash, so it is independent of the (seed 0) Bloom hash
+// the shard's tables use for the same keys.
+static constexpr uint64_t kShardSeed = 0x5348415244ULL;   // "SHARD"
+
+static EngineOptions shard_options(EngineOptions opts, size_t num_shards) {
+    opts.block_cache_bytes /= num_shards;
+    return opts;
+}
+
+ShardedEngine::Worker::Worker() : thread_([this] { loop(); }) {}
+
+ShardedEngine::Worker::~Worker() {
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void ShardedEngine::Worker::post(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        tasks_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+}
+
+void ShardedEngine::Worker::loop() {
+    std::unique_lock<std::mutex> lk(mu_);
+    for (;;) {
+        cv_.wait(lk, [&] { return stop_ || !tasks_.empty(); });
+        if (tasks_.empty()) return;   // stop_, and nothing left to run
+        auto task = std::move(tasks_.front());
+        tasks_.pop_front();
+        lk.unlock();
+        task();
+        lk.lock();
+    }
+}
+
+ShardedEngine::ShardedEngine(std::string data_dir, size_t num_shards, const EngineOptions& opts)
+    : data_dir_(std::move(data_dir))
+{
+    if (num_shards == 0) num_shards = 1;
+    const EngineOptions o = shard_options(opts, num_shards);
+    for (size_t i = 0; i < num_shards; ++i) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "shard-%03zu", i);
+        shards_.push_back(std::make_unique<Engine>((fs::path(data_dir_) / name).string(), o));
+        workers_.push_back(std::make_unique<Worker>());
+    }
+}
+
+// Workers go first: no task may outlive the engines it runs on.
+ShardedEngine::~ShardedEngine() {
+    workers_.clear();
+    shards_.clear();
+}
+
+size_t ShardedEngine::shard_of(std::string_view key) const {
+    return hash64(key, kShardSeed) % shards_.size();
+}
+
+void ShardedEngine::run_on_shards(const std::vector<size_t>& shards,
+                                  const std::function<void(size_t)>& fn) const {
+    if (shards.empty()) return;
+    std::latch done(static_cast<std::ptrdiff_t>(shards.size() - 1));
+    for (size_t j = 0; j + 1 < shards.size(); ++j) {
+        const size_t i = shards[j];
+        workers_[i]->post([&fn, &done, i] {
+            fn(i);
+            done.count_down();
+        });
+    }
+    fn(shards.back());
+    done.wait();
+}
+
+bool ShardedEngine::run_on_all(const std::function<bool(Engine&)>& fn) {
+    std::vector<size_t> all(shards_.size());
+    for (size_t i = 0; i < all.size(); ++i) all[i] = i;
+    std::atomic<bool> ok{true};
+    run_on_shards(all, [&](size_t i) {
+        if (!fn(*shards_[i])) ok.store(false);
+    });
+    return ok.load();
+}
+
+// SHARDS holds the shard count as one decimal line. Keys are placed by
+// hash modulo that count, so opening with any other would misroute them.
+bool ShardedEngine::check_shard_count() {
+    const std::string path = (fs::path(data_dir_) / "SHARDS").string();
+    if (fs::exists(path)) {
+        std::ifstream in(path);
+        size_t n = 0;
+        if (!(in >> n)) {
+            std::cerr << "Error: cannot read " << path << "\n";
+            return false;
+        }
+        if (n != shards_.size()) {
+            std::cerr << "Error: " << data_dir_ << " has " << n << " shards, opened with "
+                      << shards_.size() << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    const std::string tmp = path + ".tmp";
+    const std::string line = std::to_string(shards_.size()) + "\n";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    bool ok = ::write(fd, line.data(), line.size()) == static_cast<ssize_t>(line.size()) &&
+              ::fsync(fd) == 0;
+    ::close(fd);
+    ok = ok && ::rename(tmp.c_str(), path.c_str()) == 0 && SSTable::fsync_dir(data_dir_);
+    if (!ok) std::cerr << "Error: cannot write " << path << "\n";
+    return ok;
+}
+
+bool ShardedEngine::open() {
+    std::error_code ec;
+    fs::create_directories(data_dir_, ec);
+    if (!check_shard_count()) return false;
+    return run_on_all([](Engine& e) { return e.open(); });
+}
+
+bool ShardedEngine::flush() {
+    return run_on_all([](Engine& e) { return e.flush(); });
+}
+
+bool ShardedEngine::sync() {
+    return run_on_all([](Engine& e) { return e.sync(); });
+}
+
+bool ShardedEngine::compact() {
+    return run_on_all([](Engine& e) { return e.compact(); });
+}
+
+bool ShardedEngine::wait_for_compactions() {
+    return run_on_all([](Engine& e) { return e.wait_for_compactions(); });
+}
+
+bool ShardedEngine::put(const std::string& key, const std::string& value) {
+    return shards_[shard_of(key)]->put(key, value);
+}
+
+bool ShardedEngine::del(const std::string& key) {
+    return shards_[shard_of(key)]->del(key);
+}
+
+bool ShardedEngine::write(const WriteBatch& batch) {
+    if (batch.empty()) return true;
+    std::vector<WriteBatch> parts(shards_.size());
+    bool valid = WriteBatch::for_each(batch.rep(), [&](RecType type, std::string_view key,
+                                                       std::string_view value) {
+        WriteBatch& part = parts[shard_of(key)];
+        if (type == RecType::Put)
+            part.put(key, value);
+        else
+            part.del(key);
+    });
+    if (!valid) return false;
+
+    std::vector<size_t> touched;
+    for (size_t i = 0; i < parts.size(); ++i)
+        if (!parts[i].empty()) touched.push_back(i);
+    if (touched.size() == 1) return shards_[touched[0]]->write(parts[touched[0]]);
+    std::atomic<bool> ok{true};
+    run_on_shards(touched, [&](size_t i) {
+        if (!shards_[i]->write(parts[i])) ok.store(false);
+    });
+    return ok.load();
+}
+
+std::optional<std::string> ShardedEngine::get(const std::string& key) const {
+    return shards_[shard_of(key)]->get(key);
+}
+
+std::vector<std::optional<std::string>> ShardedEngine::multi_get(
+    std::span<const std::string_view> keys) const {
+    std::vector<std::optional<std::string>> out(keys.size());
+    // keys, and where their results go, per shard
+    std::vector<std::vector<std::string_view>> shard_keys(shards_.size());
+    std::vector<std::vector<size_t>> shard_pos(shards_.size());
+    for (size_t k = 0; k < keys.size(); ++k) {
+        const size_t i = shard_of(keys[k]);
+        shard_keys[i].push_back(keys[k]);
+        shard_pos[i].push_back(k);
+    }
+
+    std::vector<size_t> touched;
+    for (size_t i = 0; i < shards_.size(); ++i)
+        if (!shard_keys[i].empty()) touched.push_back(i);
+    auto lookup = [&](size_t i) {
+        auto results = shards_[i]->multi_get(shard_keys[i]);
+        for (size_t j = 0; j < results.size(); ++j) out[shard_pos[i][j]] = std::move(results[j]);
+    };
+    if (touched.size() == 1)
+        lookup(touched[0]);   // no hand-off for a single shard
+    else
+        run_on_shards(touched, lookup);
+    return out;
+}
+
+std::unique_ptr<Iterator> ShardedEngine::NewIterator(const ReadOptions& ro) const {
+    // A snapshot belongs to one shard's sequence numbers
+    if (ro.snapshot) return nullptr;
+    // Shards hold disjoint keys, so the merge never sees a key twice
+    std::vector<std::unique_ptr<Iterator>> children;
+    children.reserve(shards_.size());
+    for (const auto& s : shards_) children.push_back(s->NewIterator(ro));
+    return NewMergingIterator(std::move(children));
+}
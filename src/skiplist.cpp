@@ -0,0 +1,140 @@
+#include "skiplist.h"
+
+#include <new>
+#include <random>
+#include <thread>
+
+struct SkipList::Node {
+    Node(std::string_view k, const Value* v) : key_data(k.data()), key_size(k.size()), value(v) {}
+
+    const char* const key_data;  // in the arena
+    const size_t key_size;
+    std::atomic<const Value*> value;
+    // next_[0..height): allocated past the end of the struct by new_node
+    std::atomic<Node*> next_[1];
+
+    std::string_view key() const { return {key_data, key_size}; }
+    Node* next(int level) const { return next_[level].load(std::memory_order_acquire); }
+    void set_next_relaxed(int level, Node* n) { next_[level].store(n, std::memory_order_relaxed); }
+    bool cas_next(int level, Node* expected, Node* n) {
+        return next_[level].compare_exchange_strong(expected, n, std::memory_order_release,
+                                                    std::memory_order_relaxed);
+    }
+};
+
+SkipList::SkipList() : head_(new_node({}, kMaxHeight, nullptr)) {}
+
+// Nodes and values are trivially destructible; the arena frees them.
+SkipList::~SkipList() = default;
+
+SkipList::Node* SkipList::new_node(std::string_view key, int height, const Value* v) {
+    const size_t size = sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1);
+    char* mem = arena_.allocate(size, alignof(Node));
+    Node* n = new (mem) Node(std::string_view(arena_.copy(key.data(), key.size()), key.size()), v);
+    for (int l = 0; l < height; ++l) new (&n->next_[l]) std::atomic<Node*>(nullptr);
+    return n;
+}
+
+int SkipList::random_height() {
+    thread_local std::minstd_rand rng(
+        static_cast<unsigned>(std::hash<std::thread::id>{}(std::this_thread::get_id())));
+    int h = 1;
+    while (h < kMaxHeight && rng() % kBranching == 0) ++h;
+    return h;
+}
+
+void SkipList::replace(Node* n, Value* v) {
+    const Value* old = n->value.load(std::memory_order_acquire);
+    do {
+        v->prev = old;
+    } while (!n->value.compare_exchange_weak(old, v, std::memory_order_release, std::memory_order_acquire));
+}
+
+SkipList::Node* SkipList::find_greater_or_equal(std::string_view key) const {
+    Node* x = head_;
+    int level = max_height_.load(std::memory_order_relaxed) - 1;
+    for (;;) {
+        Node* n = x->next(level);
+        if (n && n->key() < key) {
+            x = n;
+        } else if (level == 0) {
+            return n;
+        } else {
+            --level;
+        }
+    }
+}
+
+void SkipList::find_splice_for_level(std::string_view key, int level, Node* before,
+                                     Node** out_prev, Node** out_next) {
+    for (;;) {
+        Node* n = before->next(level);
+        if (!n || key <= n->key()) {
+            *out_prev = before;
+            *out_next = n;
+            return;
+        }
+        before = n;
+    }
+}
+
+void SkipList::upsert(std::string_view key, RecType type, std::string_view value, SequenceNumber seq) {
+    auto* v = new (arena_.allocate(sizeof(Value), alignof(Value)))
+        Value{type, static_cast<uint32_t>(value.size()), nullptr, arena_.copy(value.data(), value.size()), seq};
+
+    // Splice at every level, top-down, each search starting from the
+    // predecessor found one level up.
+    Node* prev[kMaxHeight];
+    Node* next[kMaxHeight];
+    Node* before = head_;
+    for (int l = kMaxHeight - 1; l >= 0; --l) {
+        find_splice_for_level(key, l, before, &prev[l], &next[l]);
+        before = prev[l];
+    }
+    if (next[0] && next[0]->key() == key) {
+        replace(next[0], v);
+        return;
+    }
+
+    const int height = random_height();
+    int max_h = max_height_.load(std::memory_order_relaxed);
+    while (height > max_h && !max_height_.compare_exchange_weak(max_h, height, std::memory_order_relaxed)) {
+    }
+
+    Node* x = new_node(key, height, v);
+    for (int l = 0; l < height; ++l) {
+        for (;;) {
+            x->set_next_relaxed(l, next[l]);
+            if (prev[l]->cas_next(l, next[l], x)) break;
+            // Another writer linked a node here first; re-find this level.
+            find_splice_for_level(key, l, prev[l], &prev[l], &next[l]);
+            if (l == 0 && next[0] && next[0]->key() == key) {
+                // ... with the same key: x was never published (its arena
+                // space is simply not reused)
+                replace(next[0], v);
+                return;
+            }
+        }
+    }
+    size_.fetch_add(1, std::memory_order_relaxed);
+}
+
+const SkipList::Value* SkipList::find(std::string_view key, SequenceNumber snapshot) const {
+    Node* n = find_greater_or_equal(key);
+    if (!n || n->key() != key) return nullptr;
+    return visible(n->value.load(std::memory_order_acquire), snapshot);
+}
+
+// ---- Iter ----
+
+void SkipList::Iter::SeekToFirst() { node_ = list_->head_->next(0); }
+
+void SkipList::Iter::Seek(std::string_view target) { node_ = list_->find_greater_or_equal(target); }
+
+void SkipList::Iter::Next() { node_ = node_->next(0); }
+
+std::string_view SkipList::Iter::key() const { return node_->key(); }
+
+const SkipList::Value* SkipList::Iter::value() const {
+    return node_->value.load(std::memory_order_acquire);
+}
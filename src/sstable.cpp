@@ -2,6 +2,7 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -11,6 +12,10 @@
 #include <cstring>
 #include <filesystem>
 
+#include "block.h"
+#include "perf_context.h"
+#include "utils.h"
+
 using std::string;
 using std::string_view;
 using std::vector;
@@ -39,12 +44,21 @@ bool SSTable::read_all(int fd, void* p, size_t n) {
     }
     return true;
 }
-bool SSTable::write_u32(int fd, uint32_t v) { return write_all(fd, &v, sizeof(v)); }
-bool SSTable::write_u64(int fd, uint64_t v) { return write_all(fd, &v, sizeof(v)); }
-bool SSTable::write_u8(int fd, uint8_t v) { return write_all(fd, &v, sizeof(v)); }
+bool SSTable::pread_all(int fd, void* p, size_t n, uint64_t off) {
+    char* c = static_cast<char*>(p);
+    size_t left = n;
+    while (left) {
+        ssize_t r = ::pread(fd, c, left, (off_t)off);
+        perf_count(&PerfContext::read_syscalls);
+        if (r <= 0) return false;
+        c += r;
+        off += r;
+        left -= r;
+    }
+    return true;
+}
 bool SSTable::read_u32(int fd, uint32_t& v) { return read_all(fd, &v, sizeof(v)); }
 bool SSTable::read_u64(int fd, uint64_t& v) { return read_all(fd, &v, sizeof(v)); }
-bool SSTable::read_u8(int fd, uint8_t& v) { return read_all(fd, &v, sizeof(v)); }
 
 bool SSTable::fsync_dir(const string& dir) {
     int dfd = ::open(dir.c_str(), O_DIRECTORY | O_RDONLY);
@@ -65,131 +79,158 @@ string SSTable::tmp_name_for(const string& dir, uint64_t id) {
     return (fs::path(dir) / buf).string();
 }
 
-// ===== Build =====
-bool SSTable::Build(const string& dir, uint64_t file_id,
-                    const vector<std::pair<string, MemValue>>& entries,
-                    string* out_final_path) {
-    // basic preconditions
-    if (!entries.empty()) {
-        for (size_t i = 1; i < entries.size(); ++i) {
-            if (!(entries[i - 1].first < entries[i].first)) {
-                // must be strictly increasing keys
-                return false;
-            }
-        }
-    }
-    fs::create_directories(dir);
+// ===== SSTableBuilder =====
+namespace {
+constexpr size_t kWriteBufferSize = 64 * 1024;  // batch small blocks into fewer write()s
+}
 
-    string tmp = tmp_name_for(dir, file_id);
-    string fin = file_name_for(dir, file_id);
+SSTableBuilder::SSTableBuilder(string dir, uint64_t file_id, const SSTableOptions& opts)
+    : dir_(std::move(dir)),
+      file_id_(file_id),
+      opts_(opts),
+      data_block_(opts.block_restart_interval, /*with_seq=*/true),
+      index_block_(opts.block_restart_interval),
+      bloom_(opts.bloom_bits_per_key) {}
 
-    int fd = ::open(tmp.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
-    if (fd < 0) return false;
+SSTableBuilder::~SSTableBuilder() {
+    if (fd_ >= 0) abandon();
+}
 
-    // Header
-    if (!write_u32(fd, kMagic) || !write_u32(fd, kVersion)) {
-        ::close(fd);
-        return false;
+bool SSTableBuilder::open() {
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    tmp_path_ = SSTable::tmp_name_for(dir_, file_id_);
+    fd_ = ::open(tmp_path_.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd_ < 0) return false;
+    put_fixed32(&buf_, SSTable::kMagic);
+    put_fixed32(&buf_, SSTable::kVersionV3);
+    return true;
+}
+
+void SSTableBuilder::abandon() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+        ::unlink(tmp_path_.c_str());
     }
+}
 
-    vector<SSTIndexRec> sparse;
-    sparse.reserve(entries.size() / kIndexInterval + 4);
+bool SSTableBuilder::flush_buffer() {
+    if (buf_.empty()) return true;
+    if (!SSTable::write_all(fd_, buf_.data(), buf_.size())) return false;
+    written_ += buf_.size();
+    buf_.clear();
+    return true;
+}
 
-    // Data section
-    uint64_t data_start = ::lseek(fd, 0, SEEK_CUR);
-    (void)data_start;
-    for (size_t i = 0; i < entries.size(); ++i) {
-        const auto& k = entries[i].first;
-        const auto& mv = entries[i].second;
+bool SSTableBuilder::emit_block(string_view contents, uint64_t* off) {
+    *off = file_size();
+    buf_.append(contents.data(), contents.size());
+    put_fixed32(&buf_, compute_crc32(contents));
+    return buf_.size() < kWriteBufferSize || flush_buffer();
+}
 
-        // index every Kth entry
-        if (i % kIndexInterval == 0) {
-            uint64_t off = static_cast<uint64_t>(::lseek(fd, 0, SEEK_CUR));
-            sparse.push_back(SSTIndexRec{k, off});
-        }
+bool SSTableBuilder::finish_data_block() {
+    if (data_block_.empty()) return true;
+    string_view contents = data_block_.finish();
+    uint64_t off = 0;
+    if (!emit_block(contents, &off)) return false;
+    string handle;
+    put_varint64(&handle, off);
+    put_varint64(&handle, contents.size());
+    index_block_.add(data_block_.last_key(), RecType::Put, handle);
+    data_block_.reset();
+    return true;
+}
 
-        uint32_t klen = static_cast<uint32_t>(k.size());
-        uint8_t type = static_cast<uint8_t>(mv.type);
-        uint32_t vlen = (mv.type == RecType::Put) ? static_cast<uint32_t>(mv.value.size()) : 0;
+bool SSTableBuilder::add(string_view key, RecType type, string_view value, SequenceNumber seq) {
+    if (fd_ < 0) return false;
+    // (key ascending, seq descending), no duplicates
+    const bool same_key = num_entries_ > 0 && string_view(last_key_) == key;
+    if (num_entries_ > 0 && !(string_view(last_key_) < key) && !(same_key && seq < last_seq_)) return false;
+    last_key_.assign(key.data(), key.size());
+    last_seq_ = seq;
+
+    // tombstones go in too: a Del must still stop the newest->oldest search
+    if (type == RecType::ValueRef && !value_log_usage_.add(value)) return false;
+    if (opts_.bloom_bits_per_key > 0 && !same_key) bloom_.add(key);
+    data_block_.add(key, type, type == RecType::Del ? string_view{} : value, seq);
+    ++num_entries_;
+    if (data_block_.size_estimate() >= opts_.block_size) return finish_data_block();
+    return true;
+}
 
-        if (!write_u32(fd, klen)) {
-            ::close(fd);
-            return false;
-        }
-        if (!write_u8(fd, type)) {
-            ::close(fd);
-            return false;
-        }
-        if (!write_u32(fd, vlen)) {
-            ::close(fd);
-            return false;
-        }
-        if (!write_all(fd, k.data(), klen)) {
-            ::close(fd);
-            return false;
-        }
-        if (vlen && !write_all(fd, mv.value.data(), vlen)) {
-            ::close(fd);
-            return false;
-        }
-    }
+bool SSTableBuilder::finish(string* out_final_path) {
+    if (fd_ < 0) return false;
+    bool ok = finish_data_block();
 
-    // Record where index starts
-    uint64_t index_offset = static_cast<uint64_t>(::lseek(fd, 0, SEEK_CUR));
+    uint64_t index_off = 0;
+    string_view index = index_block_.finish();
+    ok = ok && emit_block(index, &index_off);
 
-    // Write sparse index
-    for (const auto& rec : sparse) {
-        uint32_t klen = static_cast<uint32_t>(rec.key.size());
-        if (!write_u32(fd, klen)) {
-            ::close(fd);
-            return false;
-        }
-        if (!write_all(fd, rec.key.data(), klen)) {
-            ::close(fd);
-            return false;
-        }
-        if (!write_u64(fd, rec.offset)) {
-            ::close(fd);
-            return false;
-        }
-    }
+    string filter;
+    if (opts_.bloom_bits_per_key > 0 && bloom_.num_keys() > 0) filter = bloom_.finish();
+    uint64_t filter_off = file_size();
+    if (ok && !filter.empty()) ok = emit_block(filter, &filter_off);
 
     // Footer
-    uint32_t index_count = static_cast<uint32_t>(sparse.size());
-    if (!write_u64(fd, index_offset)) {
-        ::close(fd);
-        return false;
-    }
-    if (!write_u32(fd, index_count)) {
-        ::close(fd);
-        return false;
-    }
-    if (!write_u32(fd, kMagic)) {
-        ::close(fd);
-        return false;
-    }
-    if (!write_u32(fd, kVersion)) {
-        ::close(fd);
-        return false;
-    }
-
-    if (::fsync(fd) != 0) {
-        ::close(fd);
+    put_fixed64(&buf_, index_off);
+    put_fixed32(&buf_, static_cast<uint32_t>(index.size()));
+    put_fixed64(&buf_, filter_off);
+    put_fixed32(&buf_, static_cast<uint32_t>(filter.size()));
+    put_fixed64(&buf_, num_entries_);
+    put_fixed32(&buf_, SSTable::kMagic);
+    put_fixed32(&buf_, SSTable::kVersionV3);
+
+    ok = ok && flush_buffer() && ::fsync(fd_) == 0;
+    if (!ok) {
+        abandon();
         return false;
     }
-    ::close(fd);
+    ::close(fd_);
+    fd_ = -1;
 
     // durable rename
-    if (!fsync_dir(dir)) return false;
-    if (::rename(tmp.c_str(), fin.c_str()) != 0) return false;
-    if (!fsync_dir(dir)) return false;
+    string fin = SSTable::file_name_for(dir_, file_id_);
+    if (!SSTable::fsync_dir(dir_)) return false;
+    if (::rename(tmp_path_.c_str(), fin.c_str()) != 0) return false;
+    if (!SSTable::fsync_dir(dir_)) return false;
 
     if (out_final_path) *out_final_path = fin;
     return true;
 }
 
+// ===== Build =====
+bool SSTable::Build(const string& dir, uint64_t file_id,
+                    const vector<std::pair<string, MemValue>>& entries,
+                    string* out_final_path, const SSTableOptions& opts) {
+    SSTableBuilder b(dir, file_id, opts);
+    if (!b.open()) return false;
+    for (const auto& [k, mv] : entries) {
+        if (!b.add(k, mv.type, mv.value, mv.seq)) return false;  // ~SSTableBuilder drops the tmp file
+    }
+    return b.finish(out_final_path);
+}
+
 // ===== Open =====
-bool SSTable::Open(const string& path) {
+SSTable::~SSTable() {
+    release();
+    if (obsolete_.load()) ::unlink(path_.c_str());
+}
+
+bool SSTable::Open(const string& path, const SSTableOptions& opts) {
+    return open_file(path, opts) && load_key_range();
+}
+
+bool SSTable::Open(const string& path, const SSTableOptions& opts, string smallest, string largest) {
+    if (!open_file(path, opts)) return false;
+    smallest_ = std::move(smallest);
+    largest_ = std::move(largest);
+    return true;
+}
+
+bool SSTable::open_file(const string& path, const SSTableOptions& opts) {
+    release();
     path_ = path;
     // extract file_id from name if it looks like NNNNNN.sst
     try {
@@ -202,34 +243,116 @@ bool SSTable::Open(const string& path) {
     int fd = ::open(path.c_str(), O_RDONLY);
     if (fd < 0) return false;
 
-    uint64_t index_off = 0;
-    uint32_t index_cnt = 0;
-    bool ok = read_footer(fd, index_off, index_cnt);
+    Footer footer;
+    bool ok = read_footer(fd, footer);
     if (!ok) {
         ::close(fd);
         return false;
     }
-
-    ok = load_index(fd, index_off, index_cnt);
-    ::close(fd);
+    version_ = footer.version;
+    num_entries_ = footer.num_entries;
+    verify_checksums_ = opts.verify_checksums;
+    filter_stats_ = opts.filter_stats;
+    cache_ = opts.block_cache;
+
+    if (version_ >= kVersionV2)
+        ok = load_index_block(fd, footer.index_offset, footer.index_size);
+    else
+        ok = load_index(fd, footer.index_offset, footer.index_count);
+    data_end_ = footer.index_offset;
+    if (ok) ok = load_filter(fd, footer.filter_offset, footer.filter_size);
+    struct stat st;
+    if (ok) ok = ::fstat(fd, &st) == 0;
+    if (ok) file_size_ = static_cast<uint64_t>(st.st_size);
+    if (ok && opts.read_mode == SSTReadMode::Mmap) ok = map_file(fd);
+
+    if (ok && opts.read_mode == SSTReadMode::Syscall) {
+        fd_ = fd;
+    } else {
+        ::close(fd);
+    }
     return ok;
 }
 
-bool SSTable::read_footer(int fd, uint64_t& index_off, uint32_t& index_count) const {
-    off_t end = ::lseek(fd, 0, SEEK_END);
-    if (end < (off_t)(sizeof(uint64_t) + 3 * sizeof(uint32_t))) return false;
-    off_t footer_start = end - (off_t)(sizeof(uint64_t) + 3 * sizeof(uint32_t));
-    if (::lseek(fd, footer_start, SEEK_SET) < 0) return false;
-
-    uint32_t magic = 0, ver = 0;
-    if (!read_u64(fd, index_off)) return false;
-    if (!read_u32(fd, index_count)) return false;
-    if (!read_u32(fd, magic)) return false;
-    if (!read_u32(fd, ver)) return false;
-    if (magic != kMagic || ver != kVersion) return false;
+bool SSTable::load_key_range() {
+    smallest_.clear();
+    largest_.clear();
+    if (index_.empty()) return true;
+    SSTableIterator it(this, /*fill_cache=*/false);
+    it.SeekToFirst();
+    if (!it.Valid()) return it.ok();
+    smallest_.assign(it.key());
+    if (version_ >= kVersionV2) {
+        largest_ = index_.back().key;
+        return true;
+    }
+    // V0/V1 index keys are interval starts: walk the last interval
+    for (it.Seek(index_.back().key); it.Valid(); it.Next()) largest_.assign(it.key());
+    return it.ok();
+}
+
+bool SSTable::map_file(int fd) {
+    struct stat st;
+    if (::fstat(fd, &st) != 0) return false;
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size == 0) return false;
+    void* p = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) return false;
+    // Point lookups touch one block / index interval each; kernel readahead
+    // would mostly pull in pages we never look at.
+    ::madvise(p, size, MADV_RANDOM);
+    map_ = static_cast<const char*>(p);
+    map_size_ = size;
     return true;
 }
 
+void SSTable::release() {
+    if (map_) ::munmap(const_cast<char*>(map_), map_size_);
+    map_ = nullptr;
+    map_size_ = 0;
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+}
+
+bool SSTable::read_footer(int fd, Footer& f) const {
+    // magic + version are always the last 8 bytes; they decide the footer size
+    off_t end = ::lseek(fd, 0, SEEK_END);
+    if (end < (off_t)kFooterSizeV0) return false;
+    if (::lseek(fd, end - (off_t)(2 * sizeof(uint32_t)), SEEK_SET) < 0) return false;
+    uint32_t magic = 0;
+    if (!read_u32(fd, magic) || !read_u32(fd, f.version)) return false;
+    if (magic != kMagic) return false;
+
+    if (f.version == kVersionV0) {
+        if (::lseek(fd, end - (off_t)kFooterSizeV0, SEEK_SET) < 0) return false;
+        if (!read_u64(fd, f.index_offset)) return false;
+        if (!read_u32(fd, f.index_count)) return false;
+        f.filter_offset = f.index_offset;
+        f.filter_size = 0;
+    } else if (f.version == kVersionV1) {
+        if (end < (off_t)kFooterSizeV1) return false;
+        if (::lseek(fd, end - (off_t)kFooterSizeV1, SEEK_SET) < 0) return false;
+        if (!read_u64(fd, f.index_offset)) return false;
+        if (!read_u32(fd, f.index_count)) return false;
+        if (!read_u64(fd, f.filter_offset)) return false;
+        if (!read_u32(fd, f.filter_size)) return false;
+        if (f.filter_offset + f.filter_size > (uint64_t)end) return false;
+    } else if (f.version == kVersionV2 || f.version == kVersionV3) {
+        if (end < (off_t)kFooterSizeV2) return false;
+        if (::lseek(fd, end - (off_t)kFooterSizeV2, SEEK_SET) < 0) return false;
+        if (!read_u64(fd, f.index_offset)) return false;
+        if (!read_u32(fd, f.index_size)) return false;
+        if (!read_u64(fd, f.filter_offset)) return false;
+        if (!read_u32(fd, f.filter_size)) return false;
+        if (!read_u64(fd, f.num_entries)) return false;
+        if (f.index_offset + f.index_size + kBlockTrailerSize > (uint64_t)end) return false;
+        if (f.filter_size && f.filter_offset + f.filter_size + kBlockTrailerSize > (uint64_t)end) return false;
+    } else {
+        return false;
+    }
+    return f.index_offset <= (uint64_t)end;
+}
+
 bool SSTable::load_index(int fd, uint64_t index_off, uint32_t index_count) {
     if (::lseek(fd, (off_t)index_off, SEEK_SET) < 0) return false;
     index_.clear();
@@ -246,88 +369,371 @@ bool SSTable::load_index(int fd, uint64_t index_off, uint32_t index_count) {
     return true;
 }
 
-// Binary search helper: find greatest index key <= target; return its offset.
-// If none, return offset of first data entry (just after header).
-static uint64_t index_seek_offset(const vector<SSTIndexRec>& idx, string_view key) {
-    if (idx.empty()) return sizeof(uint32_t) * 2;  // header size (magic, version)
+// Read a block plus its crc32 trailer and verify it.
+static bool read_checked(int fd, uint64_t off, uint32_t size, std::string* out) {
+    out->assign(size + sizeof(uint32_t), '\0');
+    if (::pread(fd, out->data(), out->size(), (off_t)off) != (ssize_t)out->size()) return false;
+    uint32_t crc = decode_fixed32(out->data() + size);
+    out->resize(size);
+    return compute_crc32(*out) == crc;
+}
+
+bool SSTable::load_index_block(int fd, uint64_t index_off, uint32_t index_size) {
+    std::string contents;
+    if (!read_checked(fd, index_off, index_size, &contents)) return false;
+    index_.clear();
+    BlockIter it(contents);
+    for (it.SeekToFirst(); it.Valid(); it.Next()) {
+        uint64_t off = 0, size = 0;
+        const char* p = it.value().data();
+        const char* limit = p + it.value().size();
+        if (!(p = get_varint64(p, limit, &off)) || !get_varint64(p, limit, &size)) return false;
+        if (off + size > index_off) return false;
+        index_.push_back(SSTIndexRec{std::string(it.key()), off, size});
+    }
+    return it.ok();
+}
+
+bool SSTable::load_filter(int fd, uint64_t filter_off, uint32_t filter_size) {
+    filter_ = BloomFilter{};
+    if (filter_size == 0) return true;
+    std::string buf;
+    if (version_ >= kVersionV2) {
+        if (!read_checked(fd, filter_off, filter_size, &buf)) return false;
+    } else {
+        buf.assign(filter_size, '\0');
+        if (!pread_all(fd, buf.data(), buf.size(), filter_off)) return false;
+    }
+    return filter_.load(buf);
+}
+
+// ===== Lookup =====
+bool SSTable::read_region(uint64_t off, uint64_t n, size_t trailer,
+                          BlockCache::Handle* holder, string_view* out, bool fill_cache) const {
+    PerfTimer timer(&PerfContext::block_read_nanos);
+    perf_count(&PerfContext::block_reads);
+    perf_count(&PerfContext::bytes_read, n);
+    const bool check = verify_checksums_ && trailer == kBlockTrailerSize;
+    if (map_) {
+        if (off + n + trailer > map_size_) return false;
+        *out = string_view(map_ + off, n);
+        return !check || compute_crc32(*out) == decode_fixed32(map_ + off + n);
+    }
+
+    if (cache_ && (*holder = cache_->lookup(file_id_, off))) {
+        perf_count(&PerfContext::block_cache_hits);
+        *out = **holder;  // checksum (if enabled) was checked before insert
+        return true;
+    }
+    std::string buf(n + trailer, '\0');
+    if (!pread_all(fd_, buf.data(), buf.size(), off)) return false;
+    if (check && compute_crc32(string_view(buf.data(), n)) != decode_fixed32(buf.data() + n)) return false;
+    buf.resize(n);
+    if (cache_ && fill_cache)
+        *holder = cache_->insert(file_id_, off, std::move(buf));
+    else
+        *holder = std::make_shared<const std::string>(std::move(buf));
+    *out = **holder;
+    return true;
+}
+
+bool SSTable::read_block(const SSTIndexRec& h, BlockCache::Handle* holder, string_view* out,
+                         bool fill_cache) const {
+    return read_region(h.offset, h.size, kBlockTrailerSize, holder, out, fill_cache);
+}
+
+// V0/V1 binary search: locate the index interval that may hold `key`, i.e.
+// [greatest index key <= key, next index key). False if key sorts before the
+// first entry of the table.
+static bool index_seek_offset(const vector<SSTIndexRec>& idx, uint64_t data_end, string_view key,
+                              uint64_t* start, uint64_t* end) {
     size_t lo = 0, hi = idx.size();
     while (lo < hi) {
         size_t mid = (lo + hi) / 2;
+        perf_count(&PerfContext::index_comparisons);
         if (idx[mid].key <= key)
             lo = mid + 1;
         else
             hi = mid;
     }
-    if (hi == 0) return sizeof(uint32_t) * 2;
-    return idx[hi - 1].offset;
+    if (hi == 0) return false;
+    *start = idx[hi - 1].offset;
+    *end = hi < idx.size() ? idx[hi].offset : data_end;
+    return *start <= *end;
 }
 
-// Scan forward from offset to find key.
+// Walk V0 records (u32 klen | u8 type | u32 vlen | key | value) in `region`.
 SSTable::ScanResult
-SSTable::scan_for_key(int fd, uint64_t start_off, string_view key, string* out) const {
-    if (::lseek(fd, (off_t)start_off, SEEK_SET) < 0) return ScanResult::Absent;
-
-    while (true) {
-        uint32_t klen = 0, vlen = 0;
-        uint8_t type = 0;
-        // Try to read key_len; if EOF, stop.
-        uint8_t peekbuf[4];
-        ssize_t g = ::read(fd, peekbuf, sizeof(uint32_t));
-        if (g == 0) return ScanResult::Absent;
-        if (g != (ssize_t)sizeof(uint32_t)) return ScanResult::Absent;
-        // we consumed 4 bytes; put them into klen
-        std::memcpy(&klen, peekbuf, sizeof(uint32_t));
-
-        if (!read_u8(fd, type)) return ScanResult::Absent;
-        if (!read_u32(fd, vlen)) return ScanResult::Absent;
-
-        std::string k(klen, '\0');
-        if (!read_all(fd, k.data(), klen)) return ScanResult::Absent;
-
-        if (k > key) return ScanResult::Absent;  // we've passed the target; not found here
-
-        if ((RecType)type == RecType::Put) {
-            std::string v(vlen, '\0');
-            if (!read_all(fd, v.data(), vlen)) return ScanResult::Absent;
-            if (k == key) {
-                if (out) *out = std::move(v);
-                return ScanResult::Put;
-            }
-        } else {  // Del
-            // value_len should be 0; skip if not
-            if (vlen) {
-                if (::lseek(fd, vlen, SEEK_CUR) < 0) return ScanResult::Absent;
-            }
-            if (k == key) return ScanResult::Del;
+SSTable::scan_records(string_view region, string_view key, string* out) const {
+    constexpr size_t kHdr = sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t);
+    const char* p = region.data();
+    const char* end = p + region.size();
+    while (static_cast<size_t>(end - p) >= kHdr) {
+        uint32_t klen = decode_fixed32(p);
+        uint8_t type = static_cast<uint8_t>(p[sizeof(uint32_t)]);
+        uint32_t vlen = decode_fixed32(p + sizeof(uint32_t) + sizeof(uint8_t));
+        if (static_cast<uint64_t>(end - p) < kHdr + uint64_t(klen) + vlen) return ScanResult::Absent;  // corrupt
+
+        string_view k(p + kHdr, klen);
+        perf_count(&PerfContext::entries_scanned);
+        int c = k.compare(key);
+        if (c > 0) return ScanResult::Absent;  // we've passed the target; not found here
+        if (c == 0) {
+            if ((RecType)type != RecType::Put) return ScanResult::Del;
+            if (out) out->assign(p + kHdr + klen, vlen);
+            return ScanResult::Put;
         }
-        // else continue loop
+        p += kHdr + klen + vlen;
     }
+    return ScanResult::Absent;
 }
 
-std::optional<std::string> SSTable::Get(string_view key) const {
-    int fd = ::open(path_.c_str(), O_RDONLY);
-    if (fd < 0) return std::nullopt;
+SSTable::ScanResult SSTable::lookup_v0(string_view key, string* out, LastRegion* last) const {
+    uint64_t start = 0, end = 0;
+    {
+        PerfTimer timer(&PerfContext::index_seek_nanos);
+        if (!index_seek_offset(index_, data_end_, key, &start, &end)) return ScanResult::Absent;
+    }
+    if (last->offset != start) {
+        last->offset = UINT64_MAX;
+        if (!read_region(start, end - start, 0, &last->holder, &last->contents)) return ScanResult::Absent;
+        last->offset = start;
+        last->bytes += end - start;
+    }
+    PerfTimer timer(&PerfContext::block_seek_nanos);
+    return scan_records(last->contents, key, out);
+}
 
-    uint64_t off = index_seek_offset(index_, key);
-    std::string out;
-    ScanResult r = scan_for_key(fd, off, key, &out);
-    ::close(fd);
+SSTable::ScanResult SSTable::lookup_v2(string_view key, string* out, LastRegion* last,
+                                      SequenceNumber snapshot) const {
+    // first block whose last key is >= key
+    std::vector<SSTIndexRec>::const_iterator it;
+    {
+        PerfTimer timer(&PerfContext::index_seek_nanos);
+        it = std::lower_bound(index_.begin(), index_.end(), key, [](const SSTIndexRec& r, string_view k) {
+            perf_count(&PerfContext::index_comparisons);
+            return r.key < k;
+        });
+    }
+    for (bool first = true; it != index_.end(); ++it, first = false) {
+        if (last->offset != it->offset) {
+            last->offset = UINT64_MAX;
+            if (!read_block(*it, &last->holder, &last->contents)) return ScanResult::Absent;
+            last->offset = it->offset;
+            last->bytes += it->size;
+        }
+        PerfTimer timer(&PerfContext::block_seek_nanos);
+        BlockIter bi(last->contents, has_seq());
+        if (first)
+            bi.Seek(key);
+        else
+            bi.SeekToFirst();
+        // versions too new for the snapshot; they may run on into the next block
+        while (bi.Valid() && bi.key() == key && bi.seq() > snapshot) {
+            perf_count(&PerfContext::entries_scanned);
+            bi.Next();
+        }
+        if (!bi.Valid()) {
+            if (!bi.ok()) return ScanResult::Absent;
+            continue;
+        }
+        if (bi.key() != key) return ScanResult::Absent;
+        if (bi.type() == RecType::Del) return ScanResult::Del;
+        if (out) out->assign(bi.value().data(), bi.value().size());
+        return bi.type() == RecType::ValueRef ? ScanResult::ValueRef : ScanResult::Put;
+    }
+    return ScanResult::Absent;
+}
+
+SSTable::ScanResult SSTable::lookup(string_view key, string* out, LastRegion* last,
+                                    SequenceNumber snapshot) const {
+    probes_.fetch_add(1, std::memory_order_relaxed);
+    perf_count(&PerfContext::tables_probed);
+    const bool filtered = !filter_.empty();
+    if (filtered) {
+        PerfTimer timer(&PerfContext::index_seek_nanos);
+        perf_count(&PerfContext::bloom_checks);
+        if (!filter_.may_contain(key)) {
+            perf_count(&PerfContext::bloom_negatives);
+            if (filter_stats_) filter_stats_->useful.fetch_add(1, std::memory_order_relaxed);
+            return ScanResult::Absent;
+        }
+    }
+
+    // V0/V1 entries are all seq 0, visible to every snapshot
+    ScanResult r = version_ >= kVersionV2 ? lookup_v2(key, out, last, snapshot) : lookup_v0(key, out, last);
 
+    if (filtered && filter_stats_) {
+        filter_stats_->positive.fetch_add(1, std::memory_order_relaxed);
+        if (r == ScanResult::Absent) filter_stats_->false_positive.fetch_add(1, std::memory_order_relaxed);
+    }
+    return r;
+}
+
+std::optional<std::string> SSTable::Get(string_view key) const {
+    std::string out;
+    LastRegion last;
+    ScanResult r = lookup(key, &out, &last, kMaxSequence);
     if (r == ScanResult::Put) return out;
     return std::nullopt;  // Del or Absent => not found
 }
 
-SSTable::ProbeKind SSTable::Probe(std::string_view key, std::string* out) const {
-    int fd = ::open(path_.c_str(), O_RDONLY);
-    if (fd < 0) return ProbeKind::Absent;
-    uint64_t off = index_seek_offset(index_, key);
-    std::string tmp;
-    ScanResult r = scan_for_key(fd, off, key, &tmp);
-    ::close(fd);
-    if (r == ScanResult::Put) {
-        if (out) *out = std::move(tmp);
-        return ProbeKind::Put;
-    }
+SSTable::ProbeKind SSTable::probe_kind(ScanResult r) {
+    if (r == ScanResult::Put) return ProbeKind::Put;
     if (r == ScanResult::Del) return ProbeKind::Tombstone;
+    if (r == ScanResult::ValueRef) return ProbeKind::ValueRef;
     return ProbeKind::Absent;
 }
+
+SSTable::ProbeKind SSTable::Probe(std::string_view key, std::string* out, SequenceNumber snapshot,
+                                  uint64_t* bytes_read) const {
+    LastRegion last;
+    ScanResult r = lookup(key, out, &last, snapshot);
+    if (bytes_read) *bytes_read += last.bytes;
+    return probe_kind(r);
+}
+
+void SSTable::MultiProbe(std::span<const std::string_view> keys, std::vector<ProbeKind>* kinds,
+                         std::vector<std::string>* outs, SequenceNumber snapshot, uint64_t* bytes_read) const {
+    kinds->assign(keys.size(), ProbeKind::Absent);
+    outs->resize(keys.size());
+    LastRegion last;  // sorted keys: neighbours usually share it
+    for (size_t i = 0; i < keys.size(); ++i)
+        (*kinds)[i] = probe_kind(lookup(keys[i], &(*outs)[i], &last, snapshot));
+    if (bytes_read) *bytes_read += last.bytes;
+}
+
+// ===== Iterator =====
+// Walks the table one region at a time: a V2 data block (decoded with
+// BlockIter) or a V0/V1 index interval (decoded record by record).
+SSTableIterator::SSTableIterator(const SSTable* t, bool fill_cache, std::string upper_bound)
+    : t_(t), fill_cache_(fill_cache), upper_(std::move(upper_bound)), v2_(t->version_ >= SSTable::kVersionV2) {}
+
+bool SSTableIterator::load(size_t i) {
+    holder_.reset();
+    valid_ = false;
+    block_ = i;
+    if (i >= t_->index_.size()) return false;
+
+    const SSTIndexRec& rec = t_->index_[i];
+    if (v2_) {
+        if (!t_->read_block(rec, &holder_, &region_, fill_cache_)) return fail();
+        bi_ = BlockIter(region_, t_->has_seq());
+        if (!bi_.ok()) return fail();
+    } else {
+        uint64_t end = i + 1 < t_->index_.size() ? t_->index_[i + 1].offset : t_->data_end_;
+        if (end < rec.offset) return fail();
+        if (!t_->read_region(rec.offset, end - rec.offset, 0, &holder_, &region_, fill_cache_)) return fail();
+        next_ = region_.data();
+    }
+    return true;
+}
+
+bool SSTableIterator::fail() {
+    ok_ = false;
+    valid_ = false;
+    block_ = t_->index_.size();
+    return false;
+}
+
+// V2 index keys bound their block from above, V0/V1 ones start the next
+// interval: either way the index alone says whether to stop.
+bool SSTableIterator::past_upper_bound(size_t i) const {
+    if (upper_.empty()) return false;
+    const auto& idx = t_->index_;
+    if (v2_) return i < idx.size() && string_view(idx[i].key) >= upper_;
+    return i + 1 < idx.size() && string_view(idx[i + 1].key) >= upper_;
+}
+
+// V0 record at next_: u32 klen | u8 type | u32 vlen | key | value
+bool SSTableIterator::parse_v0() {
+    constexpr size_t kHdr = sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t);
+    const char* end = region_.data() + region_.size();
+    if (next_ >= end) return valid_ = false;
+    if (static_cast<size_t>(end - next_) < kHdr) return fail();
+    uint32_t klen = decode_fixed32(next_);
+    uint8_t type = static_cast<uint8_t>(next_[sizeof(uint32_t)]);
+    uint32_t vlen = decode_fixed32(next_ + sizeof(uint32_t) + sizeof(uint8_t));
+    if (static_cast<uint64_t>(end - next_) < kHdr + uint64_t(klen) + vlen) return fail();
+    key_ = string_view(next_ + kHdr, klen);
+    type_ = static_cast<RecType>(type);
+    value_ = type_ == RecType::Put ? string_view(next_ + kHdr + klen, vlen) : string_view{};
+    next_ += kHdr + klen + vlen;
+    return valid_ = true;
+}
+
+// Current region exhausted (or empty): move on to the first entry of the next one.
+void SSTableIterator::skip_forward() {
+    while (!valid_ && ok_ && block_ < t_->index_.size()) {
+        if (v2_ && !bi_.ok()) {
+            fail();
+            return;
+        }
+        if (past_upper_bound(block_)) {
+            holder_.reset();
+            block_ = t_->index_.size();
+            return;
+        }
+        if (!load(block_ + 1)) return;
+        if (v2_) {
+            bi_.SeekToFirst();
+            valid_ = bi_.Valid();
+        } else {
+            parse_v0();
+        }
+    }
+}
+
+void SSTableIterator::SeekToFirst() {
+    ok_ = true;
+    if (!load(0)) return;
+    if (v2_) {
+        bi_.SeekToFirst();
+        valid_ = bi_.Valid();
+    } else {
+        parse_v0();
+    }
+    skip_forward();
+}
+
+void SSTableIterator::Seek(string_view target) {
+    ok_ = true;
+    const auto& idx = t_->index_;
+    if (v2_) {
+        // first block whose last key is >= target
+        auto it = std::lower_bound(idx.begin(), idx.end(), target,
+                                   [](const SSTIndexRec& r, string_view k) { return r.key < k; });
+        if (!load(static_cast<size_t>(it - idx.begin()))) return;
+        bi_.Seek(target);
+        valid_ = bi_.Valid();
+    } else {
+        // last interval starting at or before target
+        auto it = std::upper_bound(idx.begin(), idx.end(), target,
+                                   [](string_view k, const SSTIndexRec& r) { return k < r.key; });
+        size_t i = it == idx.begin() ? 0 : static_cast<size_t>(it - idx.begin()) - 1;
+        if (!load(i)) return;
+        while (parse_v0() && key_ < target) {
+        }
+    }
+    skip_forward();
+}
+
+void SSTableIterator::Next() {
+    if (!valid_) return;
+    if (v2_) {
+        bi_.Next();
+        valid_ = bi_.Valid();
+    } else {
+        parse_v0();
+    }
+    skip_forward();
+}
+
+string_view SSTableIterator::key() const { return v2_ ? bi_.key() : key_; }
+string_view SSTableIterator::value() const { return v2_ ? bi_.value() : value_; }
+RecType SSTableIterator::type() const { return v2_ ? bi_.type() : type_; }
+SequenceNumber SSTableIterator::seq() const { return v2_ ? bi_.seq() : 0; }
+
+std::unique_ptr<Iterator> SSTable::NewIterator(bool fill_cache, std::string upper_bound) const {
+    return std::make_unique<SSTableIterator>(this, fill_cache, std::move(upper_bound));
+}
@@ -0,0 +1,200 @@
+#include "statistics.h"
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+
+static const char* const kTickerNames[] = {
+    "get.calls",
+    "get.found",
+    "get.memtable_hits",
+    "multiget.calls",
+    "multiget.keys",
+    "put.calls",
+    "del.calls",
+    "write.calls",
+    "bytes.written",
+    "table.probes",
+    "table.bytes_read",
+    "wal.bytes",
+    "wal.syncs",
+    "flush.count",
+    "flush.bytes",
+    "compaction.count",
+    "compaction.bytes_read",
+    "compaction.bytes_written",
+    "vlog.bytes_written",
+    "vlog.bytes_read",
+    "vlog.gc.count",
+    "vlog.gc.bytes",
+};
+static_assert(std::size(kTickerNames) == static_cast<size_t>(Ticker::kCount));
+
+static const char* const kHistogramNames[] = {
+    "get.nanos",
+    "multiget.nanos",
+    "put.nanos",
+    "del.nanos",
+    "write.nanos",
+    "flush.nanos",
+    "compaction.nanos",
+    "wal.sync.nanos",
+    "get.tables",
+    "get.bytes",
+};
+static_assert(std::size(kHistogramNames) == static_cast<size_t>(Histogram::kCount));
+
+const char* ticker_name(Ticker t) { return kTickerNames[static_cast<size_t>(t)]; }
+const char* histogram_name(Histogram h) { return kHistogramNames[static_cast<size_t>(h)]; }
+
+// Bucket b >= 16 covers [(8 + sub) << (e - 3), (9 + sub) << (e - 3)) for
+// e = 4 + (b - 16) / 8, sub = (b - 16) % 8: the top four bits of the value.
+size_t Statistics::bucket_of(uint64_t v) {
+    if (v < 16) return static_cast<size_t>(v);
+    const int e = 63 - std::countl_zero(v);
+    const size_t sub = (v >> (e - 3)) & (kSubBuckets - 1);
+    return 16 + static_cast<size_t>(e - 4) * kSubBuckets + sub;
+}
+
+uint64_t Statistics::bucket_floor(size_t b) {
+    if (b < 16) return b;
+    const size_t e = 4 + (b - 16) / kSubBuckets;
+    const uint64_t sub = (b - 16) % kSubBuckets;
+    return (kSubBuckets + sub) << (e - 3);
+}
+
+double HistogramData::percentile(double p) const {
+    if (count == 0) return 0;
+    const double rank = std::clamp(p, 0.0, 100.0) / 100.0 * static_cast<double>(count);
+    double seen = 0;
+    for (size_t b = 0; b < buckets.size(); ++b) {
+        if (buckets[b] == 0) continue;
+        const double in = static_cast<double>(buckets[b]);
+        if (seen + in >= rank) {
+            // spread the bucket's samples evenly over its range, within [min, max]
+            const double lo = std::max<double>(static_cast<double>(Statistics::bucket_floor(b)), static_cast<double>(min));
+            const double hi = b + 1 < Statistics::kBuckets
+                                  ? std::min<double>(static_cast<double>(Statistics::bucket_floor(b + 1)), static_cast<double>(max))
+                                  : static_cast<double>(max);
+            return lo + (hi - lo) * ((rank - seen) / in);
+        }
+        seen += in;
+    }
+    return static_cast<double>(max);
+}
+
+Statistics::Stripe& Statistics::stripe() {
+    // threads take stripes round robin, for good
+    static std::atomic<size_t> next{0};
+    thread_local const size_t index = next.fetch_add(1, std::memory_order_relaxed) % kStripes;
+    return stripes_[index];
+}
+
+void Statistics::record(Histogram h, uint64_t v) {
+    Hist& x = stripe().hists[static_cast<size_t>(h)];
+    x.count.fetch_add(1, std::memory_order_relaxed);
+    x.sum.fetch_add(v, std::memory_order_relaxed);
+    x.buckets[bucket_of(v)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t cur = x.min.load(std::memory_order_relaxed);
+    while (v < cur && !x.min.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+    cur = x.max.load(std::memory_order_relaxed);
+    while (v > cur && !x.max.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+}
+
+uint64_t Statistics::ticker(Ticker t) const {
+    uint64_t n = 0;
+    for (const auto& s : stripes_) n += s.tickers[static_cast<size_t>(t)].load(std::memory_order_relaxed);
+    return n;
+}
+
+HistogramData Statistics::histogram(Histogram h) const {
+    HistogramData d;
+    d.buckets.assign(kBuckets, 0);
+    uint64_t min = UINT64_MAX;
+    for (const auto& s : stripes_) {
+        const Hist& x = s.hists[static_cast<size_t>(h)];
+        d.count += x.count.load(std::memory_order_relaxed);
+        d.sum += x.sum.load(std::memory_order_relaxed);
+        min = std::min(min, x.min.load(std::memory_order_relaxed));
+        d.max = std::max(d.max, x.max.load(std::memory_order_relaxed));
+        for (size_t b = 0; b < kBuckets; ++b) d.buckets[b] += x.buckets[b].load(std::memory_order_relaxed);
+    }
+    d.min = d.count ? min : 0;
+    return d;
+}
+
+void Statistics::reset() {
+    for (auto& s : stripes_) {
+        for (auto& t : s.tickers) t.store(0, std::memory_order_relaxed);
+        for (auto& x : s.hists) {
+            x.count.store(0, std::memory_order_relaxed);
+            x.sum.store(0, std::memory_order_relaxed);
+            x.min.store(UINT64_MAX, std::memory_order_relaxed);
+            x.max.store(0, std::memory_order_relaxed);
+            for (auto& b : x.buckets) b.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+static double ratio(uint64_t a, uint64_t b) { return b ? static_cast<double>(a) / static_cast<double>(b) : 0; }
+
+std::string Statistics::to_string() const {
+    std::string out;
+    char line[256];
+    for (size_t i = 0; i < static_cast<size_t>(Ticker::kCount); ++i) {
+        std::snprintf(line, sizeof(line), "%-26s %llu\n", kTickerNames[i],
+                      static_cast<unsigned long long>(ticker(static_cast<Ticker>(i))));
+        out += line;
+    }
+    for (size_t i = 0; i < static_cast<size_t>(Histogram::kCount); ++i) {
+        const HistogramData d = histogram(static_cast<Histogram>(i));
+        std::snprintf(line, sizeof(line),
+                      "%-26s count=%llu avg=%.1f p50=%.1f p99=%.1f p99.9=%.1f max=%llu\n",
+                      kHistogramNames[i], static_cast<unsigned long long>(d.count), d.average(),
+                      d.percentile(50), d.percentile(99), d.percentile(99.9),
+                      static_cast<unsigned long long>(d.max));
+        out += line;
+    }
+    // read: tables and bytes behind each key looked up (a multi_get's
+    // batched probes spread over its keys); write: bytes the disk took
+    // (WAL, flushes, compactions, value logs) per byte the user wrote
+    const uint64_t gets = ticker(Ticker::GetCalls) + ticker(Ticker::MultiGetKeys);
+    const uint64_t disk = ticker(Ticker::WalBytes) + ticker(Ticker::FlushBytes) +
+                          ticker(Ticker::CompactionBytesWritten) + ticker(Ticker::ValueLogBytesWritten);
+    std::snprintf(line, sizeof(line), "read_amp tables/get=%.2f bytes/get=%.1f write_amp=%.2f\n",
+                  ratio(ticker(Ticker::TablesProbed), gets), ratio(ticker(Ticker::TableBytesRead), gets),
+                  ratio(disk, ticker(Ticker::BytesWritten)));
+    out += line;
+    return out;
+}
+
+// "get.calls" -> "kv_get_calls"
+static std::string prometheus_name(const char* name) {
+    std::string s = "kv_";
+    for (const char* p = name; *p; ++p) s += *p == '.' ? '_' : *p;
+    return s;
+}
+
+std::string Statistics::to_prometheus() const {
+    std::string out;
+    char line[256];
+    for (size_t i = 0; i < static_cast<size_t>(Ticker::kCount); ++i) {
+        const std::string name = prometheus_name(kTickerNames[i]) + "_total";
+        std::snprintf(line, sizeof(line), "# TYPE %s counter\n%s %llu\n", name.c_str(), name.c_str(),
+                      static_cast<unsigned long long>(ticker(static_cast<Ticker>(i))));
+        out += line;
+    }
+    for (size_t i = 0; i < static_cast<size_t>(Histogram::kCount); ++i) {
+        const std::string name = prometheus_name(kHistogramNames[i]);
+        const HistogramData d = histogram(static_cast<Histogram>(i));
+        out += "# TYPE " + name + " summary\n";
+        for (double q : {0.5, 0.95, 0.99, 0.999}) {
+            std::snprintf(line, sizeof(line), "%s{quantile=\"%g\"} %.1f\n", name.c_str(), q, d.percentile(q * 100));
+            out += line;
+        }
+        std::snprintf(line, sizeof(line), "%s_sum %llu\n%s_count %llu\n", name.c_str(),
+                      static_cast<unsigned long long>(d.sum), name.c_str(),
+                      static_cast<unsigned long long>(d.count));
+        out += line;
+    }
+    return out;
+}
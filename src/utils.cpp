@@ -2,6 +2,97 @@
 
 #include <zlib.h>
 
-uint32_t compute_crc32(const std::string& data) {
+#include <cstring>
+
+uint32_t compute_crc32(std::string_view data) {
     return crc32(0L, reinterpret_cast<const unsigned char*>(data.data()), data.size());
 }
+
+uint64_t hash64(std::string_view data, uint64_t seed) {
+    constexpr uint64_t m = 0xc6a4a7935bd1e995ULL;
+    constexpr int r = 47;
+    const size_t len = data.size();
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data());
+    uint64_t h = seed ^ (len * m);
+
+    for (size_t n = len / 8; n; --n, p += 8) {
+        uint64_t k;
+        std::memcpy(&k, p, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+    switch (len & 7) {
+        case 7: h ^= uint64_t(p[6]) << 48; [[fallthrough]];
+        case 6: h ^= uint64_t(p[5]) << 40; [[fallthrough]];
+        case 5: h ^= uint64_t(p[4]) << 32; [[fallthrough]];
+        case 4: h ^= uint64_t(p[3]) << 24; [[fallthrough]];
+        case 3: h ^= uint64_t(p[2]) << 16; [[fallthrough]];
+        case 2: h ^= uint64_t(p[1]) << 8; [[fallthrough]];
+        case 1:
+            h ^= uint64_t(p[0]);
+            h *= m;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+void put_fixed32(std::string* dst, uint32_t v) {
+    dst->append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+void put_fixed64(std::string* dst, uint64_t v) {
+    dst->append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+uint32_t decode_fixed32(const char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+uint64_t decode_fixed64(const char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+void put_varint32(std::string* dst, uint32_t v) { put_varint64(dst, v); }
+
+void put_varint64(std::string* dst, uint64_t v) {
+    char buf[10];
+    size_t n = 0;
+    while (v >= 0x80) {
+        buf[n++] = static_cast<char>(v | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = static_cast<char>(v);
+    dst->append(buf, n);
+}
+
+const char* get_varint32(const char* p, const char* limit, uint32_t* v) {
+    // fast path: single byte
+    if (p < limit && (static_cast<unsigned char>(*p) & 0x80) == 0) {
+        *v = static_cast<unsigned char>(*p);
+        return p + 1;
+    }
+    uint64_t wide = 0;
+    const char* q = get_varint64(p, limit, &wide);
+    if (!q || wide > UINT32_MAX) return nullptr;
+    *v = static_cast<uint32_t>(wide);
+    return q;
+}
+
+const char* get_varint64(const char* p, const char* limit, uint64_t* v) {
+    uint64_t result = 0;
+    for (uint32_t shift = 0; shift <= 63 && p < limit; shift += 7) {
+        uint64_t byte = static_cast<unsigned char>(*p++);
+        result |= (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *v = result;
+            return p;
+        }
+    }
+    return nullptr;
+}
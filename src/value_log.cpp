@@ -0,0 +1,182 @@
+#include "value_log.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+#include "perf_context.h"
+#include "sstable.h"  // SSTable::fsync_dir
+#include "utils.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr size_t kWriteBufferSize = 1 << 20;
+
+bool write_all(int fd, const char* p, size_t n) {
+    while (n) {
+        ssize_t w = ::write(fd, p, n);
+        if (w < 0) return false;
+        p += w;
+        n -= static_cast<size_t>(w);
+    }
+    return true;
+}
+
+bool pread_all(int fd, char* p, size_t n, uint64_t off) {
+    while (n) {
+        ssize_t r = ::pread(fd, p, n, static_cast<off_t>(off));
+        perf_count(&PerfContext::read_syscalls);
+        if (r <= 0) return false;
+        p += r;
+        n -= static_cast<size_t>(r);
+        off += static_cast<uint64_t>(r);
+    }
+    return true;
+}
+}  // namespace
+
+// ===== ValueRef =====
+
+void ValueRef::encode(std::string* out) const {
+    put_varint64(out, number);
+    put_varint64(out, offset);
+    put_varint64(out, size);
+}
+
+bool ValueRef::decode(std::string_view in) {
+    const char* p = in.data();
+    const char* limit = p + in.size();
+    p = get_varint64(p, limit, &number);
+    if (p) p = get_varint64(p, limit, &offset);
+    if (p) p = get_varint64(p, limit, &size);
+    return p == limit;
+}
+
+bool ValueLogUsageCounter::add(std::string_view value) {
+    ValueRef ref;
+    if (!ref.decode(value)) return false;
+    auto it = std::lower_bound(usage_.begin(), usage_.end(), ref.number,
+                               [](const ValueLogUsage& u, uint64_t n) { return u.number < n; });
+    if (it == usage_.end() || it->number != ref.number) it = usage_.insert(it, ValueLogUsage{ref.number, 0});
+    it->bytes += ref.size;
+    return true;
+}
+
+// ===== ValueLog =====
+
+std::string ValueLog::file_name_for(const std::string& dir, uint64_t number) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%06llu.vlog", static_cast<unsigned long long>(number));
+    return (fs::path(dir) / buf).string();
+}
+
+ValueLog::~ValueLog() {
+    if (fd_ >= 0) ::close(fd_);
+    if (obsolete_.load()) ::unlink(path_.c_str());
+}
+
+bool ValueLog::Open(const std::string& path, uint64_t number) {
+    path_ = path;
+    number_ = number;
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) return false;
+    struct stat st;
+    char header[kHeaderSize];
+    if (::fstat(fd_, &st) != 0 || static_cast<uint64_t>(st.st_size) < kHeaderSize ||
+        !pread_all(fd_, header, kHeaderSize, 0))
+        return false;
+    file_size_ = static_cast<uint64_t>(st.st_size);
+    return decode_fixed32(header) == kMagic && decode_fixed32(header + 4) == kVersion;
+}
+
+bool ValueLog::Read(const ValueRef& ref, std::string* value) const {
+    PerfTimer timer(&PerfContext::value_log_read_nanos);
+    perf_count(&PerfContext::value_log_reads);
+    perf_count(&PerfContext::bytes_read, ref.size);
+    if (ref.number != number_ || ref.size < kRecordHeaderSize || ref.offset < kHeaderSize ||
+        ref.offset > file_size_ || ref.size > file_size_ - ref.offset)
+        return false;
+    std::string buf(ref.size, '\0');
+    if (!pread_all(fd_, buf.data(), buf.size(), ref.offset)) return false;
+    const uint32_t klen = decode_fixed32(buf.data() + 4);
+    const uint32_t vlen = decode_fixed32(buf.data() + 8);
+    if (kRecordHeaderSize + uint64_t(klen) + vlen != ref.size) return false;
+    if (compute_crc32(std::string_view(buf).substr(4)) != decode_fixed32(buf.data())) return false;
+    // the value is the tail of the record
+    buf.erase(0, kRecordHeaderSize + klen);
+    *value = std::move(buf);
+    return true;
+}
+
+// ===== ValueLogBuilder =====
+
+ValueLogBuilder::ValueLogBuilder(std::string dir, uint64_t number)
+    : dir_(std::move(dir)), number_(number), path_(ValueLog::file_name_for(dir_, number)) {}
+
+ValueLogBuilder::~ValueLogBuilder() {
+    if (fd_ >= 0) abandon();
+}
+
+bool ValueLogBuilder::open() {
+    fd_ = ::open(path_.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd_ < 0) return false;
+    put_fixed32(&buf_, ValueLog::kMagic);
+    put_fixed32(&buf_, ValueLog::kVersion);
+    return true;
+}
+
+void ValueLogBuilder::abandon() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+        ::unlink(path_.c_str());
+    }
+}
+
+bool ValueLogBuilder::flush_buffer() {
+    if (buf_.empty()) return true;
+    if (!write_all(fd_, buf_.data(), buf_.size())) return false;
+    written_ += buf_.size();
+    buf_.clear();
+    return true;
+}
+
+bool ValueLogBuilder::add(std::string_view key, std::string_view value, ValueRef* ref) {
+    if (fd_ < 0) return false;
+    ref->number = number_;
+    ref->offset = file_size();
+    ref->size = ValueLog::kRecordHeaderSize + key.size() + value.size();
+
+    const size_t start = buf_.size();
+    put_fixed32(&buf_, 0);  // crc, filled in below
+    put_fixed32(&buf_, static_cast<uint32_t>(key.size()));
+    put_fixed32(&buf_, static_cast<uint32_t>(value.size()));
+    buf_.append(key.data(), key.size());
+    buf_.append(value.data(), value.size());
+    const uint32_t crc = compute_crc32(std::string_view(buf_).substr(start + 4));
+    std::string fixed;
+    put_fixed32(&fixed, crc);
+    buf_.replace(start, 4, fixed);
+    return buf_.size() < kWriteBufferSize || flush_buffer();
+}
+
+bool ValueLogBuilder::finish(std::string* out_path) {
+    if (fd_ < 0) return false;
+    if (!flush_buffer() || ::fsync(fd_) != 0) {
+        abandon();
+        return false;
+    }
+    ::close(fd_);
+    fd_ = -1;
+    if (!SSTable::fsync_dir(dir_)) {
+        ::unlink(path_.c_str());
+        return false;
+    }
+    if (out_path) *out_path = path_;
+    return true;
+}
@@ -0,0 +1,82 @@
+#include "version.h"
+
+#include <algorithm>
+#include <set>
+
+#include "manifest.h"
+
+size_t Version::num_tables() const {
+    size_t n = 0;
+    for (const auto& l : levels) n += l.size();
+    return n;
+}
+
+uint64_t Version::level_bytes(int level) const {
+    uint64_t n = 0;
+    for (const auto& t : levels[level]) n += t->file_size();
+    return n;
+}
+
+uint64_t Version::value_log_live_bytes(uint64_t number) const {
+    uint64_t n = 0;
+    for (const auto& level : levels)
+        for (const auto& t : level)
+            for (const auto& u : t->value_logs())
+                if (u.number == number) n += u.bytes;
+    return n;
+}
+
+const SSTable* Version::find_in_level(int level, std::string_view key) const {
+    const auto& files = levels[level];
+    // first table whose largest key is >= key
+    auto it = std::lower_bound(files.begin(), files.end(), key,
+                               [](const TableRef& t, std::string_view k) { return t->largest_key() < k; });
+    if (it == files.end() || key < (*it)->smallest_key()) return nullptr;
+    return it->get();
+}
+
+std::vector<TableRef> Version::overlapping(int level, std::string_view lo, std::string_view hi) const {
+    std::vector<TableRef> out;
+    for (const auto& t : levels[level]) {
+        if (t->index_size() == 0) continue;  // empty table
+        if (std::string_view(t->largest_key()) < lo || hi < std::string_view(t->smallest_key())) continue;
+        out.push_back(t);
+    }
+    return out;
+}
+
+void Version::sort_level(int level) {
+    if (level == 0) return;
+    std::sort(levels[level].begin(), levels[level].end(),
+              [](const TableRef& a, const TableRef& b) { return a->smallest_key() < b->smallest_key(); });
+}
+
+void Version::apply(const VersionEdit& edit, const std::vector<TableRef>& added,
+                    const std::vector<ValueLogRef>& new_logs) {
+    for (const auto& [level, id] : edit.removed) {
+        auto& files = levels[level];
+        files.erase(std::remove_if(files.begin(), files.end(),
+                                   [id = id](const TableRef& t) { return t->file_id() == id; }),
+                    files.end());
+    }
+    std::vector<bool> touched(levels.size(), false);
+    for (size_t i = 0; i < edit.added.size(); ++i) {
+        const int level = edit.added[i].level;
+        auto& files = levels[level];
+        if (level == 0)
+            files.insert(files.begin(), added[i]);
+        else
+            files.push_back(added[i]);
+        touched[level] = true;
+    }
+    for (int l = 1; l < num_levels(); ++l)
+        if (touched[l]) sort_level(l);
+
+    for (const auto& log : new_logs) value_logs.emplace(log->number(), log);
+    if (value_logs.empty()) return;
+    std::set<uint64_t> referenced;
+    for (const auto& level : levels)
+        for (const auto& t : level)
+            for (const auto& u : t->value_logs()) referenced.insert(u.number);
+    std::erase_if(value_logs, [&](const auto& e) { return !referenced.count(e.first); });
+}
@@ -0,0 +1,32 @@
+#include "write_batch.h"
+
+#include <cstring>
+
+void WriteBatch::put(std::string_view key, std::string_view value) {
+    uint32_t n = count() + 1;
+    std::memcpy(rep_.data(), &n, sizeof(n));
+    rep_.push_back(static_cast<char>(RecType::Put));
+    put_varint32(&rep_, static_cast<uint32_t>(key.size()));
+    rep_.append(key);
+    put_varint32(&rep_, static_cast<uint32_t>(value.size()));
+    rep_.append(value);
+}
+
+void WriteBatch::del(std::string_view key) {
+    uint32_t n = count() + 1;
+    std::memcpy(rep_.data(), &n, sizeof(n));
+    rep_.push_back(static_cast<char>(RecType::Del));
+    put_varint32(&rep_, static_cast<uint32_t>(key.size()));
+    rep_.append(key);
+}
+
+void WriteBatch::append(const WriteBatch& other) {
+    uint32_t n = count() + other.count();
+    std::memcpy(rep_.data(), &n, sizeof(n));
+    rep_.append(other.rep_, sizeof(uint32_t), std::string::npos);
+}
+
+void WriteBatch::clear() {
+    rep_.clear();  // keeps the capacity for the next batch
+    put_fixed32(&rep_, 0);
+}
@@ -0,0 +1,912 @@
+#include "engine.h"
+#include "perf_context.h"
+
+#include <atomic>
+#include <chrono>
+#include <cassert>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static void clean_dir(const fs::path& p) {
+    std::error_code ec;
+    fs::remove_all(p, ec);
+    fs::create_directories(p, ec);
+    (void)ec;
+}
+
+static std::string key_of(int i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "key%06d", i);
+    return buf;
+}
+
+static size_t count_sst_files(const fs::path& dir) {
+    size_t n = 0;
+    for (auto& de : fs::directory_iterator(dir))
+        if (de.path().extension() == ".sst") ++n;
+    return n;
+}
+
+static size_t total(const std::vector<size_t>& v) {
+    size_t n = 0;
+    for (size_t x : v) n += x;
+    return n;
+}
+
+// Small levels so a few thousand keys spread over several of them.
+static EngineOptions small_options(bool background) {
+    EngineOptions o;
+    o.mem_flush_threshold_bytes = 1 << 30;  // flush only when told to
+    o.compaction.background = background;
+    o.compaction.l0_compaction_trigger = 2;
+    o.compaction.level1_max_bytes = 8 * 1024;
+    o.compaction.level_size_multiplier = 2;
+    o.compaction.target_file_size = 4 * 1024;
+    return o;
+}
+
+// Round r writes keys [0, 2000): value "r<r>-<i>", and deletes every 5th key
+// in odd rounds. Returns the expected value of key i after `rounds` rounds.
+static std::optional<std::string> expected(int rounds, int i) {
+    int last = rounds - 1;
+    if (last % 2 == 1 && i % 5 == 0) return std::nullopt;
+    return "r" + std::to_string(last) + "-" + std::to_string(i);
+}
+
+static void write_rounds(Engine& db, int first, int rounds) {
+    for (int r = first; r < first + rounds; ++r) {
+        for (int i = 0; i < 2000; ++i) {
+            if (r % 2 == 1 && i % 5 == 0)
+                assert(db.del(key_of(i)));
+            else
+                assert(db.put(key_of(i), "r" + std::to_string(r) + "-" + std::to_string(i)));
+        }
+        assert(db.flush());
+    }
+}
+
+static void check_all(const Engine& db, int rounds) {
+    for (int i = 0; i < 2000; ++i) assert(db.get(key_of(i)) == expected(rounds, i));
+    assert(!db.get("zzz"));
+}
+
+static void test_flush_goes_to_l0() {
+    std::cout << "[T] flush_goes_to_l0\n";
+    clean_dir("testdata");
+    Engine db("testdata", small_options(false));
+    assert(db.open());
+    write_rounds(db, 0, 3);
+    auto counts = db.level_table_counts();
+    assert(counts[0] == 3 && total(counts) == 3);
+    check_all(db, 3);
+}
+
+static void test_compaction_merges_levels() {
+    std::cout << "[T] compaction_merges_levels\n";
+    clean_dir("testdata");
+    Engine db("testdata", small_options(false));
+    assert(db.open());
+    write_rounds(db, 0, 4);
+    assert(db.compact());
+
+    auto counts = db.level_table_counts();
+    assert(counts[0] == 0);
+    size_t deeper = 0;
+    for (size_t l = 2; l < counts.size(); ++l) deeper += counts[l];
+    assert(deeper > 0);  // L1 overflowed into lower levels
+    check_all(db, 4);
+
+    // compacted inputs are gone from disk
+    assert(count_sst_files("testdata") == total(counts));
+}
+
+static void test_levels_survive_reopen() {
+    std::cout << "[T] levels_survive_reopen\n";
+    clean_dir("testdata");
+    std::vector<size_t> before;
+    {
+        Engine db("testdata", small_options(false));
+        assert(db.open());
+        write_rounds(db, 0, 4);
+        assert(db.compact());
+        // one more round stays in L0 on top of the compacted data
+        write_rounds(db, 4, 1);
+        before = db.level_table_counts();
+    }
+    Engine db("testdata", small_options(false));
+    assert(db.open());
+    assert(db.level_table_counts() == before);
+    check_all(db, 5);
+}
+
+static void test_bottommost_drops_tombstones() {
+    std::cout << "[T] bottommost_drops_tombstones\n";
+    clean_dir("testdata");
+    EngineOptions o = small_options(false);
+    o.compaction.level1_max_bytes = 64 << 20;  // everything ends up in L1
+    Engine db("testdata", o);
+    assert(db.open());
+    for (int i = 0; i < 100; ++i) assert(db.put(key_of(i), "v"));
+    assert(db.flush());
+    for (int i = 0; i < 100; ++i) assert(db.del(key_of(i)));
+    assert(db.flush());
+    assert(db.compact());
+    // every key was deleted and nothing lies below: no table left at all
+    assert(total(db.level_table_counts()) == 0);
+    assert(count_sst_files("testdata") == 0);
+    for (int i = 0; i < 100; ++i) assert(!db.get(key_of(i)));
+}
+
+static void test_background_compaction_with_readers() {
+    std::cout << "[T] background_compaction_with_readers\n";
+    clean_dir("testdata");
+    {
+        Engine db("testdata", small_options(false));
+        assert(db.open());
+        write_rounds(db, 0, 4);
+    }
+    // Reopening with four L0 tables schedules a compaction right away.
+    // Readers run while the background thread swaps versions underneath
+    // them (the memtable is empty, only the table set changes).
+    Engine db("testdata", small_options(true));
+    assert(db.open());
+    std::atomic<bool> stop{false};
+    std::atomic<int> bad{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&, t] {
+            do {
+                for (int i = t; i < 2000; i += 4)
+                    if (db.get(key_of(i)) != expected(4, i)) bad.fetch_add(1);
+            } while (!stop.load());
+        });
+    }
+    assert(db.wait_for_compactions());
+    stop.store(true);
+    for (auto& r : readers) r.join();
+    assert(bad.load() == 0);
+    assert(db.level_table_counts()[0] == 0);
+
+    // later flushes keep triggering it
+    write_rounds(db, 4, 2);
+    assert(db.wait_for_compactions());
+    assert(db.level_table_counts()[0] < 2);
+    check_all(db, 6);
+}
+
+static void test_open_cleans_leftovers() {
+    std::cout << "[T] open_cleans_leftovers\n";
+    clean_dir("testdata");
+    {
+        Engine db("testdata", small_options(false));
+        assert(db.open());
+        write_rounds(db, 0, 1);
+    }
+    // a builder temp file and a finished table no version ever recorded
+    std::ofstream("testdata/tmp_000050.sst") << "partial";
+    for (auto& de : fs::directory_iterator("testdata")) {
+        if (de.path().extension() == ".sst") {
+            fs::copy_file(de.path(), "testdata/000051.sst");
+            break;
+        }
+    }
+
+    Engine db("testdata", small_options(false));
+    assert(db.open());
+    assert(!fs::exists("testdata/tmp_000050.sst"));
+    assert(!fs::exists("testdata/000051.sst"));
+    assert(total(db.level_table_counts()) == 1);
+    check_all(db, 1);
+}
+
+static void test_version_edit_round_trip() {
+    std::cout << "[T] version_edit_round_trip\n";
+    VersionEdit e;
+    e.next_file_id = 42;
+    e.wal_number = 7;
+    e.remove_table(0, 3);
+    e.add_table(1, 9, 1234, "apple", "pear", {{5, 4000}, {8, 100}});
+    std::string buf;
+    e.encode(&buf);
+
+    VersionEdit d;
+    assert(d.decode(buf));
+    assert(d.next_file_id == 42u && d.wal_number == 7u);
+    assert(d.removed.size() == 1 && d.removed[0] == std::make_pair(0, uint64_t{3}));
+    assert(d.added.size() == 1 && d.added[0].file_id == 9 && d.added[0].file_size == 1234);
+    assert(d.added[0].smallest == "apple" && d.added[0].largest == "pear");
+    assert(d.added[0].value_logs.size() == 2 && d.added[0].value_logs[1].number == 8 &&
+           d.added[0].value_logs[1].bytes == 100);
+    assert(!d.decode(std::string_view(buf).substr(0, buf.size() - 1)));
+
+    ManifestState st(2);
+    VersionEdit a, b;
+    a.add_table(0, 3, 10, "a", "b");
+    a.add_table(0, 4, 10, "a", "c");
+    assert(st.apply(a) && st.apply(d));
+    assert(st.levels[0].size() == 1 && st.levels[0][0].file_id == 4);
+    assert(st.levels[1].size() == 1 && st.next_file_id == 42 && st.wal_number == 7);
+    b.add_table(5, 11, 10, "a", "b");
+    assert(!st.apply(b));  // no such level
+}
+
+static void test_manifest_torn_tail() {
+    std::cout << "[T] manifest_torn_tail\n";
+    clean_dir("testdata");
+    {
+        Engine db("testdata", small_options(false));
+        assert(db.open());
+        write_rounds(db, 0, 4);
+        assert(db.compact());
+        write_rounds(db, 4, 1);
+    }
+    // a record cut short by a crash mid-append
+    {
+        std::ofstream out("testdata/MANIFEST", std::ios::binary | std::ios::app);
+        out.write("\x10\x20\x30\x40\x50\x00\x00\x00\x01", 9);
+    }
+    Engine db("testdata", small_options(false));
+    assert(db.open());
+    check_all(db, 5);
+    assert(count_sst_files("testdata") == total(db.level_table_counts()));
+}
+
+static void test_upgrade_pre_manifest_dir() {
+    std::cout << "[T] upgrade_pre_manifest_dir\n";
+    clean_dir("testdata");
+    // two flush outputs from before the MANIFEST; the higher id is newer
+    std::vector<std::pair<std::string, MemValue>> older{{"a", {RecType::Put, "1"}}, {"b", {RecType::Put, "1"}}};
+    std::vector<std::pair<std::string, MemValue>> newer{{"a", {RecType::Put, "2"}}, {"b", {RecType::Del, ""}}};
+    assert(SSTable::Build("testdata", 1, older));
+    assert(SSTable::Build("testdata", 2, newer));
+
+    {
+        Engine db("testdata", small_options(false));
+        assert(db.open());
+        assert(fs::exists("testdata/MANIFEST"));
+        assert(db.level_table_counts()[0] == 2);
+        assert(db.get("a") == "2" && !db.get("b"));
+        assert(db.put("c", "3") && db.flush());
+    }
+    Engine db("testdata", small_options(false));
+    assert(db.open());
+    assert(db.level_table_counts()[0] == 3);
+    assert(db.get("a") == "2" && !db.get("b") && db.get("c") == "3");
+}
+
+static size_t count_files(const fs::path& dir, const char* ext) {
+    size_t n = 0;
+    for (auto& de : fs::directory_iterator(dir))
+        if (de.path().extension() == ext) ++n;
+    return n;
+}
+
+static void test_background_flush() {
+    std::cout << "[T] background_flush\n";
+    clean_dir("testdata");
+    EngineOptions o = small_options(false);
+    o.mem_flush_threshold_bytes = 16 * 1024;  // a memtable switch every ~500 writes
+    o.max_immutable_memtables = 1;            // and writers stall behind the flush thread
+    o.max_recycled_wals = 0;                  // flushed segments are deleted
+    Engine db("testdata", o);
+    assert(db.open());
+    for (int i = 0; i < 5000; ++i) {
+        assert(db.put(key_of(i), "value-" + std::to_string(i)));
+        // earlier keys stay visible whether they sit in the active memtable,
+        // a queued one or an L0 table
+        if (i % 97 == 0)
+            for (int j = 0; j <= i; j += 13) assert(db.get(key_of(j)) == "value-" + std::to_string(j));
+    }
+    assert(db.num_immutable_memtables() <= 1);
+    assert(db.flush());
+    assert(db.num_immutable_memtables() == 0 && db.mem_size() == 0);
+    assert(db.level_table_counts()[0] > 5);
+    assert(count_files("testdata", ".log") == 1);  // flushed segments are deleted
+    for (int i = 0; i < 5000; ++i) assert(db.get(key_of(i)) == "value-" + std::to_string(i));
+}
+
+static void test_queued_memtables_survive_reopen() {
+    std::cout << "[T] queued_memtables_survive_reopen\n";
+    clean_dir("testdata");
+    EngineOptions o = small_options(false);
+    o.mem_flush_threshold_bytes = 16 * 1024;
+    o.max_immutable_memtables = 8;
+    {
+        Engine db("testdata", o);
+        assert(db.open());
+        write_rounds(db, 0, 1);
+        for (int i = 0; i < 2000; ++i) assert(db.put(key_of(i), "late-" + std::to_string(i)));
+        // closed right away: whatever the flush thread has not written is
+        // only in the WAL segments
+    }
+    Engine db("testdata", o);
+    assert(db.open());
+    for (int i = 0; i < 2000; ++i) assert(db.get(key_of(i)) == "late-" + std::to_string(i));
+    assert(count_files("testdata", ".log") == 1);
+}
+
+static void test_skiplist_memtable() {
+    std::cout << "[T] skiplist_memtable\n";
+    clean_dir("testdata");
+    EngineOptions o = small_options(false);
+    o.memtable_rep = MemTableRep::SkipList;
+    o.mem_flush_threshold_bytes = 64 * 1024;
+    {
+        Engine db("testdata", o);
+        assert(db.open());
+        write_rounds(db, 0, 3);
+        for (int i = 0; i < 2000; i += 3) assert(db.put(key_of(i), "unflushed"));
+    }
+    Engine db("testdata", o);
+    assert(db.open());
+    for (int i = 0; i < 2000; ++i) {
+        if (i % 3 == 0)
+            assert(db.get(key_of(i)) == "unflushed");
+        else
+            assert(db.get(key_of(i)) == expected(3, i));
+    }
+}
+
+static void test_write_batch() {
+    std::cout << "[T] write_batch\n";
+    clean_dir("testdata");
+    EngineOptions o = small_options(false);
+    {
+        Engine db("testdata", o);
+        assert(db.open());
+        assert(db.put(key_of(0), "old"));
+        WriteBatch b;
+        for (int i = 0; i < 500; ++i) b.put(key_of(i), "batch-" + std::to_string(i));
+        for (int i = 0; i < 500; i += 7) b.del(key_of(i));
+        assert(db.write(b));
+        assert(db.write(WriteBatch()));  // empty: no-op
+        assert(db.flush());              // half of it in L0 ...
+
+        b.clear();
+        for (int i = 500; i < 1000; ++i) b.put(key_of(i), "batch-" + std::to_string(i));
+        assert(db.write(b));             // ... half only in the WAL
+    }
+    Engine db("testdata", o);
+    assert(db.open());
+    for (int i = 0; i < 1000; ++i) {
+        if (i < 500 && i % 7 == 0)
+            assert(!db.get(key_of(i)));
+        else
+            assert(db.get(key_of(i)) == "batch-" + std::to_string(i));
+    }
+}
+
+static void test_durability_modes() {
+    std::cout << "[T] durability_modes\n";
+    for (WalSyncMode mode : {WalSyncMode::None, WalSyncMode::Periodic, WalSyncMode::EveryWrite}) {
+        clean_dir("testdata");
+        EngineOptions o = small_options(false);
+        o.wal_sync = mode;
+        o.wal_sync_interval_ms = 5;
+        o.wal_sync_bytes = 4096;
+        {
+            Engine db("testdata", o);
+            assert(db.open());
+            for (int i = 0; i < 300; ++i) assert(db.put(key_of(i), "v" + std::to_string(i)));
+            assert(db.del(key_of(0)));
+            WriteBatch b;
+            b.put(key_of(1), "batched");
+            assert(db.write(b));
+            if (mode == WalSyncMode::Periodic) {
+                // the byte trigger or the timer syncs what was appended
+                auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+                while (db.background_syncs() == 0 && std::chrono::steady_clock::now() < deadline)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                assert(db.background_syncs() >= 1);
+            } else {
+                assert(db.background_syncs() == 0);
+            }
+        }
+        Engine db("testdata", o);
+        assert(db.open());
+        assert(!db.get(key_of(0)) && db.get(key_of(1)) == "batched" && db.get(key_of(299)) == "v299");
+    }
+}
+
+static void test_wal_recycling() {
+    std::cout << "[T] wal_recycling\n";
+    clean_dir("testdata");
+    EngineOptions o = small_options(false);
+    o.wal_preallocate_bytes = 64 * 1024;
+    o.max_recycled_wals = 2;
+    auto count_logs = [] {
+        size_t n = 0;
+        for (auto& de : fs::directory_iterator("testdata"))
+            if (de.path().extension() == ".log") {
+                assert(fs::file_size(de.path()) >= 64 * 1024);
+                ++n;
+            }
+        return n;
+    };
+    {
+        Engine db("testdata", o);
+        assert(db.open());
+        for (int round = 0; round < 6; ++round) {
+            for (int i = 0; i < 200; ++i) assert(db.put(key_of(i), "r" + std::to_string(round)));
+            assert(db.flush());
+            // the active segment plus at most two kept for reuse
+            assert(count_logs() <= 3);
+        }
+        for (int i = 0; i < 100; ++i) assert(db.put(key_of(i), "unflushed"));
+    }
+    Engine db("testdata", o);
+    assert(db.open());
+    for (int i = 0; i < 200; ++i) assert(db.get(key_of(i)) == (i < 100 ? "unflushed" : "r5"));
+}
+
+// Live keys of the engine in [lo, hi), as "key=value;" pairs.
+static std::string scan(const Engine& db, const ReadOptions& ro = {}) {
+    std::string out;
+    auto it = db.NewIterator(ro);
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        assert(it->type() == RecType::Put);
+        out += std::string(it->key()) + "=" + std::string(it->value()) + ";";
+    }
+    assert(it->ok());
+    return out;
+}
+
+static void test_range_scan() {
+    std::cout << "[T] range_scan\n";
+    clean_dir("testdata");
+    EngineOptions o = small_options(false);
+    {
+        Engine db("testdata", o);
+        assert(db.open());
+        write_rounds(db, 0, 4);     // levels: every version of every key
+        assert(db.compact());
+        write_rounds(db, 4, 1);     // L0 on top
+        assert(db.level_table_counts()[0] >= 1 && total(db.level_table_counts()) > 2);
+        // memtable on top: delete a few more, resurrect some deleted ones
+        for (int i = 1; i < 2000; i += 10) assert(db.del(key_of(i)));
+        for (int i = 0; i < 2000; i += 10) assert(db.put(key_of(i), "mem"));
+
+        auto want = [](int i) -> std::optional<std::string> {
+            if (i % 10 == 1) return std::nullopt;
+            if (i % 10 == 0) return "mem";
+            return expected(5, i);
+        };
+        auto it = db.NewIterator();
+        int i = 0;
+        for (it->SeekToFirst(); it->Valid(); it->Next(), ++i) {
+            while (!want(i)) ++i;
+            assert(it->key() == key_of(i) && it->value() == *want(i));
+        }
+        while (i < 2000 && !want(i)) ++i;
+        assert(i == 2000 && it->ok());
+
+        // Seek lands on the next live key
+        it->Seek(key_of(1001));
+        assert(it->Valid() && it->key() == key_of(1002));
+        it->Seek("zzz");
+        assert(!it->Valid());
+
+        // bounds
+        ReadOptions ro;
+        ro.lower_bound = key_of(15);
+        ro.upper_bound = key_of(23);
+        assert(scan(db, ro) == key_of(15) + "=r4-15;" + key_of(16) + "=r4-16;" + key_of(17) + "=r4-17;" +
+                                   key_of(18) + "=r4-18;" + key_of(19) + "=r4-19;" + key_of(20) + "=mem;" +
+                                   key_of(22) + "=r4-22;");
+        auto b = db.NewIterator(ro);
+        b->Seek(key_of(0));     // clamped to the lower bound
+        assert(b->Valid() && b->key() == key_of(15));
+        b->Seek(key_of(30));
+        assert(!b->Valid());
+        ro.lower_bound = "zzz";
+        ro.upper_bound.clear();
+        assert(scan(db, ro).empty());
+
+        // the iterator keeps its tables after a compaction replaces them
+        auto pinned = db.NewIterator();
+        assert(db.flush() && db.compact());
+        pinned->SeekToFirst();
+        assert(pinned->Valid() && pinned->key() == key_of(0) && pinned->value() == "mem");
+    }
+    Engine db("testdata", o);
+    assert(db.open());
+    ReadOptions ro;
+    ro.upper_bound = key_of(3);
+    assert(scan(db, ro) == key_of(0) + "=mem;" + key_of(2) + "=r4-2;");
+}
+
+static void test_multi_get() {
+    std::cout << "[T] multi_get\n";
+    clean_dir("testdata");
+    EngineOptions o = small_options(false);
+    Engine db("testdata", o);
+    assert(db.open());
+    write_rounds(db, 0, 4);
+    assert(db.compact());
+    write_rounds(db, 4, 1);
+    for (int i = 1; i < 2000; i += 10) assert(db.del(key_of(i)));
+    for (int i = 0; i < 2000; i += 10) assert(db.put(key_of(i), "mem"));
+
+    // unsorted, with duplicates and missing keys
+    std::vector<std::string> owned;
+    for (int i = 0; i < 3000; ++i) owned.push_back(key_of((i * 7919) % 2100));
+    owned.push_back("a");
+    owned.push_back("zzz");
+    std::vector<std::string_view> keys(owned.begin(), owned.end());
+    auto got = db.multi_get(keys);
+    assert(got.size() == keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) assert(got[i] == db.get(owned[i]));
+    assert(db.multi_get({}).empty());
+}
+
+// Writers, readers and flushes all at once. Once a write returns, every
+// reader must see it; after a reopen everything acknowledged is there.
+static void test_concurrent_writers_and_readers(MemTableRep rep) {
+    std::cout << "[T] concurrent_writers_and_readers ("
+              << (rep == MemTableRep::Map ? "map" : "skiplist") << ")\n";
+    clean_dir("testdata");
+    EngineOptions o = small_options(true);
+    o.memtable_rep = rep;
+    o.mem_flush_threshold_bytes = 32 * 1024;   // many memtable switches
+    constexpr int kWriters = 4, kKeys = 1500;
+    auto key = [](int t, int i) { return "w" + std::to_string(t) + "-" + key_of(i); };
+    auto want = [](int i) -> std::optional<std::string> {
+        if (i % 10 == 9) return std::nullopt;
+        return "v" + std::to_string(i);
+    };
+    {
+        Engine db("testdata", o);
+        assert(db.open());
+        std::atomic<int> progress[kWriters] = {};
+        std::atomic<bool> stop{false};
+        std::atomic<int> bad{0};
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kWriters; ++t) {
+            threads.emplace_back([&, t] {
+                for (int i = 0; i < kKeys; ++i) {
+                    if (i % 3 == 0) {
+                        WriteBatch b;
+                        b.put(key(t, i), "v" + std::to_string(i));
+                        assert(db.write(b));
+                    } else {
+                        assert(db.put(key(t, i), "v" + std::to_string(i)));
+                    }
+                    if (i % 10 == 9) assert(db.del(key(t, i)));
+                    progress[t].store(i + 1);
+                }
+            });
+        }
+        std::vector<std::thread> readers;
+        for (int r = 0; r < 3; ++r) {
+            readers.emplace_back([&, r] {
+                unsigned n = r;
+                while (!stop.load()) {
+                    int t = n++ % kWriters;
+                    int done = progress[t].load();
+                    if (done == 0) continue;
+                    int i = static_cast<int>((n * 7919u) % done);
+                    if (db.get(key(t, i)) != want(i)) bad.fetch_add(1);
+                }
+            });
+        }
+        std::thread flusher([&] {
+            for (int i = 0; i < 5; ++i) {
+                assert(db.flush());
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+        });
+        for (auto& th : threads) th.join();
+        flusher.join();
+        stop.store(true);
+        for (auto& th : readers) th.join();
+        assert(bad.load() == 0);
+        assert(db.wait_for_compactions());
+        for (int t = 0; t < kWriters; ++t)
+            for (int i = 0; i < kKeys; ++i) assert(db.get(key(t, i)) == want(i));
+    }
+    Engine db("testdata", o);
+    assert(db.open());
+    for (int t = 0; t < kWriters; ++t)
+        for (int i = 0; i < kKeys; ++i) assert(db.get(key(t, i)) == want(i));
+}
+
+// Snapshots keep reading what they saw through flushes, compactions and
+// the writes made after them; released, their versions are compacted away.
+static void test_snapshots() {
+    std::cout << "[T] snapshots\n";
+    clean_dir("testdata");
+    EngineOptions o = small_options(/*background=*/false);
+    SequenceNumber last = 0;
+    {
+        Engine db("testdata", o);
+        assert(db.open());
+        for (int i = 0; i < 100; ++i) assert(db.put(key_of(i), "v1"));
+        const Snapshot* s1 = db.GetSnapshot();
+        assert(s1->sequence() == db.last_sequence() && s1->sequence() == 100);
+        for (int i = 0; i < 100; i += 2) assert(db.put(key_of(i), "v2"));
+        WriteBatch b;
+        b.del(key_of(1));
+        b.put(key_of(200), "new");
+        assert(db.write(b));
+        const Snapshot* s2 = db.GetSnapshot();
+        assert(db.put(key_of(0), "v3"));
+        assert(db.del(key_of(2)));
+
+        auto check = [&] {
+            assert(db.get(key_of(0), s1) == "v1" && db.get(key_of(0), s2) == "v2" && db.get(key_of(0)) == "v3");
+            assert(db.get(key_of(1), s1) == "v1" && !db.get(key_of(1), s2));
+            assert(db.get(key_of(2), s2) == "v2" && !db.get(key_of(2)));
+            assert(!db.get(key_of(200), s1) && db.get(key_of(200), s2) == "new");
+            std::vector<std::string> owned = {key_of(0), key_of(1), key_of(3)};
+            std::vector<std::string_view> views(owned.begin(), owned.end());
+            auto got = db.multi_get(views, s1);
+            assert(got[0] == "v1" && got[1] == "v1" && got[2] == "v1");
+
+            ReadOptions ro;
+            ro.snapshot = s1;
+            ro.upper_bound = key_of(3);
+            assert(scan(db, ro) == key_of(0) + "=v1;" + key_of(1) + "=v1;" + key_of(2) + "=v1;");
+            ro.snapshot = s2;
+            assert(scan(db, ro) == key_of(0) + "=v2;" + key_of(2) + "=v2;");
+            ro.snapshot = nullptr;
+            assert(scan(db, ro) == key_of(0) + "=v3;");
+        };
+        check();                       // memtable
+        assert(db.flush());
+        check();                       // L0 table
+        for (int r = 0; r < 3; ++r) {  // pushed down through the levels
+            for (int i = 300; i < 600; ++i) assert(db.put(key_of(i), std::string(40, 'f')));
+            assert(db.flush() && db.compact());
+        }
+        assert(db.level_table_counts()[0] < 2);
+        check();
+
+        // released: the next rewrite keeps only the newest versions (and no
+        // tombstones, at the bottom)
+        db.ReleaseSnapshot(s1);
+        db.ReleaseSnapshot(s2);
+        for (int i = 0; i < 100; ++i) assert(db.put(key_of(i), "v4"));
+        assert(db.flush() && db.compact());
+        auto it = db.NewIterator();
+        size_t live = 0;
+        for (it->SeekToFirst(); it->Valid(); it->Next()) ++live;
+        assert(live == 100 + 1 + 300);
+        last = db.last_sequence();
+    }
+    // the counter survives a reopen, so new writes stay newest
+    Engine db("testdata", o);
+    assert(db.open());
+    assert(db.last_sequence() == last);
+    const Snapshot* s = db.GetSnapshot();
+    assert(db.put(key_of(0), "v5"));
+    assert(db.last_sequence() == last + 1);
+    assert(db.get(key_of(0), s) == "v4" && db.get(key_of(0)) == "v5");
+    db.ReleaseSnapshot(s);
+}
+
+static void test_statistics() {
+    std::cout << "[T] statistics\n";
+    // log-linear buckets: exact below 16, then 8 per power of two
+    for (uint64_t v : {0ull, 15ull, 16ull, 17ull, 1000ull, 123456789ull, ~0ull}) {
+        size_t b = Statistics::bucket_of(v);
+        assert(b < Statistics::kBuckets && Statistics::bucket_floor(b) <= v);
+        assert(b + 1 == Statistics::kBuckets || v < Statistics::bucket_floor(b + 1));
+    }
+    Statistics st;
+    for (uint64_t v = 1; v <= 1000; ++v) st.record(Histogram::GetNanos, v);
+    HistogramData h = st.histogram(Histogram::GetNanos);
+    assert(h.count == 1000 && h.sum == 500500 && h.min == 1 && h.max == 1000);
+    assert(h.percentile(50) > 440 && h.percentile(50) < 560);   // within a bucket's 1/8
+    assert(h.percentile(99) > 900 && h.percentile(99) <= 1000 && h.percentile(100) == 1000);
+
+    clean_dir("testdata");
+    EngineOptions o = small_options(/*background=*/false);
+    o.wal_sync = WalSyncMode::EveryWrite;
+    Engine db("testdata", o);
+    assert(db.open());
+    for (int i = 0; i < 100; ++i) assert(db.put(key_of(i), "value"));
+    assert(db.del(key_of(0)));
+    assert(db.get(key_of(1)) == "value");   // from the memtable
+    assert(db.flush());
+    for (int i = 0; i < 100; ++i) assert(db.put(key_of(i), "again"));
+    assert(db.flush());
+    assert(db.get(key_of(2)) == "again" && !db.get("zzz"));
+
+    const Statistics& s = db.stats();
+    assert(s.ticker(Ticker::PutCalls) == 200 && s.ticker(Ticker::DelCalls) == 1);
+    assert(s.ticker(Ticker::GetCalls) == 3 && s.ticker(Ticker::GetFound) == 2);
+    assert(s.ticker(Ticker::GetMemtableHits) == 1);
+    assert(s.ticker(Ticker::FlushCount) == 2 && s.ticker(Ticker::FlushBytes) > 0);
+    assert(s.ticker(Ticker::WalSyncs) >= 201 && s.histogram(Histogram::WalSyncNanos).count >= 201);
+    assert(s.ticker(Ticker::WalBytes) > s.ticker(Ticker::BytesWritten));
+    // the newest L0 table answers key 2; "zzz" is past both tables' ranges
+    // but L0 tables are probed regardless, and their filters reject it
+    HistogramData tables = s.histogram(Histogram::TablesPerGet);
+    assert(tables.count == 2 && tables.sum == 3 && s.ticker(Ticker::TablesProbed) == 3);
+    assert(s.ticker(Ticker::TableBytesRead) > 0);
+    assert(s.histogram(Histogram::PutNanos).count == 200);
+
+    // a multi_get missing the memtable counts its batched table probes too
+    const uint64_t probed = s.ticker(Ticker::TablesProbed), read = s.ticker(Ticker::TableBytesRead);
+    const std::string k3 = key_of(3), k4 = key_of(4);
+    std::vector<std::string_view> batch = {k3, k4};
+    assert(db.multi_get(batch)[1] == "again");
+    assert(s.ticker(Ticker::TablesProbed) == probed + 1 && s.ticker(Ticker::TableBytesRead) > read);
+    assert(s.ticker(Ticker::GetCalls) == 3);
+
+    assert(db.compact());
+    assert(s.ticker(Ticker::CompactionCount) == 1);
+    assert(s.ticker(Ticker::CompactionBytesRead) > 0 && s.ticker(Ticker::CompactionBytesWritten) > 0);
+
+    const std::string prom = db.prometheus_text();
+    assert(prom.find("kv_get_calls_total 3\n") != std::string::npos);
+    assert(prom.find("kv_get_nanos{quantile=\"0.99\"}") != std::string::npos);
+    assert(prom.find("kv_level_tables{level=\"1\"} 1\n") != std::string::npos);
+    assert(prom.find("kv_sstable_probes_total{level=\"1\"") != std::string::npos);
+    assert(s.to_string().find("write_amp=") != std::string::npos);
+
+    db.reset_stats();
+    assert(s.ticker(Ticker::PutCalls) == 0 && s.histogram(Histogram::GetNanos).count == 0);
+}
+
+static void test_perf_context() {
+    std::cout << "[T] perf_context\n";
+    clean_dir("testdata");
+    {
+        Engine db("testdata", small_options(false));
+        assert(db.open());
+        for (int i = 0; i < 1000; ++i) assert(db.put(key_of(i), "value"));
+        assert(db.flush());
+    }
+    Engine db("testdata", small_options(false));   // reopened: a cold block cache
+    assert(db.open());
+    assert(db.put(key_of(5000), "mem"));
+
+    // off by default: nothing recorded
+    assert(perf_level() == PerfLevel::Off);
+    perf_context().reset();
+    assert(db.get(key_of(900)) == "value");   // another block than the ones below
+    assert(perf_context().to_string().empty());
+
+    set_perf_level(PerfLevel::Counts);
+    perf_context().reset();
+    assert(db.get(key_of(10)) == "value");
+    const PerfContext first = perf_context();
+    assert(first.memtable_lookups == 1 && first.tables_probed == 1 && first.bloom_checks == 1);
+    assert(first.index_comparisons > 0 && first.restart_comparisons > 0 && first.entries_scanned > 0);
+    assert(first.block_reads == 1 && first.block_cache_hits == 0 && first.read_syscalls >= 1);
+    assert(first.bytes_read > 0 && first.get_nanos == 0);
+
+    perf_context().reset();   // same block again: from the cache
+    assert(db.get(key_of(11)) == "value");
+    assert(perf_context().block_cache_hits == 1 && perf_context().read_syscalls == 0);
+
+    perf_context().reset();   // memtable hit; tables untouched
+    assert(db.get(key_of(5000)) == "mem");
+    assert(perf_context().memtable_lookups == 1 && perf_context().tables_probed == 0);
+
+    set_perf_level(PerfLevel::Timings);
+    perf_context().reset();
+    assert(!db.get("key000010x"));   // in range; the filter most likely rejects it
+    assert(perf_context().get_nanos > 0 && perf_context().memtable_nanos > 0);
+    assert(perf_context().get_nanos >= perf_context().memtable_nanos + perf_context().index_seek_nanos);
+    assert(perf_context().to_string().find("get_nanos=") != std::string::npos);
+
+    // per thread: another thread's gets land in its own (off) context
+    perf_context().reset();
+    std::thread([&] {
+        assert(perf_level() == PerfLevel::Off);
+        assert(db.get(key_of(20)) == "value");
+        assert(perf_context().tables_probed == 0);
+    }).join();
+    assert(perf_context().tables_probed == 0);
+    set_perf_level(PerfLevel::Off);
+}
+
+// Even keys get a 4 KiB value (separated), odd keys a short one (inline).
+static std::string vlog_value(int round, int i) {
+    std::string v = std::to_string(round) + ":" + key_of(i);
+    if (i % 2 == 0) v += std::string(4096, static_cast<char>('a' + i % 26));
+    return v;
+}
+
+static void test_value_log() {
+    std::cout << "[T] value_log\n";
+    clean_dir("testdata");
+    EngineOptions o = small_options(false);
+    o.value_log.min_value_size = 1024;
+    auto check = [](const Engine& db, auto&& round_of) {
+        for (int i = 0; i < 200; ++i) assert(db.get(key_of(i)) == vlog_value(round_of(i), i));
+        std::vector<std::string> keys;
+        for (int i = 0; i < 200; i += 3) keys.push_back(key_of(i));
+        std::vector<std::string_view> views(keys.begin(), keys.end());
+        auto got = db.multi_get(views);
+        for (size_t j = 0; j < keys.size(); ++j) assert(got[j] == vlog_value(round_of(3 * j), 3 * j));
+        auto it = db.NewIterator();
+        int i = 0;
+        for (it->SeekToFirst(); it->Valid(); it->Next(), ++i) {
+            assert(it->key() == key_of(i) && it->value() == vlog_value(round_of(i), i));
+        }
+        assert(it->ok() && i == 200);
+    };
+    auto first_round = [](int) { return 0; };
+    auto overwritten = [](int i) { return i < 120 && i % 2 == 0 ? 1 : 0; };
+    {
+        Engine db("testdata", o);
+        assert(db.open());
+        for (int i = 0; i < 200; ++i) assert(db.put(key_of(i), vlog_value(0, i)));
+        assert(db.flush());
+        assert(count_files("testdata", ".vlog") == 1);
+        fs::path first_log;
+        uint64_t table_bytes = 0;
+        for (auto& de : fs::directory_iterator("testdata")) {
+            if (de.path().extension() == ".sst") table_bytes += fs::file_size(de.path());
+            if (de.path().extension() == ".vlog") first_log = de.path();
+        }
+        assert(table_bytes < 100 * 4096 / 10);   // only refs to the large values
+        check(db, first_round);
+        assert(db.stats().ticker(Ticker::ValueLogBytesRead) > 0);
+
+        // a snapshot reads through compactions, separated values included
+        const Snapshot* snap = db.GetSnapshot();
+        assert(db.put(key_of(198), "short now"));
+        assert(db.flush() && db.compact());
+        assert(db.get(key_of(198), snap) == vlog_value(0, 198) && db.get(key_of(198)) == "short now");
+        db.ReleaseSnapshot(snap);
+        assert(db.put(key_of(198), vlog_value(0, 198)));
+        assert(db.flush());
+
+        // overwrite 60 of the 100 large values: the first log is 60% garbage
+        // once compaction drops the old versions, and GC moves the other 40
+        for (int i = 0; i < 120; i += 2) assert(db.put(key_of(i), vlog_value(1, i)));
+        assert(db.flush() && db.compact());
+        check(db, overwritten);
+        assert(db.stats().ticker(Ticker::ValueLogGcCount) >= 1);
+        assert(db.stats().ticker(Ticker::ValueLogGcBytes) > 0);
+        assert(!fs::exists(first_log));
+    }
+    // leftovers of a crash are removed; everything else is recovered
+    std::ofstream("testdata/009999.vlog") << "partial";
+    Engine db("testdata", o);
+    assert(db.open());
+    assert(!fs::exists("testdata/009999.vlog"));
+    check(db, overwritten);
+}
+
+int main() {
+    test_flush_goes_to_l0();
+    test_compaction_merges_levels();
+    test_levels_survive_reopen();
+    test_bottommost_drops_tombstones();
+    test_background_compaction_with_readers();
+    test_open_cleans_leftovers();
+    test_version_edit_round_trip();
+    test_manifest_torn_tail();
+    test_upgrade_pre_manifest_dir();
+    test_background_flush();
+    test_queued_memtables_survive_reopen();
+    test_skiplist_memtable();
+    test_write_batch();
+    test_durability_modes();
+    test_wal_recycling();
+    test_range_scan();
+    test_multi_get();
+    test_concurrent_writers_and_readers(MemTableRep::Map);
+    test_concurrent_writers_and_readers(MemTableRep::SkipList);
+    test_snapshots();
+    test_statistics();
+    test_perf_context();
+    test_value_log();
+
+    std::cout << "All engine tests passed ✅\n";
+    return 0;
+}
@@ -0,0 +1,281 @@
+#include "arena.h"
+#include "iterator.h"
+#include "memtable.h"
+#include "skiplist.h"
+#include "write_batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::string key_of(int i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "key%06d", i);
+    return buf;
+}
+
+static const char* name_of(MemTableRep rep) { return rep == MemTableRep::Map ? "map" : "skiplist"; }
+
+static void test_basic(MemTableRep rep) {
+    std::cout << "[T] basic (" << name_of(rep) << ")\n";
+    MemTable m(rep);
+    const size_t empty_bytes = m.bytes();  // the skip list's head node is in the arena
+    assert(m.empty() && m.size() == 0);
+    assert(m.put("b", "1"));
+    assert(m.put("a", "2"));
+    assert(m.put("b", "3"));  // overwrite
+    assert(m.del("c"));       // tombstone for a key never written
+    assert(m.size() == 3 && m.bytes() > 0 && m.bytes() >= empty_bytes);
+
+    auto b = m.get("b");
+    assert(b && b->type == RecType::Put && b->value == "3");
+    auto c = m.get("c");
+    assert(c && c->type == RecType::Del && c->value.empty());
+    assert(!m.get("d"));
+
+    assert(m.del("b"));
+    b = m.get("b");
+    assert(b && b->type == RecType::Del);
+
+    m.clear();
+    assert(m.empty() && m.bytes() == empty_bytes && !m.get("a"));
+}
+
+static void test_apply_batch(MemTableRep rep) {
+    std::cout << "[T] apply_batch (" << name_of(rep) << ")\n";
+    MemTable m(rep);
+    m.put("a", "old");
+    WriteBatch b;
+    b.put("a", "1");
+    b.put("b", "2");
+    b.del("a");
+    b.put("c", "3");
+    b.put("c", "4");  // later ops win
+    assert(m.apply(b));
+    assert(m.size() == 3);
+    assert(m.get("a")->type == RecType::Del && m.get("b")->value == "2" && m.get("c")->value == "4");
+
+    WriteBatch moved(std::move(b));
+    assert(moved.count() == 5 && b.empty());  // moved-from batch is empty and usable
+    b.put("d", "5");
+    assert(m.apply(b) && m.get("d")->value == "5");
+}
+
+static void test_bytes_exact(MemTableRep rep) {
+    std::cout << "[T] bytes_exact (" << name_of(rep) << ")\n";
+    MemTable m(rep);
+    const std::string value(100, 'v');
+    for (int i = 0; i < 2000; ++i) m.put(key_of(i), value);
+    // whole 4 KiB blocks (plus bookkeeping), and at least the payload itself
+    size_t payload = 2000 * (key_of(0).size() + value.size());
+    assert(m.bytes() >= payload && m.bytes() < 4 * payload);
+    size_t before = m.bytes();
+    m.get(key_of(7));  // reads never allocate
+    assert(m.bytes() == before);
+}
+
+static void test_arena() {
+    std::cout << "[T] arena\n";
+    Arena arena;
+    assert(arena.memory_usage() == 0);
+    for (size_t align : {1, 2, 8, 16}) {
+        char* p = arena.allocate(3, align);
+        assert(reinterpret_cast<uintptr_t>(p) % align == 0);
+    }
+    char* big = arena.allocate(Arena::kBlockSize * 2);  // its own block
+    std::fill(big, big + Arena::kBlockSize * 2, 'x');
+    assert(arena.memory_usage() >= Arena::kBlockSize * 3);
+    char* s = arena.copy("hello", 5);
+    assert(std::string(s, 5) == "hello");
+
+    // concurrent allocations never overlap
+    constexpr int kThreads = 4, kPer = 5000;
+    std::vector<char*> ptrs(kThreads * kPer);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t)
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kPer; ++i) {
+                char* p = arena.allocate(24, 8);
+                std::fill(p, p + 24, static_cast<char>(t));
+                ptrs[t * kPer + i] = p;
+            }
+        });
+    for (auto& th : threads) th.join();
+    std::sort(ptrs.begin(), ptrs.end());
+    for (size_t i = 1; i < ptrs.size(); ++i) assert(ptrs[i] - ptrs[i - 1] >= 24);
+
+    arena.reset();
+    assert(arena.memory_usage() == 0);
+}
+
+static void test_snapshot_sorted(MemTableRep rep) {
+    std::cout << "[T] snapshot_sorted (" << name_of(rep) << ")\n";
+    MemTable m(rep);
+    // inserted in a scrambled order
+    for (int i = 0; i < 5000; ++i) {
+        int k = (i * 7919) % 5000;
+        if (k % 3 == 0)
+            assert(m.del(key_of(k)));
+        else
+            assert(m.put(key_of(k), "v" + std::to_string(k)));
+    }
+    std::vector<std::pair<std::string, MemValue>> snap;
+    m.snapshot(snap);
+    assert(snap.size() == 5000);
+    for (int i = 0; i < 5000; ++i) {
+        assert(snap[i].first == key_of(i));
+        assert(snap[i].second.type == (i % 3 == 0 ? RecType::Del : RecType::Put));
+        if (i % 3 != 0) assert(snap[i].second.value == "v" + std::to_string(i));
+    }
+}
+
+// Writers race on overlapping keys while readers look up keys that are
+// already in place; every key ends up with one of its writers' values.
+static void test_concurrent(MemTableRep rep) {
+    std::cout << "[T] concurrent (" << name_of(rep) << ")\n";
+    MemTable m(rep);
+    constexpr int kWriters = 4, kKeys = 4000;
+    for (int i = 0; i < kKeys; i += 2) assert(m.put(key_of(i), "base"));
+
+    std::atomic<bool> stop{false};
+    std::atomic<int> bad{0};
+    std::thread reader([&] {
+        while (!stop.load()) {
+            for (int i = 0; i < kKeys; i += 2) {
+                auto v = m.get(key_of(i));
+                if (!v || v->type != RecType::Put) bad.fetch_add(1);
+            }
+        }
+    });
+    std::vector<std::thread> writers;
+    for (int w = 0; w < kWriters; ++w) {
+        writers.emplace_back([&, w] {
+            for (int i = 0; i < kKeys; ++i) {
+                int k = (i * 31 + w * 977) % kKeys;
+                m.put(key_of(k), "w" + std::to_string(w));
+            }
+        });
+    }
+    for (auto& t : writers) t.join();
+    stop.store(true);
+    reader.join();
+    assert(bad.load() == 0);
+
+    assert(m.size() == static_cast<size_t>(kKeys));
+    std::vector<std::pair<std::string, MemValue>> snap;
+    m.snapshot(snap);
+    assert(snap.size() == static_cast<size_t>(kKeys));
+    assert(std::is_sorted(snap.begin(), snap.end(),
+                          [](const auto& a, const auto& b) { return a.first < b.first; }));
+    for (const auto& [k, v] : snap) assert(v.value.size() == 2 && v.value[0] == 'w');
+}
+
+static void test_iterator(MemTableRep rep) {
+    std::cout << "[T] iterator (" << name_of(rep) << ")\n";
+    MemTable m(rep);
+    for (int i = 0; i < 1000; ++i) assert(m.put(key_of(i), "v" + std::to_string(i)));
+    for (int i = 0; i < 1000; i += 4) assert(m.del(key_of(i)));
+
+    auto it = m.NewIterator();
+    int n = 0;
+    for (it->SeekToFirst(); it->Valid(); it->Next(), ++n) {
+        assert(it->key() == key_of(n));
+        assert(it->type() == (n % 4 == 0 ? RecType::Del : RecType::Put));  // tombstones included
+        if (n % 4) assert(it->value() == "v" + std::to_string(n));
+    }
+    assert(n == 1000 && it->ok());
+
+    it->Seek("key000500x");
+    assert(it->Valid() && it->key() == key_of(501));
+    // writes while positioned: the entry in hand stays readable
+    assert(m.put(key_of(501), "new"));
+    assert(m.put("key000501a", "inserted"));
+    assert(it->key() == key_of(501));
+    it->Next();
+    assert(it->Valid() && it->key() == "key000501a" && it->value() == "inserted");
+    it->Seek("zzz");
+    assert(!it->Valid());
+}
+
+static void test_versions(MemTableRep rep) {
+    std::cout << "[T] versions (" << name_of(rep) << ")\n";
+    MemTable m(rep);
+    assert(m.put("a", "1", 1));
+    assert(m.put("b", "b", 2));
+    assert(m.put("a", "3", 3));
+    assert(m.put("a", "3'", 3));  // same seq: replaces that version
+    assert(m.del("a", 5));
+    assert(m.size() == 2);
+
+    assert(!m.get("a", 0));
+    assert(m.get("a", 1)->value == "1" && m.get("a", 2)->value == "1");
+    auto a = m.get("a", 4);
+    assert(a && a->value == "3'" && a->seq == 3);
+    assert(m.get("a")->type == RecType::Del && m.get("a", 5)->seq == 5);
+    assert(!m.get("b", 1) && m.get("b", 2)->value == "b");
+
+    WriteBatch batch;
+    batch.put("c", "6");
+    batch.del("b");
+    batch.put("c", "8");
+    assert(m.apply(batch, 6));
+    assert(m.get("c", 6)->value == "6" && m.get("c")->value == "8" && m.get("c")->seq == 8);
+    assert(m.get("b")->type == RecType::Del && m.get("b", 6)->value == "b");
+
+    // every version, keys ascending and newest first
+    const std::vector<std::pair<std::string, SequenceNumber>> want = {
+        {"a", 5}, {"a", 3}, {"a", 1}, {"b", 7}, {"b", 2}, {"c", 8}, {"c", 6}};
+    std::vector<std::pair<std::string, MemValue>> snap;
+    m.snapshot(snap);
+    assert(snap.size() == want.size());
+    for (size_t i = 0; i < want.size(); ++i) assert(snap[i].first == want[i].first && snap[i].second.seq == want[i].second);
+    auto it = m.NewIterator();
+    size_t n = 0;
+    for (it->SeekToFirst(); it->Valid(); it->Next(), ++n) assert(it->key() == want[n].first && it->seq() == want[n].second);
+    assert(n == want.size());
+    it->Seek("b");
+    assert(it->Valid() && it->key() == "b" && it->seq() == 7);
+}
+
+static void test_skiplist_iter() {
+    std::cout << "[T] skiplist_iter\n";
+    SkipList list;
+    for (int i = 0; i < 100; i += 2) list.upsert(key_of(i), RecType::Put, "v");
+    list.upsert(key_of(10), RecType::Del, "");
+
+    SkipList::Iter it(&list);
+    it.Seek(key_of(9));
+    assert(it.Valid() && it.key() == key_of(10) && it.value()->type == RecType::Del);
+    assert(it.value()->prev && it.value()->prev->type == RecType::Put);  // replaced version
+    it.Next();
+    assert(it.Valid() && it.key() == key_of(12));
+    it.Seek("zzz");
+    assert(!it.Valid());
+
+    int n = 0;
+    for (it.SeekToFirst(); it.Valid(); it.Next()) ++n;
+    assert(n == 50 && list.size() == 50);
+}
+
+int main() {
+    for (MemTableRep rep : {MemTableRep::Map, MemTableRep::SkipList}) {
+        test_basic(rep);
+        test_snapshot_sorted(rep);
+        test_concurrent(rep);
+        test_bytes_exact(rep);
+        test_apply_batch(rep);
+        test_iterator(rep);
+        test_versions(rep);
+    }
+    test_skiplist_iter();
+    test_arena();
+
+    std::cout << "All MemTable tests passed ✅\n";
+    return 0;
+}
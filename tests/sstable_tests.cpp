@@ -0,0 +1,591 @@
+#include "sstable.h"
+
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static void clean_dir(const fs::path& p) {
+    std::error_code ec;
+    fs::remove_all(p, ec);
+    fs::create_directories(p, ec);
+    (void)ec;
+}
+
+static std::string key_of(int i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "key%06d", i);
+    return buf;
+}
+
+// 1000 entries (several data blocks); every 7th key is a tombstone.
+static std::string build_table(const fs::path& dir, const SSTableOptions& opts = {}) {
+    std::vector<std::pair<std::string, MemValue>> entries;
+    for (int i = 0; i < 1000; ++i) {
+        if (i % 7 == 0)
+            entries.emplace_back(key_of(i), MemValue{RecType::Del, ""});
+        else
+            entries.emplace_back(key_of(i), MemValue{RecType::Put, "v" + std::to_string(i)});
+    }
+    std::string path;
+    assert(SSTable::Build(dir.string(), 1, entries, &path, opts));
+    return path;
+}
+
+static void check_lookups(const SSTable& t) {
+    for (int i = 0; i < 1000; ++i) {
+        std::string out;
+        auto kind = t.Probe(key_of(i), &out);
+        if (i % 7 == 0) {
+            assert(kind == SSTable::ProbeKind::Tombstone);
+            assert(!t.Get(key_of(i)));
+        } else {
+            assert(kind == SSTable::ProbeKind::Put && out == "v" + std::to_string(i));
+            auto v = t.Get(key_of(i));
+            assert(v && *v == out);
+        }
+    }
+    // before the first key, between keys, past the last key
+    assert(t.Probe("a", nullptr) == SSTable::ProbeKind::Absent);
+    assert(t.Probe("key000001x", nullptr) == SSTable::ProbeKind::Absent);
+    assert(t.Probe("zzz", nullptr) == SSTable::ProbeKind::Absent);
+}
+
+static void test_syscall_lookups() {
+    std::cout << "[T] syscall_lookups\n";
+    clean_dir("testdata");
+    auto path = build_table("testdata");
+    SSTable t;
+    assert(t.Open(path, {SSTReadMode::Syscall}));
+    assert(t.read_mode() == SSTReadMode::Syscall);
+    check_lookups(t);
+}
+
+static void test_mmap_lookups() {
+    std::cout << "[T] mmap_lookups\n";
+    clean_dir("testdata");
+    auto path = build_table("testdata");
+    SSTable t;
+    assert(t.Open(path, {SSTReadMode::Mmap}));
+    assert(t.read_mode() == SSTReadMode::Mmap);
+    check_lookups(t);
+}
+
+static void test_mmap_survives_unlink() {
+    std::cout << "[T] mmap_survives_unlink\n";
+    clean_dir("testdata");
+    auto path = build_table("testdata");
+    SSTable t;
+    assert(t.Open(path, {SSTReadMode::Mmap}));
+    fs::remove(path);
+    check_lookups(t);  // mapping outlives the directory entry
+}
+
+// Hand-written V0 table (pre-filter format), as found in older data dirs.
+static void write_v0_table(const fs::path& p) {
+    std::string f;
+    auto u32 = [&](uint32_t v) { f.append(reinterpret_cast<const char*>(&v), 4); };
+    auto u64 = [&](uint64_t v) { f.append(reinterpret_cast<const char*>(&v), 8); };
+    u32(0x4B565354);
+    u32(1);
+    const uint64_t first = f.size();
+    for (auto [k, t, v] : {std::tuple{"a", 1, "1"}, {"b", 2, ""}, {"c", 1, "3"}}) {
+        u32(1);
+        f.push_back(static_cast<char>(t));
+        u32(static_cast<uint32_t>(std::strlen(v)));
+        f += k;
+        f += v;
+    }
+    const uint64_t index_off = f.size();
+    u32(1);
+    f += "a";
+    u64(first);
+    u64(index_off);
+    u32(1);
+    u32(0x4B565354);
+    u32(1);
+    FILE* out = std::fopen(p.c_str(), "wb");
+    std::fwrite(f.data(), 1, f.size(), out);
+    std::fclose(out);
+}
+
+static void test_v0_still_readable() {
+    std::cout << "[T] v0_still_readable\n";
+    clean_dir("testdata");
+    const fs::path p = "testdata/000001.sst";
+    write_v0_table(p);
+    for (auto mode : {SSTReadMode::Syscall, SSTReadMode::Mmap}) {
+        SSTable t;
+        assert(t.Open(p.string(), {mode}));
+        assert(t.format_version() == 1 && !t.has_filter());
+        auto a = t.Get("a");
+        assert(a && *a == "1");
+        assert(t.Probe("b", nullptr) == SSTable::ProbeKind::Tombstone);
+        auto c = t.Get("c");
+        assert(c && *c == "3");
+        assert(t.Probe("d", nullptr) == SSTable::ProbeKind::Absent);
+    }
+}
+
+static void test_bloom_filter() {
+    std::cout << "[T] bloom_filter\n";
+    clean_dir("testdata");
+    auto path = build_table("testdata");
+
+    FilterStats stats;
+    SSTableOptions opts;
+    opts.filter_stats = &stats;
+    SSTable t;
+    assert(t.Open(path, opts));
+    assert(t.has_filter());
+    check_lookups(t);  // no false negatives, tombstones included
+
+    const uint64_t useful_before = stats.useful.load();
+    int maybe = 0;
+    for (int i = 0; i < 10000; ++i) {
+        std::string k = "missing" + std::to_string(i);
+        if (t.MayContain(k)) ++maybe;
+        assert(t.Probe(k, nullptr) == SSTable::ProbeKind::Absent);
+    }
+    assert(maybe < 300);  // ~1% expected at 10 bits/key
+    assert(stats.useful.load() - useful_before == uint64_t(10000 - maybe));
+    assert(stats.false_positive.load() >= uint64_t(maybe));
+}
+
+static void test_build_without_filter() {
+    std::cout << "[T] build_without_filter\n";
+    clean_dir("testdata");
+    std::vector<std::pair<std::string, MemValue>> entries = {
+        {"a", MemValue{RecType::Put, "1"}}, {"b", MemValue{RecType::Put, "2"}}};
+    SSTableOptions opts;
+    opts.bloom_bits_per_key = 0;
+    std::string path;
+    assert(SSTable::Build("testdata", 2, entries, &path, opts));
+    SSTable t;
+    assert(t.Open(path));
+    assert(!t.has_filter());
+    auto b = t.Get("b");
+    assert(b && *b == "2");
+}
+
+static void test_v2_block_layouts() {
+    std::cout << "[T] v2_block_layouts\n";
+    // tiny blocks / every entry a restart / one huge block
+    for (auto [block_size, restart] : {std::pair<size_t, int>{64, 2}, {256, 1}, {1 << 20, 16}}) {
+        clean_dir("testdata");
+        SSTableOptions opts;
+        opts.block_size = block_size;
+        opts.block_restart_interval = restart;
+        auto path = build_table("testdata", opts);
+        for (auto mode : {SSTReadMode::Syscall, SSTReadMode::Mmap}) {
+            SSTable t;
+            assert(t.Open(path, {mode}));
+            assert(t.format_version() == 4 && t.num_entries() == 1000);
+            if (block_size == 64) assert(t.index_size() > 100);
+            if (block_size == (1 << 20)) assert(t.index_size() == 1);
+            check_lookups(t);
+        }
+    }
+}
+
+static void test_empty_table() {
+    std::cout << "[T] empty_table\n";
+    clean_dir("testdata");
+    std::string path;
+    assert(SSTable::Build("testdata", 3, {}, &path));
+    SSTable t;
+    assert(t.Open(path));
+    assert(t.index_size() == 0 && t.num_entries() == 0);
+    assert(t.Probe("a", nullptr) == SSTable::ProbeKind::Absent);
+}
+
+static void test_block_checksum() {
+    std::cout << "[T] block_checksum\n";
+    clean_dir("testdata");
+    auto path = build_table("testdata");
+    {
+        // flip a byte in a data block around the middle of the file
+        const long off = static_cast<long>(fs::file_size(path) / 2);
+        FILE* f = std::fopen(path.c_str(), "r+b");
+        std::fseek(f, off, SEEK_SET);
+        int c = std::fgetc(f);
+        std::fseek(f, off, SEEK_SET);
+        std::fputc(c ^ 0x5a, f);
+        std::fclose(f);
+    }
+    SSTableOptions opts;
+    opts.verify_checksums = true;
+    for (auto mode : {SSTReadMode::Syscall, SSTReadMode::Mmap}) {
+        opts.read_mode = mode;
+        SSTable t;
+        assert(t.Open(path, opts));
+        int missing = 0;
+        for (int i = 1; i < 1000; i += 7) missing += t.Get(key_of(i)) ? 0 : 1;
+        assert(missing > 0);        // the damaged block is rejected
+        assert(t.Get(key_of(1)));   // other blocks are fine
+
+        auto it = t.NewIterator();
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        }
+        assert(!it->ok());  // scans report the corruption
+    }
+}
+
+static void test_iterator() {
+    std::cout << "[T] iterator\n";
+    clean_dir("testdata");
+    SSTableOptions small;
+    small.block_size = 128;
+    auto v2 = build_table("testdata", small);
+    write_v0_table("testdata/000002.sst");
+
+    for (auto mode : {SSTReadMode::Syscall, SSTReadMode::Mmap}) {
+        SSTable t;
+        assert(t.Open(v2, {mode}));
+        assert(t.smallest_key() == key_of(0) && t.largest_key() == key_of(999));
+
+        auto it = t.NewIterator();
+        int n = 0;
+        for (it->SeekToFirst(); it->Valid(); it->Next(), ++n) {
+            assert(it->key() == key_of(n));
+            assert(it->type() == (n % 7 == 0 ? RecType::Del : RecType::Put));
+            if (n % 7) assert(it->value() == "v" + std::to_string(n));
+        }
+        assert(n == 1000 && it->ok());
+
+        it->Seek(key_of(500));
+        assert(it->Valid() && it->key() == key_of(500));
+        it->Seek("key000500x");  // between keys
+        assert(it->Valid() && it->key() == key_of(501));
+        it->Seek("a");
+        assert(it->Valid() && it->key() == key_of(0));
+        it->Seek("zzz");
+        assert(!it->Valid() && it->ok());
+
+        SSTable old;
+        assert(old.Open("testdata/000002.sst", {mode}));
+        assert(old.smallest_key() == "a" && old.largest_key() == "c");
+        auto oi = old.NewIterator();
+        std::string keys;
+        for (oi->SeekToFirst(); oi->Valid(); oi->Next()) keys += oi->key();
+        assert(keys == "abc");
+        oi->Seek("b");
+        assert(oi->Valid() && oi->key() == "b" && oi->type() == RecType::Del);
+    }
+}
+
+static void test_merging_iterator() {
+    std::cout << "[T] merging_iterator\n";
+    clean_dir("testdata");
+    // newer: a=new, c=del ; older: a=old, b, c, d
+    std::string newer, older;
+    assert(SSTable::Build("testdata", 2,
+                          {{"a", MemValue{RecType::Put, "new"}}, {"c", MemValue{RecType::Del, ""}}}, &newer));
+    assert(SSTable::Build("testdata", 1,
+                          {{"a", MemValue{RecType::Put, "old"}},
+                           {"b", MemValue{RecType::Put, "b"}},
+                           {"c", MemValue{RecType::Put, "c"}},
+                           {"d", MemValue{RecType::Put, "d"}}},
+                          &older));
+    SSTable tn, to;
+    assert(tn.Open(newer) && to.Open(older));
+    std::vector<std::unique_ptr<Iterator>> children;
+    children.push_back(tn.NewIterator());
+    children.push_back(to.NewIterator());
+    auto m = NewMergingIterator(std::move(children));
+
+    std::string seen;
+    for (m->SeekToFirst(); m->Valid(); m->Next()) {
+        seen += std::string(m->key()) + (m->type() == RecType::Del ? "-" : "=" + std::string(m->value())) + ";";
+    }
+    assert(seen == "a=new;a=old;b=b;c-;c=c;d=d;");
+
+    m->Seek("b");
+    assert(m->Valid() && m->key() == "b");
+    m->Seek("c");
+    assert(m->Valid() && m->key() == "c" && m->type() == RecType::Del);
+}
+
+static void test_iterator_upper_bound() {
+    std::cout << "[T] iterator_upper_bound\n";
+    clean_dir("testdata");
+    SSTableOptions small;
+    small.block_size = 128;
+    auto path = build_table("testdata", small);
+
+    BlockCache cache(1 << 20);
+    small.read_mode = SSTReadMode::Syscall;
+    small.block_cache = &cache;
+    SSTable t;
+    assert(t.Open(path, small));
+
+    // the bound only limits which blocks are read; keys past it in the
+    // last block read are still yielded
+    auto it = t.NewIterator(true, key_of(100));
+    int n = 0;
+    for (it->Seek(key_of(50)); it->Valid() && it->key() < key_of(100); it->Next()) ++n;
+    assert(n == 50 && it->ok());
+    for (; it->Valid(); it->Next()) assert(it->key() >= key_of(100));
+    assert(it->ok());
+    const uint64_t bounded = cache.stats().misses;
+    assert(bounded > 0 && bounded * 4 < t.index_size());
+
+    // the same scan unbounded reads to the end of the table
+    auto all = t.NewIterator(false);
+    for (all->Seek(key_of(50)); all->Valid(); all->Next()) {
+    }
+    assert(cache.stats().misses > bounded * 4);
+}
+
+static void test_multi_probe() {
+    std::cout << "[T] multi_probe\n";
+    clean_dir("testdata");
+    SSTableOptions small;
+    small.block_size = 128;
+    auto path = build_table("testdata", small);
+    write_v0_table("testdata/000002.sst");
+
+    BlockCache cache(1 << 20);
+    small.read_mode = SSTReadMode::Syscall;
+    small.block_cache = &cache;
+    SSTable t;
+    assert(t.Open(path, small));
+
+    // every key, some absent ones in between: same answers as Probe
+    std::vector<std::string> owned;
+    for (int i = 0; i < 1000; ++i) {
+        owned.push_back(key_of(i));
+        if (i % 100 == 0) owned.push_back(key_of(i) + "x");
+    }
+    owned.push_back("zzz");
+    std::vector<std::string_view> keys(owned.begin(), owned.end());
+    std::vector<SSTable::ProbeKind> kinds;
+    std::vector<std::string> outs;
+    t.MultiProbe(keys, &kinds, &outs);
+    assert(kinds.size() == keys.size() && outs.size() == keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        std::string out;
+        assert(kinds[i] == t.Probe(keys[i], &out));
+        if (kinds[i] == SSTable::ProbeKind::Put) assert(outs[i] == out);
+    }
+
+    // a sorted run within few blocks reads each block once
+    SSTable u;
+    BlockCache fresh(1 << 20);
+    small.block_cache = &fresh;
+    assert(u.Open(path, small));
+    std::vector<std::string_view> run(keys.begin() + 200, keys.begin() + 260);
+    u.MultiProbe(run, &kinds, &outs);
+    auto st = fresh.stats();
+    assert(st.misses > 0 && st.misses * 5 < run.size() && st.hits == 0);
+
+    SSTable old;
+    assert(old.Open("testdata/000002.sst", {SSTReadMode::Syscall}));
+    std::vector<std::string_view> abc = {"a", "b", "bb", "c"};
+    old.MultiProbe(abc, &kinds, &outs);
+    assert(kinds[0] == old.Probe("a", nullptr) && kinds[1] == SSTable::ProbeKind::Tombstone);
+    assert(kinds[2] == SSTable::ProbeKind::Absent && kinds[3] == old.Probe("c", nullptr));
+}
+
+// Versions of one key spread over many blocks; probes pick the one each
+// snapshot sees.
+static void test_versions() {
+    std::cout << "[T] versions\n";
+    clean_dir("testdata");
+    std::vector<std::pair<std::string, MemValue>> entries;
+    entries.emplace_back("a", MemValue{RecType::Put, "a", 7});
+    for (SequenceNumber s = 100; s >= 1; --s) {
+        if (s == 50)
+            entries.emplace_back("k", MemValue{RecType::Del, "", s});
+        else
+            entries.emplace_back("k", MemValue{RecType::Put, "v" + std::to_string(s), s});
+    }
+    entries.emplace_back("z", MemValue{RecType::Put, "z", 3});
+    SSTableOptions opts;
+    opts.block_size = 64;
+    std::string path;
+    assert(SSTable::Build("testdata", 1, entries, &path, opts));
+
+    for (auto mode : {SSTReadMode::Syscall, SSTReadMode::Mmap}) {
+        opts.read_mode = mode;
+        SSTable t;
+        assert(t.Open(path, opts));
+        assert(t.num_entries() == 102 && t.index_size() > 10);
+        assert(t.smallest_key() == "a" && t.largest_key() == "z");
+        std::string out;
+        assert(t.Probe("k", &out, 0) == SSTable::ProbeKind::Absent);
+        assert(t.Probe("a", &out, 6) == SSTable::ProbeKind::Absent);
+        for (SequenceNumber s = 1; s <= 120; ++s) {
+            auto kind = t.Probe("k", &out, s);
+            if (s == 50) {
+                assert(kind == SSTable::ProbeKind::Tombstone);
+            } else {
+                assert(kind == SSTable::ProbeKind::Put && out == "v" + std::to_string(std::min<SequenceNumber>(s, 100)));
+            }
+        }
+        assert(t.Get("k") == "v100");
+
+        std::vector<std::string_view> keys = {"a", "k", "z"};
+        std::vector<SSTable::ProbeKind> kinds;
+        std::vector<std::string> outs;
+        t.MultiProbe(keys, &kinds, &outs, 30);
+        assert(kinds[0] == SSTable::ProbeKind::Put && kinds[1] == SSTable::ProbeKind::Put && outs[1] == "v30");
+        assert(kinds[2] == SSTable::ProbeKind::Put);
+
+        // the iterator yields every version, newest first
+        auto it = t.NewIterator();
+        SequenceNumber want = 100;
+        it->Seek("k");
+        for (; it->Valid() && it->key() == "k"; it->Next()) assert(it->seq() == want--);
+        assert(want == 0 && it->Valid() && it->key() == "z" && it->seq() == 3);
+    }
+
+    // a repeated key must come with a lower seq
+    SSTableBuilder b("testdata", 2);
+    assert(b.open());
+    assert(b.add("k", RecType::Put, "x", 5));
+    assert(!b.add("k", RecType::Put, "y", 5));
+    assert(!b.add("k", RecType::Put, "y", 6));
+    assert(b.add("k", RecType::Put, "y", 4));
+}
+
+static void test_block_cache() {
+    std::cout << "[T] block_cache\n";
+    clean_dir("testdata");
+    auto path = build_table("testdata");
+
+    BlockCache cache(1 << 20);
+    SSTableOptions opts;
+    opts.read_mode = SSTReadMode::Syscall;
+    opts.block_cache = &cache;
+    SSTable t;
+    assert(t.Open(path, opts));
+
+    check_lookups(t);
+    auto first = cache.stats();
+    assert(first.inserts > 0 && first.inserts <= first.misses);
+    assert(first.inserts <= t.index_size());  // at most one insert per block
+
+    check_lookups(t);  // everything is resident now
+    auto second = cache.stats();
+    assert(second.misses == first.misses && second.hits > first.hits);
+    assert(second.evictions == 0 && second.usage <= second.capacity);
+
+    // a cache far smaller than the table keeps evicting but stays correct
+    BlockCache tiny(8 * 1024, 1);
+    opts.block_cache = &tiny;
+    SSTable u;
+    assert(u.Open(path, opts));
+    check_lookups(u);
+    auto st = tiny.stats();
+    assert(st.evictions > 0 && st.usage <= st.capacity);
+}
+
+static void test_reject_bad_file() {
+    std::cout << "[T] reject_bad_file\n";
+    clean_dir("testdata");
+    const fs::path p = "testdata/000009.sst";
+    {
+        FILE* f = std::fopen(p.c_str(), "wb");
+        std::fputs("not an sstable at all", f);
+        std::fclose(f);
+    }
+    SSTable a, b;
+    assert(!a.Open(p.string(), {SSTReadMode::Syscall}));
+    assert(!b.Open(p.string(), {SSTReadMode::Mmap}));
+}
+
+static void test_value_refs() {
+    std::cout << "[T] value_refs\n";
+    clean_dir("testdata");
+    // a value log with a few large values, then a table pointing into it
+    ValueLogBuilder vb("testdata", 7);
+    assert(vb.open());
+    std::vector<std::pair<std::string, MemValue>> entries;
+    uint64_t referenced = 0;
+    for (int i = 0; i < 100; ++i) {
+        MemValue mv{RecType::Put, "small" + std::to_string(i), 0};
+        if (i % 2 == 0) {
+            ValueRef ref;
+            assert(vb.add(key_of(i), std::string(5000, static_cast<char>('a' + i % 26)), &ref));
+            assert(ref.number == 7 && ref.size == ValueLog::kRecordHeaderSize + key_of(i).size() + 5000);
+            referenced += ref.size;
+            mv.type = RecType::ValueRef;
+            mv.value.clear();
+            ref.encode(&mv.value);
+        }
+        entries.emplace_back(key_of(i), std::move(mv));
+    }
+    std::string log_path;
+    assert(vb.finish(&log_path) && log_path == ValueLog::file_name_for("testdata", 7));
+    ValueLog log;
+    assert(log.Open(log_path, 7) && log.data_bytes() == referenced);
+
+    SSTableBuilder b("testdata", 1);
+    assert(b.open());
+    for (const auto& [k, mv] : entries) assert(b.add(k, mv.type, mv.value, mv.seq));
+    assert(b.value_logs().size() == 1 && b.value_logs()[0].number == 7 && b.value_logs()[0].bytes == referenced);
+    assert(!b.add(key_of(200), RecType::ValueRef, "not a ref"));
+    std::string path;
+    assert(b.finish(&path));
+
+    SSTable t;
+    assert(t.Open(path, {SSTReadMode::Syscall}));
+    assert(t.file_size() < referenced / 10);   // the values stayed out of the table
+    std::string out, value;
+    assert(t.Probe(key_of(3), &out) == SSTable::ProbeKind::Put && out == "small3");
+    assert(t.Probe(key_of(4), &out) == SSTable::ProbeKind::ValueRef);
+    ValueRef ref;
+    assert(ref.decode(out) && log.Read(ref, &value) && value == std::string(5000, 'e'));
+    assert(!t.Get(key_of(4)));   // only the engine can resolve it
+
+    auto it = t.NewIterator();
+    size_t refs = 0;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) refs += it->type() == RecType::ValueRef;
+    assert(it->ok() && refs == 50);
+
+    // out-of-range refs and damaged records are rejected
+    ValueRef bad = ref;
+    bad.size -= 1;
+    assert(!log.Read(bad, &value));
+    bad = ref;
+    bad.offset = log.file_size();
+    assert(!log.Read(bad, &value));
+    {
+        FILE* f = std::fopen(log_path.c_str(), "r+b");
+        std::fseek(f, static_cast<long>(ref.offset + ref.size - 1), SEEK_SET);
+        std::fputc('!', f);
+        std::fclose(f);
+    }
+    ValueLog damaged;
+    assert(damaged.Open(log_path, 7) && !damaged.Read(ref, &value));
+}
+
+int main() {
+    test_syscall_lookups();
+    test_mmap_lookups();
+    test_mmap_survives_unlink();
+    test_v0_still_readable();
+    test_bloom_filter();
+    test_build_without_filter();
+    test_v2_block_layouts();
+    test_empty_table();
+    test_block_checksum();
+    test_block_cache();
+    test_iterator();
+    test_merging_iterator();
+    test_iterator_upper_bound();
+    test_multi_probe();
+    test_versions();
+    test_value_refs();
+    test_reject_bad_file();
+
+    std::cout << "All SSTable tests passed ✅\n";
+    return 0;
+}
@@ -1,14 +1,19 @@
+#include "crc32c.h"
 #include "memtable.h"
+#include "utils.h"
 #include "wal.h"
 
 #include <cassert>
 #include <chrono>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <random>
 #include <string>
 #include <system_error>
+#include <thread>
+#include <vector>
 #include <fcntl.h>
 #include <unistd.h>
 
@@ -221,6 +226,288 @@ static void test_large_keys_values() {
     assert(v && v->type == RecType::Put && v->value == bigV);
 }
 
+static void test_group_commit() {
+    std::cout << "[T] group_commit\n";
+    clean_dir("testdata");
+    const fs::path walp = "testdata/wal.log";
+
+    constexpr int kThreads = 8, kPer = 200;
+    {
+        WAL wal(walp.string());
+        assert(wal.open());
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t)
+            threads.emplace_back([&, t] {
+                for (int i = 0; i < kPer; ++i) {
+                    std::string k = "t" + std::to_string(t) + ":" + std::to_string(i);
+                    bool sync = i % 2 == 0;
+                    assert(i % 10 == 9 ? wal.appendDel(k, sync) : wal.appendPut(k, "v" + k, sync));
+                }
+            });
+        for (auto& th : threads) th.join();
+        // every record went out in some group; never more syncs than sync requests
+        assert(wal.groups() >= 1 && wal.groups() <= static_cast<uint64_t>(kThreads * kPer));
+        assert(wal.syncs() >= 1 && wal.syncs() <= static_cast<uint64_t>(kThreads * kPer / 2));
+        assert(wal.sync());
+    }
+
+    MemTable mem;
+    WAL rdr(walp.string());
+    assert(rdr.open());
+    assert(rdr.replay(mem));
+    assert(mem.size() == static_cast<size_t>(kThreads * kPer));
+    for (int t = 0; t < kThreads; ++t)
+        for (int i = 0; i < kPer; ++i) {
+            std::string k = "t" + std::to_string(t) + ":" + std::to_string(i);
+            auto v = mem.get(k);
+            assert(v && (i % 10 == 9 ? v->type == RecType::Del : v->value == "v" + k));
+        }
+}
+
+static void test_crc32c() {
+    std::cout << "[T] crc32c (hardware=" << crc32c::hardware() << ")\n";
+    // RFC 3720 / iSCSI check values
+    assert(crc32c::value("123456789") == 0xE3069283);
+    assert(crc32c::value(std::string(32, '\0')) == 0x8A9136AA);
+    assert(crc32c::value(std::string(32, '\xff')) == 0x62A8AB43);
+
+    std::string data = rand_string(1000);
+    uint32_t whole = crc32c::value(data);
+    for (size_t cut : {0, 1, 7, 8, 333, 1000}) {
+        uint32_t c = crc32c::extend(0, data.data(), cut);
+        assert(crc32c::extend(c, data.data() + cut, data.size() - cut) == whole);
+        c = crc32c::extend_portable(0, data.data(), cut);
+        assert(crc32c::extend_portable(c, data.data() + cut, data.size() - cut) == whole);
+    }
+}
+
+static void test_v1_log_replays() {
+    std::cout << "[T] v1_log_replays\n";
+    clean_dir("testdata");
+    const fs::path walp = "testdata/wal.log";
+
+    // hand-written v1 log: klen | key | type | vlen | value | crc32
+    auto v1_record = [](const std::string& key, RecType t, const std::string& val) {
+        std::string r;
+        uint32_t klen = key.size(), vlen = val.size();
+        r.append(reinterpret_cast<const char*>(&klen), 4);
+        r += key;
+        r.push_back(static_cast<char>(t));
+        r.append(reinterpret_cast<const char*>(&vlen), 4);
+        // v1 checksummed a Del's value bytes as zeros
+        std::string summed = r + (t == RecType::Put ? val : std::string(vlen, '\0'));
+        r += val;
+        uint32_t crc = compute_crc32(summed);
+        r.append(reinterpret_cast<const char*>(&crc), 4);
+        return r;
+    };
+    {
+        std::ofstream out(walp, std::ios::binary);
+        uint32_t hdr[2] = {0x4B56574C, 1};
+        out.write(reinterpret_cast<const char*>(hdr), sizeof(hdr));
+        out << v1_record("a", RecType::Put, "1") << v1_record("b", RecType::Put, "2")
+            << v1_record("a", RecType::Del, "") << v1_record("d", RecType::Del, "junk");
+    }
+
+    WAL wal(walp.string());
+    assert(wal.open());
+    MemTable mem;
+    assert(wal.replay(mem));
+    auto a = mem.get("a");
+    auto b = mem.get("b");
+    assert(a && a->type == RecType::Del && b && b->value == "2");
+    auto d = mem.get("d");
+    assert(d && d->type == RecType::Del);
+
+    // v1 logs are replay-only until reset, which starts a v2 log
+    assert(!wal.appendPut("c", "3"));
+    assert(wal.reset());
+    assert(wal.appendPut("c", "3"));
+    MemTable mem2;
+    assert(wal.replay(mem2));
+    assert(mem2.size() == 1 && mem2.get("c")->value == "3");
+}
+
+// v4 records carry their seqs; ops of older logs are numbered on from last_seq.
+static void test_sequence_replay() {
+    std::cout << "[T] sequence_replay\n";
+    clean_dir("testdata");
+    const fs::path walp = "testdata/wal.log";
+    {
+        WAL wal(walp.string());
+        assert(wal.open());
+        assert(wal.appendPut("a", "1", false, 5));
+        WriteBatch b;
+        b.put("a", "2");
+        b.put("b", "1");
+        assert(wal.appendBatch(b, false, 6));
+        assert(wal.appendDel("a", false, 8));
+        assert(wal.appendPut("c", "1", false, 20));  // a gap: another chunk
+    }
+    MemTable mem;
+    WAL rdr(walp.string());
+    assert(rdr.open());
+    SequenceNumber last = 0;
+    assert(rdr.replay(mem, &last));
+    assert(last == 20);
+    assert(mem.get("a", 5)->value == "1" && mem.get("a", 6)->value == "2" && mem.get("a", 7)->value == "2");
+    assert(mem.get("a")->type == RecType::Del && mem.get("b")->seq == 7 && mem.get("c")->seq == 20);
+    assert(!mem.get("c", 19) && !mem.get("a", 4));
+
+    // a v3 log (no seqs in its records): replayed ops take last+1, last+2, ...
+    {
+        uint32_t hdr[2] = {0x4B56574C, 3};
+        auto v3_record = [](const std::string& key, const std::string& val) {
+            std::string r(13, '\0');
+            r[4] = static_cast<char>(RecType::Put);
+            uint32_t klen = key.size(), vlen = val.size();
+            std::memcpy(&r[5], &klen, 4);
+            std::memcpy(&r[9], &vlen, 4);
+            r += key + val;
+            uint32_t crc = crc32c::extend(crc32c::value(std::string(8, '\0')), r.data() + 4, r.size() - 4);
+            std::memcpy(&r[0], &crc, 4);
+            return r;
+        };
+        std::ofstream out("testdata/old.log", std::ios::binary);
+        out.write(reinterpret_cast<const char*>(hdr), sizeof(hdr));
+        out << v3_record("x", "1") << v3_record("x", "2");
+    }
+    WAL old("testdata/old.log");
+    assert(old.open());
+    assert(old.replay(mem, &last));
+    assert(last == 22 && mem.get("x", 21)->value == "1" && mem.get("x")->value == "2");
+}
+
+static void test_corruption_stops_replay() {
+    std::cout << "[T] corruption_stops_replay\n";
+    clean_dir("testdata");
+    const fs::path walp = "testdata/wal.log";
+
+    {
+        WAL wal(walp.string());
+        assert(wal.open());
+        assert(wal.appendPut("k1", "v1"));
+        assert(wal.appendPut("k2", "v2"));
+        assert(wal.appendPut("k3", "v3"));
+        assert(wal.sync());
+    }
+    // each record is header + 2 + 2 bytes; flip a value byte of the second
+    const off_t second = 8 + WAL::kRecordHeader + 4;
+    int fd = ::open(walp.c_str(), O_RDWR);
+    assert(fd >= 0);
+    char c = 'X';
+    assert(::pwrite(fd, &c, 1, second + WAL::kRecordHeader + 3) == 1);
+    ::close(fd);
+
+    MemTable mem;
+    WAL rdr(walp.string());
+    assert(rdr.open());
+    assert(rdr.replay(mem));
+    assert(mem.get("k1") && !mem.get("k2") && !mem.get("k3"));
+}
+
+static void test_batch_all_or_nothing() {
+    std::cout << "[T] batch_all_or_nothing\n";
+    clean_dir("testdata");
+    const fs::path walp = "testdata/wal.log";
+
+    {
+        WAL wal(walp.string());
+        assert(wal.open());
+        assert(wal.appendPut("before", "1"));
+        WriteBatch b;
+        for (int i = 0; i < 100; ++i) b.put("b" + std::to_string(i), std::string(50, 'x'));
+        b.del("before");
+        assert(b.count() == 101);
+        assert(wal.appendBatch(b, true));
+
+        b.clear();  // reused for a second, smaller batch
+        assert(b.empty());
+        b.put("second", "2");
+        assert(wal.appendBatch(b));
+        assert(wal.sync());
+    }
+    {
+        MemTable mem;
+        WAL rdr(walp.string());
+        assert(rdr.open());
+        assert(rdr.replay(mem));
+        assert(mem.size() == 102);
+        assert(mem.get("before")->type == RecType::Del && mem.get("b99")->value == std::string(50, 'x'));
+        assert(mem.get("second")->value == "2");
+    }
+
+    // Tear the first batch: the lone put survives, nothing of the batch does
+    size_t second_batch = WAL::kRecordHeader + 4 + 1 + 1 + 6 + 1 + 1;
+    truncate_bytes_from_end(walp, second_batch + 10);
+    MemTable mem;
+    WAL rdr(walp.string());
+    assert(rdr.open());
+    assert(rdr.replay(mem));
+    assert(mem.size() == 1 && mem.get("before")->value == "1");
+}
+
+static void test_preallocated_segment() {
+    std::cout << "[T] preallocated_segment\n";
+    clean_dir("testdata");
+    const fs::path walp = "testdata/000007.log";
+
+    {
+        WAL wal(walp.string(), 7);
+        assert(wal.open(64 * 1024));
+        assert(wal.appendPut("a", "1"));
+        assert(wal.sync());
+    }
+    assert(local_file_size(walp) == 64 * 1024);  // appends did not grow it
+    {
+        // reopening appends after the last record, not at the file's end
+        WAL wal(walp.string(), 7);
+        assert(wal.open(64 * 1024));
+        assert(wal.appendPut("b", "2"));
+        assert(wal.sync());
+    }
+    assert(local_file_size(walp) == 64 * 1024);
+
+    MemTable mem;
+    WAL rdr(walp.string(), 7);
+    assert(rdr.open());
+    assert(rdr.replay(mem));
+    assert(mem.size() == 2 && mem.get("a")->value == "1" && mem.get("b")->value == "2");
+}
+
+static void test_recycled_segment() {
+    std::cout << "[T] recycled_segment\n";
+    clean_dir("testdata");
+    const fs::path old_path = "testdata/000003.log", new_path = "testdata/000009.log";
+
+    {
+        WAL wal(old_path.string(), 3);
+        assert(wal.open());
+        for (int i = 0; i < 50; ++i) assert(wal.appendPut("old" + std::to_string(i), std::string(40, 'o')));
+        assert(wal.sync());
+    }
+    fs::rename(old_path, new_path);
+    const size_t recycled_size = local_file_size(new_path);
+
+    // Nothing written yet under the new number: the old records do not count
+    {
+        WAL wal(new_path.string(), 9);
+        assert(wal.open());
+        MemTable mem;
+        assert(wal.replay(mem));
+        assert(mem.empty());
+        assert(wal.appendPut("new", "1"));  // overwrites the first old record
+        assert(wal.sync());
+    }
+    assert(local_file_size(new_path) == recycled_size);
+
+    MemTable mem;
+    WAL rdr(new_path.string(), 9);
+    assert(rdr.open());
+    assert(rdr.replay(mem));
+    assert(mem.size() == 1 && mem.get("new")->value == "1");
+}
+
 int main() {
     test_header_new_and_existing();
     test_happy_path_replay();
@@ -228,6 +515,14 @@ int main() {
     test_reset();
     test_idempotent_replay();
     test_large_keys_values();
+    test_group_commit();
+    test_crc32c();
+    test_v1_log_replays();
+    test_sequence_replay();
+    test_corruption_stops_replay();
+    test_batch_all_or_nothing();
+    test_preallocated_segment();
+    test_recycled_segment();
 
     std::cout << "All WAL tests passed ✅\n";
     return 0;